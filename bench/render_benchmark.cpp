@@ -0,0 +1,566 @@
+#include "allocation_counter.hpp"
+#include "chunk_cache.hpp"
+#include "floorplan.hpp"
+#include "level_map.hpp"
+#include "map_file.hpp"
+#include "map_generator.hpp"
+#include "render.hpp"
+#include "world.hpp"
+#include <benchmark/benchmark.h>
+#include <math.h>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <random>
+
+namespace {
+
+constexpr double to_radians(double angle_degrees)
+{
+    return angle_degrees * M_PI / 180;
+}
+
+// Open positions on the level map from which to render.
+textray::vector2d const level_map_positions[] = {
+    { 3.0, 2.0 },
+    { 1.5, 1.5 },
+    { 5.5, 6.5 },
+};
+
+// ==========================================================================
+// STYLED_MAP
+// ==========================================================================
+// Returns a generated map of the given style and size, cached so that
+// generation is not timed.
+// ==========================================================================
+textray::floorplan const &styled_map(textray::map_style style, int size)
+{
+    static std::map<std::pair<textray::map_style, int>, textray::floorplan> maps;
+
+    auto const key = std::make_pair(style, size);
+    auto it = maps.find(key);
+
+    if (it == maps.end())
+    {
+        it = maps.emplace(
+            key, textray::generate_map(style, size, size, 1)).first;
+    }
+
+    return it->second;
+}
+
+// ==========================================================================
+// OPEN_POSITION
+// ==========================================================================
+// Returns the centre of the open tile nearest the centre of a map, as a
+// place for the camera to stand.
+// ==========================================================================
+textray::vector2d open_position(textray::floorplan const &plan)
+{
+    int x = 0;
+    int y = 0;
+    textray::find_open_tile(plan, x, y);
+    return {x + 0.5, y + 0.5};
+}
+
+// ==========================================================================
+// SET_COUNTERS
+// ==========================================================================
+void set_counters(benchmark::State &state, int width)
+{
+    // Iteration time is the time per frame; this additionally reports the
+    // time per rendered column (i.e. per ray cast).
+    state.counters["column_time"] = benchmark::Counter(
+        double(state.iterations()) * width,
+        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+// ==========================================================================
+// FRAME_ARGUMENTS
+// ==========================================================================
+// Arguments are: width, height, fov (degrees), heading (degrees) and
+// position index.
+// ==========================================================================
+void frame_arguments(benchmark::internal::Benchmark *bm)
+{
+    bm->ArgNames({"width", "height", "fov", "heading", "position"});
+
+    for (auto const &size : { std::make_pair(80, 24),
+                              std::make_pair(160, 48),
+                              std::make_pair(240, 72),
+                              std::make_pair(320, 96),
+                              std::make_pair(400, 120) })
+    {
+        for (auto const fov : { 60, 90, 120 })
+        {
+            for (auto const heading : { 0, 45, 210 })
+            {
+                for (int position = 0;
+                     position < int(std::distance(
+                         std::begin(level_map_positions),
+                         std::end(level_map_positions)));
+                     ++position)
+                {
+                    bm->Args({size.first, size.second, fov, heading, position});
+                }
+            }
+        }
+    }
+}
+
+// ==========================================================================
+// BM_RENDER_FRAME
+// ==========================================================================
+void BM_render_frame(benchmark::State &state)
+{
+    auto const size = terminalpp::extent(state.range(0), state.range(1));
+    auto const fov = to_radians(state.range(2));
+    auto const heading = to_radians(state.range(3));
+    auto const &position = level_map_positions[state.range(4)];
+
+    for (auto _ : state)
+    {
+        std::vector<terminalpp::string> content;
+        textray::render_ceiling(content, size);
+        textray::render_floor(content, size);
+        textray::render_walls(content, textray::level_map, position, heading, fov);
+        benchmark::DoNotOptimize(content.data());
+    }
+
+    set_counters(state, size.width_);
+}
+
+BENCHMARK(BM_render_frame)
+    ->Apply(frame_arguments)
+    ->Unit(benchmark::kNanosecond);
+
+// ==========================================================================
+// BM_RENDER_FRAME_REUSED
+// ==========================================================================
+// Renders into the same content each frame, as the camera does.  After the
+// first frame this must not allocate.
+// ==========================================================================
+void BM_render_frame_reused(benchmark::State &state)
+{
+    auto const size = terminalpp::extent(state.range(0), state.range(1));
+    auto const fov = to_radians(state.range(2));
+    auto const heading = to_radians(state.range(3));
+    auto const &position = level_map_positions[state.range(4)];
+
+    std::vector<terminalpp::string> content;
+    textray::resize_content(content, size);
+
+    auto const allocations_before = textray::thread_allocation_count();
+
+    for (auto _ : state)
+    {
+        textray::resize_content(content, size);
+        textray::render_ceiling(content, size);
+        textray::render_floor(content, size);
+        textray::render_walls(content, textray::level_map, position, heading, fov);
+        benchmark::ClobberMemory();
+    }
+
+    auto const allocations_after = textray::thread_allocation_count();
+
+    if (allocations_after.allocations != allocations_before.allocations)
+    {
+        state.SkipWithError("rendering into reused content allocated");
+    }
+
+    set_counters(state, size.width_);
+}
+
+BENCHMARK(BM_render_frame_reused)
+    ->Apply(frame_arguments)
+    ->Unit(benchmark::kNanosecond);
+
+// ==========================================================================
+// BM_RENDER_WALLS
+// ==========================================================================
+void BM_render_walls(benchmark::State &state)
+{
+    auto const size = terminalpp::extent(state.range(0), state.range(1));
+    auto const fov = to_radians(state.range(2));
+    auto const heading = to_radians(state.range(3));
+    auto const &position = level_map_positions[state.range(4)];
+
+    std::vector<terminalpp::string> content;
+    textray::render_ceiling(content, size);
+    textray::render_floor(content, size);
+
+    for (auto _ : state)
+    {
+        textray::render_walls(content, textray::level_map, position, heading, fov);
+        benchmark::ClobberMemory();
+    }
+
+    set_counters(state, size.width_);
+}
+
+BENCHMARK(BM_render_walls)
+    ->Apply(frame_arguments)
+    ->Unit(benchmark::kNanosecond);
+
+// ==========================================================================
+// BM_RENDER_CEILING_AND_FLOOR
+// ==========================================================================
+void BM_render_ceiling_and_floor(benchmark::State &state)
+{
+    auto const size = terminalpp::extent(state.range(0), state.range(1));
+
+    for (auto _ : state)
+    {
+        std::vector<terminalpp::string> content;
+        textray::render_ceiling(content, size);
+        textray::render_floor(content, size);
+        benchmark::DoNotOptimize(content.data());
+    }
+
+    set_counters(state, size.width_);
+}
+
+BENCHMARK(BM_render_ceiling_and_floor)
+    ->ArgNames({"width", "height"})
+    ->Args({80, 24})
+    ->Args({160, 48})
+    ->Args({240, 72})
+    ->Args({320, 96})
+    ->Args({400, 120})
+    ->Unit(benchmark::kNanosecond);
+
+// ==========================================================================
+// BM_RENDER_GENERATED_MAP
+// ==========================================================================
+// Arguments are: map size, width, height and heading (degrees).  The fov
+// is fixed at 90 degrees.
+// ==========================================================================
+void BM_render_generated_map(benchmark::State &state)
+{
+    auto const &plan = styled_map(
+        textray::map_style::arena, int(state.range(0)));
+    auto const size = terminalpp::extent(state.range(1), state.range(2));
+    auto const heading = to_radians(state.range(3));
+    auto const position = open_position(plan);
+
+    for (auto _ : state)
+    {
+        std::vector<terminalpp::string> content;
+        textray::render_ceiling(content, size);
+        textray::render_floor(content, size);
+        textray::render_walls(content, plan, position, heading, to_radians(90));
+        benchmark::DoNotOptimize(content.data());
+    }
+
+    set_counters(state, size.width_);
+}
+
+void generated_map_arguments(benchmark::internal::Benchmark *bm)
+{
+    bm->ArgNames({"map", "width", "height", "heading"});
+
+    for (auto const map_size : { 64, 512, 4096 })
+    {
+        for (auto const &size : { std::make_pair(80, 24),
+                                  std::make_pair(400, 120) })
+        {
+            for (auto const heading : { 0, 45 })
+            {
+                bm->Args({map_size, size.first, size.second, heading});
+            }
+        }
+    }
+}
+
+BENCHMARK(BM_render_generated_map)
+    ->Apply(generated_map_arguments)
+    ->Unit(benchmark::kNanosecond);
+
+// ==========================================================================
+// BM_RENDER_WORLD_SNAPSHOT
+// ==========================================================================
+// As BM_render_generated_map, but casting across a chunked snapshot of the
+// shared world, as clients do, including taking the snapshot.
+// ==========================================================================
+void BM_render_world_snapshot(benchmark::State &state)
+{
+    auto const &plan = styled_map(
+        textray::map_style::arena, int(state.range(0)));
+    textray::world shared_world{plan};
+    auto const size = terminalpp::extent(state.range(1), state.range(2));
+    auto const heading = to_radians(state.range(3));
+    auto const position = open_position(plan);
+
+    std::vector<terminalpp::string> content;
+
+    for (auto _ : state)
+    {
+        auto const snapshot = shared_world.snapshot();
+        textray::resize_content(content, size);
+        textray::render_ceiling(content, size);
+        textray::render_floor(content, size);
+        textray::render_walls(content, *snapshot, position, heading, to_radians(90));
+        benchmark::ClobberMemory();
+    }
+
+    set_counters(state, size.width_);
+}
+
+BENCHMARK(BM_render_world_snapshot)
+    ->Apply(generated_map_arguments)
+    ->Unit(benchmark::kNanosecond);
+
+// ==========================================================================
+// BM_OPEN_MAP_FILE
+// ==========================================================================
+// Maps a binary map file and builds a world snapshot from it, which is the
+// work done at server start-up.  The argument is the map size.
+// ==========================================================================
+void BM_open_map_file(benchmark::State &state)
+{
+    auto const size = int(state.range(0));
+    auto const path = "textray_bench_" + std::to_string(size) + ".txrmap";
+
+    {
+        std::ofstream out(path, std::ios::binary);
+        textray::write_map_file(
+            out, styled_map(textray::map_style::arena, size));
+    }
+
+    for (auto _ : state)
+    {
+        textray::world shared_world{textray::map_file::open(path)};
+        benchmark::DoNotOptimize(shared_world.snapshot()->tile_at(0, 0));
+    }
+
+    std::remove(path.c_str());
+}
+
+BENCHMARK(BM_open_map_file)
+    ->ArgName("map")
+    ->Arg(64)
+    ->Arg(512)
+    ->Arg(4096)
+    ->Unit(benchmark::kMicrosecond);
+
+// ==========================================================================
+// BM_RENDER_STREAMED_WORLD
+// ==========================================================================
+// Walks a camera across a 65536x65536 generated world, streaming chunks in
+// around it.  Arguments are the chunk budget in MiB and the distance
+// walked per frame in hundredths of a tile.  Frames render whatever is
+// resident; loads never block them.
+// ==========================================================================
+void BM_render_streamed_world(benchmark::State &state)
+{
+    constexpr int world_size = 65536;
+    auto const budget = std::size_t(state.range(0)) << 20;
+    auto const speed = state.range(1) / 100.0;
+    auto const size = terminalpp::extent(160, 48);
+
+    textray::chunk_cache cache{
+        world_size, 
+        world_size,
+        [](int chunk_x, int chunk_y, textray::world_chunk &chunk)
+        {
+            textray::generate_arena_chunk(
+                world_size, world_size, chunk_x, chunk_y, 1, chunk);
+        },
+        budget};
+
+    textray::vector2d position{world_size / 2 + 0.5, world_size / 2 + 0.5};
+    auto const heading = to_radians(30);
+    auto const step = textray::vector2d::from_angle(heading) * speed;
+
+    cache.prefetch(
+        int(position.x) >> textray::world_chunk::bits,
+        int(position.y) >> textray::world_chunk::bits,
+        2);
+    cache.wait_until_idle();
+
+    auto const before = cache.stats();
+    std::vector<terminalpp::string> content;
+
+    for (auto _ : state)
+    {
+        position += step;
+
+        cache.prefetch(
+            int(position.x) >> textray::world_chunk::bits,
+            int(position.y) >> textray::world_chunk::bits,
+            2);
+
+        textray::chunk_view view{cache};
+        textray::resize_content(content, size);
+        textray::render_ceiling(content, size);
+        textray::render_floor(content, size);
+        textray::render_walls(content, view, position, heading, to_radians(90));
+        benchmark::ClobberMemory();
+    }
+
+    auto const after = cache.stats();
+    auto const lookups = 
+        double(after.hits - before.hits + after.misses - before.misses);
+
+    state.counters["hit_rate"] = lookups == 0 
+        ? 1.0 
+        : double(after.hits - before.hits) / lookups;
+    state.counters["loads"] = benchmark::Counter(
+        double(after.loads - before.loads), benchmark::Counter::kAvgIterations);
+    state.counters["evictions"] = double(after.evictions - before.evictions);
+    state.counters["resident_mib"] = 
+        double(after.resident * sizeof(textray::world_chunk)) / (1 << 20);
+
+    set_counters(state, size.width_);
+}
+
+BENCHMARK(BM_render_streamed_world)
+    ->ArgNames({"budget_mib", "speed"})
+    ->Args({4, 10})
+    ->Args({4, 100})
+    ->Args({64, 10})
+    ->Args({64, 100})
+    ->Unit(benchmark::kMicrosecond);
+
+// ==========================================================================
+// BM_RENDER_MAP_STYLE
+// ==========================================================================
+// Renders each style of generated map from the open tile nearest its
+// centre.  Arguments are: style, map size, width, height and heading
+// (degrees).  Arenas and corridors give long rays; mazes and cities give
+// short ones with many wall changes.
+// ==========================================================================
+void BM_render_map_style(benchmark::State &state)
+{
+    auto const style = textray::map_style(state.range(0));
+    auto const &plan = styled_map(style, int(state.range(1)));
+    auto const size = terminalpp::extent(state.range(2), state.range(3));
+    auto const heading = to_radians(state.range(4));
+
+    auto const position = open_position(plan);
+
+    std::vector<terminalpp::string> content;
+
+    for (auto _ : state)
+    {
+        textray::resize_content(content, size);
+        textray::render_ceiling(content, size);
+        textray::render_floor(content, size);
+        textray::render_walls(content, plan, position, heading, to_radians(90));
+        benchmark::ClobberMemory();
+    }
+
+    set_counters(state, size.width_);
+}
+
+void map_style_arguments(benchmark::internal::Benchmark *bm)
+{
+    bm->ArgNames({"style", "map", "width", "height", "heading"});
+
+    for (auto const style : { textray::map_style::maze,
+                              textray::map_style::arena,
+                              textray::map_style::city,
+                              textray::map_style::corridors })
+    {
+        for (auto const map_size : { 65, 1025, 8193 })
+        {
+            for (auto const &size : { std::make_pair(80, 24),
+                                      std::make_pair(320, 96) })
+            {
+                for (auto const heading : { 0, 45 })
+                {
+                    bm->Args({
+                        int(style), map_size, size.first, size.second, heading});
+                }
+            }
+        }
+    }
+}
+
+BENCHMARK(BM_render_map_style)
+    ->Apply(map_style_arguments)
+    ->Unit(benchmark::kNanosecond);
+
+// ==========================================================================
+// BM_RENDER_SPRITES
+// ==========================================================================
+// Renders a frame of an arena with sprites scattered through the field of
+// view, many of them hidden behind pillars or each other.  Arguments are:
+// sprites, width and height.  After the first frame this must not
+// allocate.
+// ==========================================================================
+void BM_render_sprites(benchmark::State &state)
+{
+    auto const &plan = styled_map(textray::map_style::arena, 257);
+    auto const size = terminalpp::extent(state.range(1), state.range(2));
+    auto const fov = to_radians(90);
+    auto const heading = 0.0;
+
+    auto const position = open_position(plan);
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<double> distance(1.0, 40.0);
+    std::uniform_real_distribution<double> angle(-fov / 2, fov / 2);
+
+    std::vector<textray::entity_sighting> sprites;
+
+    for (textray::entity_id id = 0; id < textray::entity_id(state.range(0)); ++id)
+    {
+        auto const direction = heading + angle(generator);
+        sprites.push_back({
+            id,
+            position + textray::vector2d::from_angle(direction) * distance(generator),
+            direction,
+            std::uint8_t(1 + id % 9)});
+    }
+
+    std::vector<terminalpp::string> content;
+    std::vector<double> depth;
+    std::vector<textray::projected_sprite> projected;
+
+    auto const render =
+        [&]
+        {
+            textray::resize_content(content, size);
+            textray::render_ceiling(content, size);
+            textray::render_floor(content, size);
+            textray::render_walls(content, plan, position, heading, fov, &depth);
+            textray::render_sprites(
+                content, depth, sprites, position, heading, fov, projected);
+        };
+
+    render();
+
+    auto const allocations_before = textray::thread_allocation_count();
+
+    for (auto _ : state)
+    {
+        render();
+        benchmark::ClobberMemory();
+    }
+
+    auto const allocations_after = textray::thread_allocation_count();
+
+    if (allocations_after.allocations != allocations_before.allocations)
+    {
+        state.SkipWithError("rendering sprites allocated");
+    }
+
+    set_counters(state, size.width_);
+    state.counters["projected"] = double(projected.size());
+}
+
+BENCHMARK(BM_render_sprites)
+    ->ArgNames({"sprites", "width", "height"})
+    ->Args({0, 80, 24})
+    ->Args({100, 80, 24})
+    ->Args({500, 80, 24})
+    ->Args({1000, 80, 24})
+    ->Args({0, 320, 96})
+    ->Args({100, 320, 96})
+    ->Args({500, 320, 96})
+    ->Args({1000, 320, 96})
+    ->Unit(benchmark::kNanosecond);
+
+}
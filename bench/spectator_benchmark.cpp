@@ -0,0 +1,213 @@
+#include "level_map.hpp"
+#include "spectator.hpp"
+#include "ui.hpp"
+#include <terminalpp/canvas.hpp>
+#include <terminalpp/terminal.hpp>
+#include <munin/window.hpp>
+#include <benchmark/benchmark.h>
+#include <boost/asio/io_context.hpp>
+#include <boost/make_unique.hpp>
+#include <math.h>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+namespace {
+
+// The sizes of terminal that spectators watch from, taken in turn.
+terminalpp::extent const spectator_sizes[] = {
+    { 80, 24 },
+    { 120, 40 },
+    { 100, 30 },
+    { 160, 50 },
+};
+
+// ==========================================================================
+// DRAIN
+// ==========================================================================
+// Runs handlers on the calling thread until there is no more work, so that
+// a frame has been rendered and handed to every spectator on return.
+// ==========================================================================
+void drain(boost::asio::io_context &io_context)
+{
+    io_context.restart();
+
+    while (io_context.poll() != 0)
+    {
+    }
+}
+
+// ==========================================================================
+// PLAYER_PATH
+// ==========================================================================
+// A circuit around the open area in the middle of the level map.
+// ==========================================================================
+void player_path(
+    std::int64_t frame, textray::vector2d &position, double &heading)
+{
+    auto const angle = frame * M_PI / 180;
+    position = textray::vector2d{
+        4.0 + 1.4 * std::cos(angle),
+        4.5 + 1.4 * std::sin(angle)};
+    heading = angle + M_PI / 2 + M_PI / 8;
+}
+
+// ==========================================================================
+// BM_SPECTATOR_FAN_OUT
+// ==========================================================================
+// One player moves while spectators watch from the given number of
+// distinct terminal sizes.  Each frame is rendered and encoded once per
+// size and the same bytes handed to every spectator.
+// ==========================================================================
+void BM_spectator_fan_out(benchmark::State &state)
+{
+    auto const sizes = std::size_t(state.range(0));
+    auto const spectators = std::size_t(state.range(1));
+
+    boost::asio::io_context io_context;
+    auto const shared_world = textray::level_world();
+
+    textray::vector2d position;
+    double heading;
+    player_path(0, position, heading);
+
+    auto const subject = shared_world->add_entity(position, heading, 1);
+    textray::spectator_feed feed{
+        io_context, shared_world, subject, position, heading, M_PI / 2};
+
+    std::uint64_t frames = 0;
+    std::uint64_t bytes = 0;
+    std::vector<std::unique_ptr<textray::spectator>> audience;
+
+    for (std::size_t index = 0; index < spectators; ++index)
+    {
+        audience.push_back(boost::make_unique<textray::spectator>(
+            feed,
+            spectator_sizes[index % sizes],
+            textray::terminal_profile_for({}),
+            textray::palette::low,
+            [&frames, &bytes](textray::spectator_frame const &frame)
+            {
+                ++frames;
+                bytes += frame->size();
+            },
+            []{}));
+    }
+
+    // The first frames are encoded in full, and are not measured.
+    drain(io_context);
+    frames = 0;
+    bytes = 0;
+
+    std::int64_t step = 0;
+
+    for (auto _ : state)
+    {
+        player_path(++step, position, heading);
+        feed.move_to(position, heading);
+        drain(io_context);
+    }
+
+    state.counters["spectator_frames"] = benchmark::Counter(
+        double(frames), benchmark::Counter::kIsRate);
+    state.counters["bytes_per_frame"] =
+        frames == 0 ? 0.0 : double(bytes) / frames;
+
+    shared_world->remove_entity(subject);
+}
+
+BENCHMARK(BM_spectator_fan_out)
+    ->ArgNames({"sizes", "spectators"})
+    ->Args({1, 1000})
+    ->Args({4, 1000})
+    ->Unit(benchmark::kMicrosecond);
+
+// ==========================================================================
+// BM_SPECTATOR_PER_CONNECTION
+// ==========================================================================
+// The baseline: each spectator renders and encodes the player's view for
+// itself, as it would if it were an ordinary client following the player.
+// ==========================================================================
+void BM_spectator_per_connection(benchmark::State &state)
+{
+    auto const sizes = std::size_t(state.range(0));
+    auto const spectators = std::size_t(state.range(1));
+    auto const shared_world = textray::level_world();
+
+    textray::vector2d position;
+    double heading;
+    player_path(0, position, heading);
+
+    struct own_view
+    {
+        explicit own_view(
+            std::shared_ptr<textray::ui> const &view,
+            terminalpp::extent size)
+          : view(view),
+            window(view),
+            terminal(terminalpp::behaviour{}),
+            canvas(size)
+        {
+            terminal.set_size(size);
+        }
+
+        std::shared_ptr<textray::ui> view;
+        munin::window window;
+        terminalpp::terminal terminal;
+        terminalpp::canvas canvas;
+    };
+
+    std::uint64_t frames = 0;
+    std::uint64_t bytes = 0;
+    std::vector<std::unique_ptr<own_view>> audience;
+
+    auto const write =
+        [&bytes](terminalpp::bytes data)
+        {
+            bytes += data.size();
+        };
+
+    for (std::size_t index = 0; index < spectators; ++index)
+    {
+        audience.push_back(boost::make_unique<own_view>(
+            std::make_shared<textray::ui>(
+                shared_world,
+                textray::no_entity,
+                position,
+                heading,
+                M_PI / 2),
+            spectator_sizes[index % sizes]));
+
+        auto &current = *audience.back();
+        current.window.repaint(current.canvas, current.terminal, write);
+    }
+
+    bytes = 0;
+    std::int64_t step = 0;
+
+    for (auto _ : state)
+    {
+        player_path(++step, position, heading);
+
+        for (auto &current : audience)
+        {
+            current->view->move_camera_to(position, heading);
+            current->window.repaint(
+                current->canvas, current->terminal, write);
+            ++frames;
+        }
+    }
+
+    state.counters["spectator_frames"] = benchmark::Counter(
+        double(frames), benchmark::Counter::kIsRate);
+    state.counters["bytes_per_frame"] =
+        frames == 0 ? 0.0 : double(bytes) / frames;
+}
+
+BENCHMARK(BM_spectator_per_connection)
+    ->ArgNames({"sizes", "spectators"})
+    ->Args({1, 1000})
+    ->Args({4, 1000})
+    ->Unit(benchmark::kMicrosecond);
+
+}
@@ -0,0 +1,380 @@
+#include "collision.hpp"
+#include "entity_store.hpp"
+#include "map_generator.hpp"
+#include "render.hpp"
+#include "world.hpp"
+#include <benchmark/benchmark.h>
+#include <math.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// ==========================================================================
+// POPULATION
+// ==========================================================================
+// A store of entities scattered uniformly over a square world, and a set
+// of viewers, likewise scattered, each looking in a random direction.
+// ==========================================================================
+struct population
+{
+    population(int entity_count, int viewer_count, double world_size)
+    {
+        std::mt19937 rng{42};
+        std::uniform_real_distribution<double> coordinate{0, world_size};
+        std::uniform_real_distribution<double> angle{0, 2 * M_PI};
+
+        for (int index = 0; index < entity_count; ++index)
+        {
+            ids.push_back(store.add(
+                {coordinate(rng), coordinate(rng)}, angle(rng), 1));
+        }
+
+        for (int index = 0; index < viewer_count; ++index)
+        {
+            viewers.push_back({coordinate(rng), coordinate(rng)});
+            headings.push_back(angle(rng));
+        }
+    }
+
+    textray::entity_store store;
+    std::vector<textray::entity_id> ids;
+    std::vector<textray::vector2d> viewers;
+    std::vector<double> headings;
+};
+
+constexpr double view_range = 24.0;
+constexpr double view_fov = M_PI / 2;
+
+// ==========================================================================
+// BM_ENTITY_VIEW_QUERIES
+// ==========================================================================
+// Every viewer finds the entities in its view, as each client's render
+// does once per frame.  Arguments are the entity count, viewer count and
+// world size.
+// ==========================================================================
+void BM_entity_view_queries(benchmark::State &state)
+{
+    population world{
+        int(state.range(0)), int(state.range(1)), double(state.range(2))};
+    std::vector<textray::entity_id> visible;
+    std::size_t total_visible = 0;
+
+    for (auto _ : state)
+    {
+        for (std::size_t viewer = 0; viewer < world.viewers.size(); ++viewer)
+        {
+            visible.clear();
+            world.store.query_view(
+                world.viewers[viewer], 
+                world.headings[viewer], 
+                view_fov, 
+                view_range, 
+                visible);
+            total_visible += visible.size();
+        }
+
+        benchmark::DoNotOptimize(visible.data());
+    }
+
+    auto const queries = double(state.iterations()) * world.viewers.size();
+    state.counters["queries"] = benchmark::Counter(
+        queries, benchmark::Counter::kIsRate);
+    state.counters["visible_per_query"] = double(total_visible) / queries;
+}
+
+BENCHMARK(BM_entity_view_queries)
+    ->ArgNames({"entities", "viewers", "world"})
+    ->Args({10000, 1000, 256})
+    ->Args({10000, 1000, 1024})
+    ->Args({10000, 1000, 4096})
+    ->Unit(benchmark::kMicrosecond);
+
+// ==========================================================================
+// BM_ENTITY_VIEW_QUERIES_BRUTE_FORCE
+// ==========================================================================
+// The same queries answered by testing every entity, for comparison.
+// ==========================================================================
+void BM_entity_view_queries_brute_force(benchmark::State &state)
+{
+    population world{
+        int(state.range(0)), int(state.range(1)), double(state.range(2))};
+    std::vector<textray::entity_id> visible;
+    auto const cos_half_fov = std::cos(view_fov / 2);
+
+    for (auto _ : state)
+    {
+        for (std::size_t viewer = 0; viewer < world.viewers.size(); ++viewer)
+        {
+            visible.clear();
+            auto const direction = 
+                textray::vector2d::from_angle(world.headings[viewer]);
+
+            for (auto const id : world.ids)
+            {
+                auto const offset = world.store.position(id) - world.viewers[viewer];
+                auto const distance = offset.length();
+
+                if (distance <= view_range 
+                 && dot(offset, direction) >= distance * cos_half_fov)
+                {
+                    visible.push_back(id);
+                }
+            }
+        }
+
+        benchmark::DoNotOptimize(visible.data());
+    }
+
+    state.counters["queries"] = benchmark::Counter(
+        double(state.iterations()) * world.viewers.size(), 
+        benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_entity_view_queries_brute_force)
+    ->ArgNames({"entities", "viewers", "world"})
+    ->Args({10000, 1000, 1024})
+    ->Unit(benchmark::kMillisecond);
+
+// ==========================================================================
+// BM_ENTITY_MOVES
+// ==========================================================================
+// Moves every entity a short way, as a simulation tick does.  Arguments
+// are the entity count and world size.
+// ==========================================================================
+void BM_entity_moves(benchmark::State &state)
+{
+    population world{int(state.range(0)), 0, double(state.range(1))};
+    auto const limit = double(state.range(1));
+    double step = 0.3;
+
+    for (auto _ : state)
+    {
+        for (auto const id : world.ids)
+        {
+            auto position = world.store.position(id);
+            position.x = std::fmod(position.x + step + limit, limit);
+            world.store.move(id, position, world.store.heading(id));
+        }
+
+        step = -step;
+    }
+
+    state.counters["moves"] = benchmark::Counter(
+        double(state.iterations()) * world.ids.size(), 
+        benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_entity_moves)
+    ->ArgNames({"entities", "world"})
+    ->Args({10000, 1024})
+    ->Unit(benchmark::kMicrosecond);
+
+// ==========================================================================
+// BM_COLLISION_QUERIES
+// ==========================================================================
+// Moves players from open tiles scattered over a generated map a step in
+// random directions, as a simulation tick does for each movement command.
+// Arguments are the map style and size.  Maps are cached so that
+// generation is not timed.
+// ==========================================================================
+void BM_collision_queries(benchmark::State &state)
+{
+    static std::map<std::pair<int, int>, textray::world_snapshot> maps;
+
+    auto const style = textray::map_style(state.range(0));
+    auto const size = int(state.range(1));
+    auto found = maps.find({int(style), size});
+
+    if (found == maps.end())
+    {
+        found = maps.emplace(
+            std::make_pair(int(style), size),
+            textray::world_snapshot(
+                textray::generate_map(style, size, size, 42))).first;
+    }
+
+    auto const &plan = found->second;
+
+    std::mt19937 rng{42};
+    std::uniform_int_distribution<int> coordinate{0, size - 1};
+    std::uniform_real_distribution<double> angle{0, 2 * M_PI};
+
+    std::vector<textray::vector2d> positions;
+    std::vector<textray::vector2d> motions;
+
+    while (positions.size() < 4096)
+    {
+        auto const x = coordinate(rng);
+        auto const y = coordinate(rng);
+
+        if (plan.tile_at(x, y) == 0)
+        {
+            positions.push_back({x + 0.5, y + 0.5});
+            motions.push_back(textray::vector2d::from_angle(angle(rng)) * 0.25);
+        }
+    }
+
+    for (auto _ : state)
+    {
+        for (std::size_t index = 0; index < positions.size(); ++index)
+        {
+            benchmark::DoNotOptimize(textray::move_circle(
+                plan, positions[index], motions[index], 0.2));
+        }
+    }
+
+    state.counters["queries"] = benchmark::Counter(
+        double(state.iterations()) * positions.size(),
+        benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_collision_queries)
+    ->ArgNames({"style", "map"})
+    ->Args({int(textray::map_style::maze), 1025})
+    ->Args({int(textray::map_style::maze), 8193})
+    ->Args({int(textray::map_style::city), 1025})
+    ->Args({int(textray::map_style::city), 8193})
+    ->Args({int(textray::map_style::arena), 8193})
+    ->Unit(benchmark::kMicrosecond);
+
+// ==========================================================================
+// BM_DOORS_WHILE_RENDERING
+// ==========================================================================
+// Renders a frame for each of 1000 clients scattered over a large city,
+// as their cameras do, while another thread opens and closes 1000 doors a
+// second.  Each door changes a tile of the shared world, publishing a new
+// snapshot and redrawing only the clients whose last frame could show it.
+// Arguments are the map size and the client count.
+// ==========================================================================
+void BM_doors_while_rendering(benchmark::State &state)
+{
+    auto const size = int(state.range(0));
+    auto const plan = textray::generate_map(
+        textray::map_style::city, size, size, 42);
+    textray::world shared_world{plan};
+
+    std::mt19937 rng{42};
+    std::uniform_int_distribution<int> coordinate{1, size - 2};
+    std::uniform_real_distribution<double> angle{0, 2 * M_PI};
+
+    // Doors are walls that open into empty space and close again.
+    std::vector<textray::tile_change> doors;
+
+    while (doors.size() < 1000)
+    {
+        auto const x = coordinate(rng);
+        auto const y = coordinate(rng);
+
+        if (plan[y][x] != 0)
+        {
+            doors.push_back({x, y, plan[y][x]});
+        }
+    }
+
+    struct client
+    {
+        textray::vector2d position;
+        double heading;
+        std::unique_ptr<textray::view_subscription> subscription;
+        textray::visibility_set visible;
+    };
+
+    std::atomic<std::uint64_t> invalidations{0};
+    std::vector<client> clients(state.range(1));
+
+    for (auto &current : clients)
+    {
+        int x = 0;
+        int y = 0;
+
+        do
+        {
+            x = coordinate(rng);
+            y = coordinate(rng);
+        } while (plan[y][x] != 0);
+
+        current.position = {x + 0.5, y + 0.5};
+        current.heading = angle(rng);
+        current.subscription = std::make_unique<textray::view_subscription>(
+            shared_world,
+            textray::no_entity,
+            [&invalidations]
+            {
+                ++invalidations;
+            });
+    }
+
+    std::atomic<bool> stopping{false};
+    std::uint64_t toggles = 0;
+    std::chrono::nanoseconds toggle_time{0};
+
+    std::thread door_thread(
+        [&]
+        {
+            using clock_type = std::chrono::steady_clock;
+            auto next = clock_type::now();
+
+            for (std::size_t index = 0; !stopping; ++index)
+            {
+                auto &door = doors[index % doors.size()];
+                auto const open = index / doors.size() % 2 == 0;
+
+                auto const start = clock_type::now();
+                shared_world.set_tile(
+                    door.x, door.y, open ? textray::tile(0) : door.value);
+                toggle_time += clock_type::now() - start;
+                ++toggles;
+
+                next += std::chrono::milliseconds(1);
+                std::this_thread::sleep_until(next);
+            }
+        });
+
+    auto const fov = M_PI / 2;
+    auto const frame_size = terminalpp::extent(80, 24);
+    std::vector<terminalpp::string> content;
+    std::vector<double> depth;
+
+    for (auto _ : state)
+    {
+        for (auto &current : clients)
+        {
+            auto const snapshot = shared_world.snapshot();
+            textray::resize_content(content, frame_size);
+            textray::render_ceiling(content, frame_size);
+            textray::render_floor(content, frame_size);
+            textray::render_walls(
+                content, *snapshot, current.position, current.heading, fov, &depth);
+            textray::trace_view(
+                current.visible, *snapshot, depth, current.position, current.heading, fov);
+            current.subscription->publish(current.visible);
+        }
+    }
+
+    stopping = true;
+    door_thread.join();
+
+    state.counters["frames"] = benchmark::Counter(
+        double(state.iterations()) * clients.size(),
+        benchmark::Counter::kIsRate);
+    state.counters["toggles"] = double(toggles);
+    state.counters["toggle_ns"] =
+        toggles == 0 ? 0.0 : double(toggle_time.count()) / toggles;
+    state.counters["redraws_per_toggle"] =
+        toggles == 0 ? 0.0 : double(invalidations) / toggles;
+}
+
+BENCHMARK(BM_doors_while_rendering)
+    ->ArgNames({"map", "clients"})
+    ->Args({4097, 1000})
+    ->Args({8193, 1000})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+}
@@ -16,7 +16,8 @@ class TextratConan(ConanFile):
                 "telnetpp/[>=2.2.0]@kazdragon/conan-public",
                 "terminalpp/[>=2.0.2]@kazdragon/conan-public",
                 "munin/[>=0.3.11]@kazdragon/conan-public",
-                "boost/[>=1.69]")
+                "boost/[>=1.69]",
+                "nlohmann_json/[>=3.3.0]")
     generators = "cmake"
 
     def build(self):
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+
+namespace textray {
+
+//* =========================================================================
+/// \brief A tally of the heap allocations made by a thread.
+//* =========================================================================
+struct allocation_count
+{
+    std::uint64_t allocations;
+    std::uint64_t bytes;
+};
+
+//* =========================================================================
+/// \brief Returns the number of heap allocations made by the calling thread
+/// since it started.
+/// \par
+/// Counting is performed by the replacement global allocation functions in
+/// allocation_hooks.cpp, which must be compiled into the executable itself
+/// rather than a library.  In executables without them, all counts are 0.
+//* =========================================================================
+allocation_count thread_allocation_count();
+
+//* =========================================================================
+/// \brief The places on the steady-state keystroke path whose allocations
+/// are tallied separately.
+//* =========================================================================
+enum class allocation_site
+{
+    handle_data,       ///< main_state::handle_data and on_input
+    camera_draw,       ///< camera::do_draw
+    connection_write,  ///< connection::write
+    count_
+};
+
+//* =========================================================================
+/// \brief Returns the allocations made by the calling thread within the
+/// given site since it started.  A site's tally includes the allocations
+/// of any sites nested within it.
+//* =========================================================================
+allocation_count thread_allocation_count(allocation_site site);
+
+//* =========================================================================
+/// \brief Adds the allocations made by the calling thread during the
+/// lifetime of the object to the tally of a site.
+//* =========================================================================
+class scoped_allocation_counter
+{
+public :
+    explicit scoped_allocation_counter(allocation_site site);
+    ~scoped_allocation_counter();
+
+    scoped_allocation_counter(scoped_allocation_counter const &) = delete;
+    scoped_allocation_counter &operator=(scoped_allocation_counter const &) = delete;
+
+private :
+    allocation_site site_;
+    allocation_count start_;
+};
+
+namespace detail {
+
+//* =========================================================================
+/// \brief Returns the calling thread's running tally, for use by the
+/// replacement allocation functions.
+//* =========================================================================
+allocation_count &thread_allocation_tally();
+
+}
+
+}
@@ -1,21 +1,36 @@
 #pragma once
 
+#include "level_map.hpp"
 #include <serverpp/core.hpp>
 #include <boost/asio/io_context.hpp>
 #include <memory>
+#include <string>
 
 namespace textray {
     
 //* =========================================================================
 /// \brief A class that implements the main engine for the server.
 /// \param port - The server will be set up on this port identifier.
+/// \param recording_directory - If not empty, the input of every session
+/// is recorded to a file in this directory.
+/// \param metrics_port - If not zero, metrics are served over HTTP on this
+/// port on localhost, along with a Chrome trace of sampled input events
+/// at /trace and the resource usage of the top clients at /clients.
+/// \param shared_world - The world in which every client plays.
+/// \param tick_rate - The number of times per second that the simulation
+/// moves the players in the world.  If zero, each player is moved as soon
+/// as their input is read.
 //* =========================================================================
 class application final
 {
 public :
     application(
         boost::asio::io_context &io_context,
-        serverpp::port_identifier port);
+        serverpp::port_identifier port,
+        std::string recording_directory = "",
+        serverpp::port_identifier metrics_port = 0,
+        std::shared_ptr<world> shared_world = level_world(),
+        unsigned int tick_rate = 30);
     ~application();
     
     void shutdown();
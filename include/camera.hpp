@@ -1,10 +1,13 @@
 #pragma once
 
-#include "floorplan.hpp"
+#include "render.hpp"
 #include "vector2d.hpp"
+#include "world.hpp"
 #include <munin/basic_component.hpp>
-#include <munin/image.hpp>
+#include <terminalpp/string.hpp>
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 namespace textray {
     
@@ -13,11 +16,18 @@ class camera : public munin::basic_component
 public :
     //* =====================================================================
     /// \brief Constructor
+    /// \param viewer the entity whose view this is, which is not drawn, or
+    /// no_entity.
     /// \param position position of the camera on the floorplan.
     /// \param heading view direction of the camera, in radians.
     /// \param fov horizontal field of view of the camera, in radians.
     //* =====================================================================
-    camera(std::shared_ptr<floorplan> plan, vector2d position, double heading, double fov);
+    camera(
+        std::shared_ptr<world> shared_world,
+        entity_id viewer,
+        vector2d position,
+        double heading,
+        double fov);
 
     //* =====================================================================
     /// \brief Move to the specified position and heading.
@@ -29,6 +39,34 @@ public :
     //* =====================================================================
     void set_fov(double fov);
 
+    //* =====================================================================
+    /// \brief Set the palette that walls are drawn with.
+    //* =====================================================================
+    void set_palette(palette colours);
+
+    //* =====================================================================
+    /// \brief Redraw the view, for example because something in it has
+    /// changed.
+    //* =====================================================================
+    void redraw();
+
+    //* =====================================================================
+    /// \brief Takes the world as the next frame will show it and returns a
+    /// hash of everything that the frame is drawn from.  Frames with equal
+    /// hashes are identical.  Once this has been called, frames are drawn
+    /// from what it took rather than from the world as it is when they are
+    /// drawn, so it must be called before every frame.
+    //* =====================================================================
+    std::uint64_t prepare_frame();
+
+    //* =====================================================================
+    /// \brief Returns the cells that the last frame drawn could show.
+    //* =====================================================================
+    visibility_set const &visibility() const
+    {
+        return visible_;
+    }
+
 private :
     //* =====================================================================
     /// \brief Called by get_preferred_size().  Derived classes must override
@@ -50,13 +88,28 @@ private :
         munin::render_surface &surface, 
         terminalpp::rectangle const &region) const override;
 
-    void do_set_size(terminalpp::extent const &size) override;
-    
-    std::shared_ptr<munin::image> image_;
-    std::shared_ptr<floorplan> floorplan_;
+    //* =====================================================================
+    /// \brief Takes the world snapshot and the entities in view that the
+    /// next frame is drawn from.
+    //* =====================================================================
+    void gather() const;
+
+    // The frame is rendered into the same rows each time so that drawing
+    // does not allocate once the size is settled.
+    // So are the wall depths, the entities in view and their projections.
+    mutable std::vector<terminalpp::string> content_;
+    mutable std::shared_ptr<world_snapshot const> snapshot_;
+    mutable std::vector<double> depth_;
+    mutable std::vector<entity_sighting> sightings_;
+    mutable std::vector<projected_sprite> sprites_;
+    mutable visibility_set visible_;
+    std::shared_ptr<world> world_;
+    entity_id viewer_;
     vector2d position_;
     double heading_;
     double fov_;
+    palette colours_ = palette::low;
+    bool prepared_ = false;
 };
 
 }
@@ -0,0 +1,196 @@
+#pragma once
+
+#include "map_file.hpp"
+#include "tile.hpp"
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace textray {
+
+//* =========================================================================
+/// \brief A square block of tiles of a streamed world.
+//* =========================================================================
+struct world_chunk
+{
+    static constexpr int bits = 6;
+    static constexpr int size = 1 << bits;
+
+    std::array<tile, size * size> tiles;
+};
+
+//* =========================================================================
+/// \brief Holds the recently used chunks of a world that is too large to
+/// keep in memory, loading others on demand.
+/// \par
+/// Lookups never block on loading: a chunk that is not resident is queued
+/// for a background thread to load, and the caller is told that it is not
+/// yet available.  When the resident chunks exceed the memory budget, the
+/// least recently used are evicted; readers that still hold one keep it
+/// alive until they let go.
+/// \par
+/// This is a prototype, used only by the benchmarks.  The server does not
+/// read its world through a cache.  Nothing is told when a load completes,
+/// so a view drawn while its chunks were loading is not redrawn when they
+/// arrive.
+//* =========================================================================
+class chunk_cache
+{
+public :
+    //* =====================================================================
+    /// \brief A function that fills in the tiles of the given chunk.  It is
+    /// called on the cache's loading thread.
+    //* =====================================================================
+    using chunk_loader = 
+        std::function<void (int chunk_x, int chunk_y, world_chunk &chunk)>;
+
+    //* =====================================================================
+    /// \brief Counts of the cache's activity since it was created.
+    //* =====================================================================
+    struct statistics
+    {
+        std::uint64_t hits;
+        std::uint64_t misses;
+        std::uint64_t loads;
+        std::uint64_t evictions;
+        std::size_t resident;
+    };
+
+    //* =====================================================================
+    /// \brief Constructor
+    /// \param width, height the size of the world in tiles.
+    /// \param budget_bytes the memory that resident chunks may occupy.
+    //* =====================================================================
+    chunk_cache(
+        int width, 
+        int height, 
+        chunk_loader loader, 
+        std::size_t budget_bytes);
+
+    //* =====================================================================
+    /// \brief Destructor.  Abandons queued loads and stops the loading
+    /// thread.
+    //* =====================================================================
+    ~chunk_cache();
+
+    chunk_cache(chunk_cache const &) = delete;
+    chunk_cache &operator=(chunk_cache const &) = delete;
+
+    //* =====================================================================
+    /// \brief Returns the number of columns in the world.
+    //* =====================================================================
+    int width() const;
+
+    //* =====================================================================
+    /// \brief Returns the number of rows in the world.
+    //* =====================================================================
+    int height() const;
+
+    //* =====================================================================
+    /// \brief Returns the given chunk if it is resident.  Otherwise, queues
+    /// it to be loaded and returns nullptr.
+    //* =====================================================================
+    std::shared_ptr<world_chunk const> find(int chunk_x, int chunk_y);
+
+    //* =====================================================================
+    /// \brief Queues every chunk within the given distance (in chunks) of
+    /// the given chunk that is not resident to be loaded.
+    //* =====================================================================
+    void prefetch(int chunk_x, int chunk_y, int radius);
+
+    //* =====================================================================
+    /// \brief Blocks until every queued load has completed.
+    //* =====================================================================
+    void wait_until_idle();
+
+    //* =====================================================================
+    /// \brief Returns counts of the cache's activity.
+    //* =====================================================================
+    statistics stats() const;
+
+private :
+    struct impl;
+    std::unique_ptr<impl> pimpl_;
+};
+
+//* =========================================================================
+/// \brief A reader's view of a chunk cache that can be rendered like a
+/// floorplan.  It remembers the chunks that it has recently used so that
+/// most tile lookups do not touch the cache.
+/// \par
+/// Tiles in chunks that are not yet resident are reported as lying off
+/// the map, so that rays stop there rather than travelling on, and the
+/// rest of the column is drawn as open space.  A view is intended to be
+/// used for a single frame by a single thread.
+//* =========================================================================
+class chunk_view
+{
+public :
+    //* =====================================================================
+    /// \brief Constructor
+    //* =====================================================================
+    explicit chunk_view(chunk_cache &cache);
+
+    //* =====================================================================
+    /// \brief Returns whether the given co-ordinate lies in the world and
+    /// its chunk is resident.
+    //* =====================================================================
+    bool contains(int x, int y) const
+    {
+        return x >= 0 && y >= 0 && x < width_ && y < height_
+            && chunk_for(x, y) != nullptr;
+    }
+
+    //* =====================================================================
+    /// \brief Returns the tile at the given co-ordinate, which must be
+    /// contained in the view.
+    //* =====================================================================
+    tile tile_at(int x, int y) const
+    {
+        constexpr auto mask = world_chunk::size - 1;
+        return chunk_for(x, y)->tiles[((y & mask) << world_chunk::bits) + (x & mask)];
+    }
+
+private :
+    static constexpr int slot_bits = 6;
+
+    struct slot
+    {
+        int chunk_x = -1;
+        int chunk_y = -1;
+        world_chunk const *chunk = nullptr;
+        std::shared_ptr<world_chunk const> owner;
+    };
+
+    world_chunk const *chunk_for(int x, int y) const
+    {
+        auto const chunk_x = x >> world_chunk::bits;
+        auto const chunk_y = y >> world_chunk::bits;
+        auto &entry = slots_[
+            ((chunk_x * 31 + chunk_y) & ((1 << slot_bits) - 1))];
+
+        if (entry.chunk_x != chunk_x || entry.chunk_y != chunk_y)
+        {
+            entry.owner = cache_.find(chunk_x, chunk_y);
+            entry.chunk = entry.owner.get();
+            entry.chunk_x = chunk_x;
+            entry.chunk_y = chunk_y;
+        }
+
+        return entry.chunk;
+    }
+
+    chunk_cache &cache_;
+    int width_;
+    int height_;
+    mutable std::array<slot, 1 << slot_bits> slots_;
+};
+
+//* =========================================================================
+/// \brief Returns a loader that reads chunks from a mapped map file.
+//* =========================================================================
+chunk_cache::chunk_loader map_file_chunk_loader(
+    std::shared_ptr<map_file const> file);
+
+}
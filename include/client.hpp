@@ -1,23 +1,45 @@
 #pragma once
 
+#include "level_map.hpp"
 #include <boost/asio/io_context.hpp>
 #include <memory>
 
 namespace textray {
 
 class connection;
+class frame_cache;
+class session_recorder;
+class simulation;
+class spectator_directory;
+class world;
 
 class client
 {
 public :
     //* =====================================================================
     /// \brief Constructor
+    /// \param recorder if set, all input from the connection is recorded
+    /// to it.
+    /// \param shared_world the world in which the client plays.
+    /// \param shared_simulation the simulation that moves the client's
+    /// player.  If not set, the client's player is moved as soon as its
+    /// input has been read.
+    /// \param spectators the feeds of the players that the client can
+    /// watch, to which its own player's is added.  If not set, the client
+    /// can watch no one.
+    /// \param frames the cache of encoded frames that the client shares
+    /// with others.  If not set, the client has a cache of its own.
     //* =====================================================================
     explicit client(
         connection &&cnx, 
         boost::asio::io_context &io_context,
         std::function<void (client const&)> const &connection_died,
-        std::function<void ()> const &shutdown);
+        std::function<void ()> const &shutdown,
+        std::shared_ptr<session_recorder> recorder = {},
+        std::shared_ptr<world> shared_world = level_world(),
+        std::shared_ptr<simulation> shared_simulation = {},
+        std::shared_ptr<spectator_directory> spectators = {},
+        std::shared_ptr<frame_cache> frames = {});
 
     //* =====================================================================
     /// \brief Destructor
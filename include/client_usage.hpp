@@ -0,0 +1,156 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace textray {
+
+//* =========================================================================
+/// \brief The resources that are accounted to each client.
+//* =========================================================================
+enum class usage_metric
+{
+    render_cpu_ns,       ///< thread CPU time spent ray-casting frames
+    cells_rendered,      ///< cells ray-cast into the camera image
+    bytes_encoded,       ///< terminal output produced by repaints
+    bytes_uncompressed,  ///< telnet output before compression
+    bytes_sent,          ///< output handed to the transport
+    frames_rendered,     ///< repaints performed
+    frames_skipped,      ///< repaint requests folded into an earlier one
+    input_events,        ///< keypresses handled
+    memory_bytes,        ///< estimated size of the canvas and camera image
+    count_
+};
+
+//* =========================================================================
+/// \brief Returns the name under which a metric is reported.
+//* =========================================================================
+char const *usage_metric_name(usage_metric metric);
+
+//* =========================================================================
+/// \brief The resource usage of a single client.  Each instance is
+/// registered for reporting for its lifetime.
+/// \par
+/// A client's input and its repaints may be handled on different threads,
+/// so updates are atomic.  They are relaxed, and so reports are consistent
+/// per metric, not across metrics.
+//* =========================================================================
+class client_usage
+{
+public :
+    //* =====================================================================
+    /// \brief Constructor
+    //* =====================================================================
+    client_usage();
+
+    //* =====================================================================
+    /// \brief Destructor
+    //* =====================================================================
+    ~client_usage();
+
+    client_usage(client_usage const &) = delete;
+    client_usage &operator=(client_usage const &) = delete;
+
+    //* =====================================================================
+    /// \brief Returns an identifier for the client that is unique for the
+    /// lifetime of the process.
+    //* =====================================================================
+    std::uint64_t id() const
+    {
+        return id_;
+    }
+
+    //* =====================================================================
+    /// \brief Adds to a cumulative metric.
+    //* =====================================================================
+    void add(usage_metric metric, std::uint64_t amount)
+    {
+        values_[std::size_t(metric)].fetch_add(
+            amount, std::memory_order_relaxed);
+    }
+
+    //* =====================================================================
+    /// \brief Sets a metric that is a level rather than a total.
+    //* =====================================================================
+    void set(usage_metric metric, std::uint64_t value)
+    {
+        values_[std::size_t(metric)].store(value, std::memory_order_relaxed);
+    }
+
+    //* =====================================================================
+    /// \brief Returns the current value of a metric.
+    //* =====================================================================
+    std::uint64_t get(usage_metric metric) const
+    {
+        return values_[std::size_t(metric)].load(std::memory_order_relaxed);
+    }
+
+private :
+    std::uint64_t id_;
+    std::array<std::atomic<std::uint64_t>, std::size_t(usage_metric::count_)> values_;
+};
+
+//* =========================================================================
+/// \brief Returns the usage of the client on whose behalf the calling
+/// thread is working, or nullptr if there is none.
+//* =========================================================================
+client_usage *current_client_usage();
+
+//* =========================================================================
+/// \brief Adds to a metric of the current client, if there is one.
+//* =========================================================================
+inline void charge(usage_metric metric, std::uint64_t amount)
+{
+    if (auto *usage = current_client_usage())
+    {
+        usage->add(metric, amount);
+    }
+}
+
+//* =========================================================================
+/// \brief Makes the given usage current on the calling thread for the
+/// lifetime of the object, so that work done by components that do not
+/// know which client they serve (cameras, connections) is charged to it.
+//* =========================================================================
+class client_usage_scope
+{
+public :
+    explicit client_usage_scope(client_usage &usage);
+    ~client_usage_scope();
+
+    client_usage_scope(client_usage_scope const &) = delete;
+    client_usage_scope &operator=(client_usage_scope const &) = delete;
+
+private :
+    client_usage *previous_;
+};
+
+//* =========================================================================
+/// \brief Charges the thread CPU time taken during the lifetime of the
+/// object to the current client.  Costs nothing when there is none.
+//* =========================================================================
+class scoped_usage_cpu_timer
+{
+public :
+    explicit scoped_usage_cpu_timer(usage_metric metric);
+    ~scoped_usage_cpu_timer();
+
+    scoped_usage_cpu_timer(scoped_usage_cpu_timer const &) = delete;
+    scoped_usage_cpu_timer &operator=(scoped_usage_cpu_timer const &) = delete;
+
+private :
+    client_usage *usage_;
+    usage_metric metric_;
+    std::uint64_t start_;
+};
+
+//* =========================================================================
+/// \brief Returns a plain text table of the usage of the top clients.
+/// \param query - a query string that may contain "sort=<metric name>"
+/// (default bytes_sent) and "n=<number of clients>" (default 10).
+//* =========================================================================
+std::string client_usage_text(std::string const &query);
+
+}
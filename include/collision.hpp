@@ -0,0 +1,33 @@
+#pragma once
+
+#include "floorplan.hpp"
+#include "vector2d.hpp"
+#include "world.hpp"
+
+namespace textray {
+
+//* =========================================================================
+/// \brief Moves a circle through the plan by the given motion and returns
+/// where it ends up.  The circle stops against solid tiles, and tiles off
+/// the plan, and slides along them.
+/// \par
+/// The motion is swept one axis at a time, and only the tiles under the
+/// bounds of each sweep are read, so the cost depends on the length of the
+/// motion rather than the size of the plan.
+//* =========================================================================
+vector2d move_circle(
+    floorplan const &plan,
+    vector2d position,
+    vector2d motion,
+    double radius);
+
+//* =========================================================================
+/// \brief As above, moving through a snapshot of the shared world.
+//* =========================================================================
+vector2d move_circle(
+    world_snapshot const &plan,
+    vector2d position,
+    vector2d motion,
+    double radius);
+
+}
@@ -11,6 +11,8 @@ class tcp_socket;
 
 namespace textray {
 
+class transport;
+
 //* =========================================================================
 /// \brief An connection to a socket that abstracts away details about the
 /// protocols used.
@@ -25,6 +27,12 @@ public :
     //* =====================================================================
     explicit connection(serverpp::tcp_socket &&socket);
 
+    //* =====================================================================
+    /// \brief Create a connection object that uses the passed transport as
+    /// a communications point.
+    //* =====================================================================
+    explicit connection(std::unique_ptr<transport> trans);
+
     //* =====================================================================
     /// \brief Move constructor
     //* =====================================================================
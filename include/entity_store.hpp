@@ -0,0 +1,145 @@
+#pragma once
+
+#include "vector2d.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace textray {
+
+//* =========================================================================
+/// \brief Identifies an entity for as long as it is in a store.  Ids are
+/// reused after an entity is removed.
+//* =========================================================================
+using entity_id = std::uint32_t;
+
+//* =========================================================================
+/// \brief An id that no entity ever has.
+//* =========================================================================
+constexpr entity_id no_entity = 0xFFFFFFFF;
+
+//* =========================================================================
+/// \brief The positions and headings of the moving things in the world:
+/// players and other objects.
+/// \par
+/// Entities are held in parallel arrays (structure of arrays), densely
+/// packed, so that a query touches only the fields it needs.  A uniform
+/// grid, hashed into a fixed number of buckets, indexes them by position
+/// so that finding those near a point costs time proportional to the
+/// number found, not the number stored.
+/// \par
+/// A store is not thread-safe; see world for shared access.
+//* =========================================================================
+class entity_store
+{
+public :
+    //* =====================================================================
+    /// \brief Constructor
+    /// \param cell_bits the base-2 log of the width of a grid cell, in
+    /// tiles.
+    //* =====================================================================
+    explicit entity_store(int cell_bits = 3);
+
+    //* =====================================================================
+    /// \brief Adds an entity and returns its id.
+    /// \param appearance the colour in which the entity is drawn.
+    //* =====================================================================
+    entity_id add(vector2d position, double heading, std::uint8_t appearance);
+
+    //* =====================================================================
+    /// \brief Removes an entity.
+    //* =====================================================================
+    void remove(entity_id id);
+
+    //* =====================================================================
+    /// \brief Moves an entity.
+    //* =====================================================================
+    void move(entity_id id, vector2d position, double heading);
+
+    //* =====================================================================
+    /// \brief Returns the number of entities in the store.
+    //* =====================================================================
+    std::size_t size() const
+    {
+        return ids_.size();
+    }
+
+    //* =====================================================================
+    /// \brief Returns the position of an entity.
+    //* =====================================================================
+    vector2d position(entity_id id) const
+    {
+        auto const index = index_of_[id];
+        return { xs_[index], ys_[index] };
+    }
+
+    //* =====================================================================
+    /// \brief Returns the heading of an entity.
+    //* =====================================================================
+    double heading(entity_id id) const
+    {
+        return headings_[index_of_[id]];
+    }
+
+    //* =====================================================================
+    /// \brief Returns the appearance of an entity.
+    //* =====================================================================
+    std::uint8_t appearance(entity_id id) const
+    {
+        return appearances_[index_of_[id]];
+    }
+
+    //* =====================================================================
+    /// \brief Appends to out the ids of the entities within range of the
+    /// given position that lie inside the given field of view.
+    /// \param fov the horizontal field of view, in radians.
+    //* =====================================================================
+    void query_view(
+        vector2d position,
+        double heading,
+        double fov,
+        double range,
+        std::vector<entity_id> &out) const;
+
+    //* =====================================================================
+    /// \brief Appends to out the ids of the entities that lie in the
+    /// given axis-aligned rectangle.
+    //* =====================================================================
+    void query_rectangle(
+        vector2d minimum,
+        vector2d maximum,
+        std::vector<entity_id> &out) const;
+
+private :
+    static constexpr int bucket_bits = 12;
+
+    std::uint32_t bucket_of(vector2d position) const;
+    void link(std::uint32_t index);
+    void unlink(std::uint32_t index);
+
+    template <class Predicate>
+    void query_cells(
+        vector2d minimum,
+        vector2d maximum,
+        Predicate &&accept,
+        std::vector<entity_id> &out) const;
+
+    int cell_bits_;
+
+    // Dense, parallel arrays, indexed by position in the store.
+    std::vector<double> xs_;
+    std::vector<double> ys_;
+    std::vector<double> headings_;
+    std::vector<std::uint8_t> appearances_;
+    std::vector<entity_id> ids_;
+    std::vector<std::uint32_t> buckets_of_;
+    std::vector<std::uint32_t> slots_of_;
+
+    // Sparse map from id to dense index, and ids that may be reused.
+    std::vector<std::uint32_t> index_of_;
+    std::vector<entity_id> free_ids_;
+
+    // The dense indices of the entities in each bucket of the grid.
+    std::vector<std::vector<std::uint32_t>> buckets_;
+};
+
+}
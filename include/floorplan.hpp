@@ -1,10 +1,104 @@
 #pragma once
 
 #include "tile.hpp"
-#include <array>
+#include <initializer_list>
+#include <vector>
 
 namespace textray {
 
-using floorplan = std::array<std::array<tile, 8>, 9>;
+//* =========================================================================
+/// \brief A rectangular grid of tiles that makes up a level.
+/// \par
+/// Tiles are indexed as plan[y][x], where y is the row and x is the
+/// column.
+//* =========================================================================
+class floorplan
+{
+public :
+    //* =====================================================================
+    /// \brief Constructor
+    /// \par
+    /// Constructs a floorplan of the given dimensions, with every tile
+    /// set to the given fill.
+    //* =====================================================================
+    floorplan(int width, int height, tile fill = 0)
+      : width_(width),
+        height_(height),
+        tiles_(static_cast<std::size_t>(width) * height, fill)
+    {
+    }
+
+    //* =====================================================================
+    /// \brief Constructor
+    /// \par
+    /// Constructs a floorplan from a list of rows, each of which must be
+    /// the same length.
+    //* =====================================================================
+    floorplan(std::initializer_list<std::initializer_list<tile>> rows)
+      : width_(rows.size() == 0 ? 0 : int(rows.begin()->size())),
+        height_(int(rows.size()))
+    {
+        tiles_.reserve(static_cast<std::size_t>(width_) * height_);
+
+        for (auto const &row : rows)
+        {
+            tiles_.insert(tiles_.end(), row.begin(), row.end());
+        }
+    }
+
+    //* =====================================================================
+    /// \brief Returns the number of columns in the floorplan.
+    //* =====================================================================
+    int width() const
+    {
+        return width_;
+    }
+
+    //* =====================================================================
+    /// \brief Returns the number of rows in the floorplan.
+    //* =====================================================================
+    int height() const
+    {
+        return height_;
+    }
+
+    //* =====================================================================
+    /// \brief Returns whether the given co-ordinate lies on the floorplan.
+    //* =====================================================================
+    bool contains(int x, int y) const
+    {
+        return x >= 0 && y >= 0 && x < width_ && y < height_;
+    }
+
+    //* =====================================================================
+    /// \brief Returns the tile at the given co-ordinate, which must lie on
+    /// the floorplan.
+    //* =====================================================================
+    tile tile_at(int x, int y) const
+    {
+        return tiles_[static_cast<std::size_t>(y) * width_ + x];
+    }
+
+    //* =====================================================================
+    /// \brief Returns the row of tiles at the given index.
+    //* =====================================================================
+    tile const *operator[](int row) const
+    {
+        return tiles_.data() + static_cast<std::size_t>(row) * width_;
+    }
+
+    //* =====================================================================
+    /// \brief Returns the row of tiles at the given index.
+    //* =====================================================================
+    tile *operator[](int row)
+    {
+        return tiles_.data() + static_cast<std::size_t>(row) * width_;
+    }
+
+private :
+    int width_;
+    int height_;
+    std::vector<tile> tiles_;
+};
 
 }
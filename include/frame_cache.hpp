@@ -0,0 +1,96 @@
+#pragma once
+
+#include "visibility_set.hpp"
+#include <serverpp/core.hpp>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace textray {
+
+//* =========================================================================
+/// \brief Mixes a value into a hash.
+//* =========================================================================
+inline std::uint64_t hash_combine(std::uint64_t seed, std::uint64_t value)
+{
+    // The finaliser of splitmix64, applied to the seed and value together.
+    auto mixed = seed ^ (value + 0x9E3779B97F4A7C15ull + (seed << 6) + (seed >> 2));
+    mixed = (mixed ^ (mixed >> 30)) * 0xBF58476D1CE4E5B9ull;
+    mixed = (mixed ^ (mixed >> 27)) * 0x94D049BB133111EBull;
+    return mixed ^ (mixed >> 31);
+}
+
+//* =========================================================================
+/// \brief Mixes the bits of a double into a hash.
+//* =========================================================================
+inline std::uint64_t hash_combine(std::uint64_t seed, double value)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return hash_combine(seed, bits);
+}
+
+//* =========================================================================
+/// \brief Recently encoded frames, addressed by the state of the encoder
+/// that they were encoded with and by what they were drawn from, so that
+/// clients that are sent the same frame share its encoding.
+/// \par
+/// A client's encoder is its terminal and canvas, which remember what the
+/// screen shows.  Its state is the hash of everything that they have been
+/// given since they were created: the terminal's profile, their size and
+/// each frame since.  Encoders with the same state show the same thing and
+/// turn the same frame into the same bytes.  The bytes are kept together
+/// with the cells that the frame could show, which the client would
+/// otherwise have to ray-cast the frame to find.
+/// \par
+/// The cache is direct-mapped: each address has a single slot, and storing
+/// a frame replaces whatever was in its slot.  Each slot has a lock of its
+/// own, and once it has held a frame of a given size, storing or finding
+/// another of that size does not allocate.
+//* =========================================================================
+class frame_cache
+{
+public :
+    //* =====================================================================
+    /// \brief Constructor
+    //* =====================================================================
+    explicit frame_cache(std::size_t slots = 256);
+
+    //* =====================================================================
+    /// \brief Copies the bytes and visibility of the frame with the given
+    /// address into bytes and visible and returns true, or returns false
+    /// if it is not cached.
+    //* =====================================================================
+    bool find(
+        std::uint64_t encoder_state,
+        std::uint64_t frame,
+        serverpp::byte_storage &bytes,
+        visibility_set &visible);
+
+    //* =====================================================================
+    /// \brief Stores a copy of the bytes and visibility of a frame.
+    //* =====================================================================
+    void store(
+        std::uint64_t encoder_state,
+        std::uint64_t frame,
+        serverpp::bytes bytes,
+        visibility_set const &visible);
+
+private :
+    struct slot
+    {
+        std::mutex mutex;
+        bool used = false;
+        std::uint64_t encoder_state = 0;
+        std::uint64_t frame = 0;
+        serverpp::byte_storage bytes;
+        visibility_set visible;
+    };
+
+    slot &slot_for(std::uint64_t encoder_state, std::uint64_t frame);
+
+    std::vector<slot> slots_;
+};
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "render.hpp"
+#include <terminalpp/extent.hpp>
+#include <iosfwd>
+
+namespace textray {
+
+//* =========================================================================
+/// \brief Settings for a headless render run.
+//* =========================================================================
+struct headless_render_settings
+{
+    /// The number of frames that each thread renders.
+    unsigned int frames = 1000;
+
+    /// The number of threads that render concurrently.
+    unsigned int threads = 1;
+
+    /// The size of the terminal being rendered to.
+    terminalpp::extent size = {80, 24};
+
+    /// The palette that walls are drawn with.
+    palette colours = palette::low;
+};
+
+//* =========================================================================
+/// \brief Renders frames along a scripted camera path through the same
+/// components and encoding that a connected client would use, but without
+/// any sockets, and writes frame rate, frame time percentiles and
+/// allocation counts to the given stream.
+//* =========================================================================
+void run_headless_render(
+    headless_render_settings const &settings,
+    std::ostream &out);
+
+}
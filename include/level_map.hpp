@@ -0,0 +1,21 @@
+#pragma once
+
+#include "floorplan.hpp"
+#include <memory>
+
+namespace textray {
+
+class world;
+
+//* =========================================================================
+/// \brief The floorplan that all clients start in.
+//* =========================================================================
+extern floorplan const level_map;
+
+//* =========================================================================
+/// \brief Returns a world, built from the level map, that is shared by
+/// everything in the process that uses it.
+//* =========================================================================
+std::shared_ptr<world> level_world();
+
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "transport.hpp"
+#include <boost/asio/io_context.hpp>
+#include <memory>
+
+namespace textray {
+
+//* =========================================================================
+/// \brief The far end of a loopback_transport.  This is what an in-process
+/// peer (for example, a simulated user) uses to talk to the server.
+//* =========================================================================
+class loopback_peer
+{
+public :
+    //* =====================================================================
+    /// \brief Sends data to the server end of the transport.
+    //* =====================================================================
+    void send(serverpp::bytes data);
+
+    //* =====================================================================
+    /// \brief Closes the transport from the peer's end.
+    //* =====================================================================
+    void close();
+
+    //* =====================================================================
+    /// \brief Returns whether the transport is still open.
+    //* =====================================================================
+    bool is_alive() const;
+
+    //* =====================================================================
+    /// \brief Sets a function to be called with all data that the server
+    ///        writes.  It is called synchronously from within the server's
+    ///        write.
+    //* =====================================================================
+    void on_receive(std::function<void (serverpp::bytes)> const &callback);
+
+private :
+    friend class loopback_transport;
+    struct channel;
+
+    explicit loopback_peer(std::shared_ptr<channel> chan);
+
+    std::shared_ptr<channel> channel_;
+};
+
+//* =========================================================================
+/// \brief A transport that connects a server-side connection to an
+/// in-process peer, with no sockets involved.  Reads complete on the
+/// given io_context, just as they would for a socket.
+//* =========================================================================
+class loopback_transport final : public transport
+{
+public :
+    //* =====================================================================
+    /// \brief Constructor
+    //* =====================================================================
+    explicit loopback_transport(boost::asio::io_context &io_context);
+
+    //* =====================================================================
+    /// \brief Destructor.  Closes the transport, abandoning any outstanding
+    ///        read.
+    //* =====================================================================
+    ~loopback_transport() override;
+
+    //* =====================================================================
+    /// \brief Returns the peer end of this transport.
+    //* =====================================================================
+    std::shared_ptr<loopback_peer> peer() const;
+
+    bool is_alive() const override;
+    void close() override;
+    void async_read(
+        std::function<void (serverpp::bytes)> const &continuation) override;
+    void write(serverpp::bytes data) override;
+
+private :
+    std::shared_ptr<loopback_peer::channel> channel_;
+};
+
+}
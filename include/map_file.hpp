@@ -0,0 +1,113 @@
+#pragma once
+
+#include "floorplan.hpp"
+#include "tile.hpp"
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+
+namespace textray {
+
+//* =========================================================================
+/// \brief A map in the binary map format, mapped read-only into memory so
+/// that it is loaded without parsing or copying.
+/// \par
+/// All integers are little-endian.  The file consists of:
+///
+///   header (64 bytes):
+///     magic "TXRMAP\0\0", version (u32), chunk_bits (u32, always 4),
+///     width (u32), height (u32) and the byte offset (u64) of the tiles,
+///     with the rest zero.
+///   tiles: one byte per tile, chunk-major.  Chunks of 2^chunk_bits tiles
+///     square are stored in row-major order of chunks, each as row-major
+///     tiles, with edge chunks padded with open space.
+///
+/// The tiles start on a 64-byte boundary.  Their values are as described
+/// for textray::tile.  Chunks are the size of a world snapshot's, so that
+/// a snapshot of the map uses them in place.  Files with chunks of any
+/// other size are rejected.
+//* =========================================================================
+class map_file
+{
+public :
+    static constexpr std::uint32_t version = 2;
+    static constexpr int chunk_bits = 4;
+
+    //* =====================================================================
+    /// \brief Maps the file at the given path.  Throws std::runtime_error
+    /// if it cannot be opened or is not a valid map.
+    //* =====================================================================
+    static std::shared_ptr<map_file const> open(std::string const &path);
+
+    //* =====================================================================
+    /// \brief Destructor.  Unmaps the file.
+    //* =====================================================================
+    ~map_file();
+
+    map_file(map_file const &) = delete;
+    map_file &operator=(map_file const &) = delete;
+
+    //* =====================================================================
+    /// \brief Returns the number of columns in the map.
+    //* =====================================================================
+    int width() const
+    {
+        return width_;
+    }
+
+    //* =====================================================================
+    /// \brief Returns the number of rows in the map.
+    //* =====================================================================
+    int height() const
+    {
+        return height_;
+    }
+
+    //* =====================================================================
+    /// \brief Returns whether the given co-ordinate lies on the map.
+    //* =====================================================================
+    bool contains(int x, int y) const
+    {
+        return x >= 0 && y >= 0 && x < width_ && y < height_;
+    }
+
+    //* =====================================================================
+    /// \brief Returns the tile at the given co-ordinate, which must lie on
+    /// the map.
+    //* =====================================================================
+    tile tile_at(int x, int y) const
+    {
+        auto const mask = (1 << chunk_bits) - 1;
+        return chunk((x >> chunk_bits), (y >> chunk_bits))
+            [((y & mask) << chunk_bits) + (x & mask)];
+    }
+
+    //* =====================================================================
+    /// \brief Returns the tiles of the given chunk, in row-major order.
+    //* =====================================================================
+    tile const *chunk(int chunk_x, int chunk_y) const
+    {
+        auto const chunk_area = std::size_t(1) << (2 * chunk_bits);
+        return tiles_ 
+             + (std::size_t(chunk_y) * chunks_wide_ + chunk_x) * chunk_area;
+    }
+
+private :
+    map_file() = default;
+
+    void *mapping_ = nullptr;
+    std::size_t mapping_size_ = 0;
+
+    int width_ = 0;
+    int height_ = 0;
+    int chunks_wide_ = 0;
+    tile const *tiles_ = nullptr;
+};
+
+//* =========================================================================
+/// \brief Writes a floorplan in the binary map format.
+//* =========================================================================
+void write_map_file(std::ostream &out, floorplan const &plan);
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "floorplan.hpp"
+#include <cstdint>
+#include <string>
+
+namespace textray {
+
+class world_snapshot;
+struct world_chunk;
+
+//* =========================================================================
+/// \brief The kinds of map that can be generated.
+//* =========================================================================
+enum class map_style
+{
+    maze,       ///< a perfect maze with corridors one tile wide
+    arena,      ///< open space with scattered pillars; rays travel far
+    city,       ///< blocks of buildings separated by streets
+    corridors   ///< long parallel corridors with occasional crossings
+};
+
+//* =========================================================================
+/// \brief Generates a map of the given style and size.  Every map has a
+/// solid border.  The same style, size and seed always give the same map,
+/// on every platform.
+//* =========================================================================
+floorplan generate_map(
+    map_style style, int width, int height, std::uint64_t seed);
+
+//* =========================================================================
+/// \brief Fills one chunk of an arena of the given size, for worlds too
+/// large to generate whole.  Each chunk is derived from the seed and its
+/// own co-ordinates alone, so chunks can be generated in any order and
+/// nothing needs to be stored.  The arena has the border and density of
+/// pillars of generate_map(map_style::arena, ...), though not its pillars.
+//* =========================================================================
+void generate_arena_chunk(
+    int width, 
+    int height, 
+    int chunk_x, 
+    int chunk_y, 
+    std::uint64_t seed, 
+    world_chunk &chunk);
+
+//* =========================================================================
+/// \brief Parses the name of a style ("maze", "arena", "city" or
+/// "corridors").  Throws std::invalid_argument if it is not one.
+//* =========================================================================
+map_style parse_map_style(std::string const &name);
+
+//* =========================================================================
+/// \brief Returns the open tile nearest to the centre of the map, searching
+/// outwards in rings, as a place to stand.  Returns the centre if the map
+/// has no open tiles.
+//* =========================================================================
+void find_open_tile(floorplan const &plan, int &x, int &y);
+
+//* =========================================================================
+/// \brief Returns the open tile nearest to the centre of the world, as
+/// find_open_tile does for a floorplan.
+//* =========================================================================
+void find_open_tile(world_snapshot const &snapshot, int &x, int &y);
+
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace textray {
+
+//* =========================================================================
+/// \brief Monotonically increasing counts of events.
+//* =========================================================================
+enum class metric_counter : std::size_t
+{
+    connections_accepted,
+    repaints,
+    bytes_uncompressed,
+    bytes_compressed,
+    inputs_dropped,
+    spectator_frames_encoded,
+    spectator_frames_sent,
+    frame_cache_hits,
+    frame_cache_misses,
+    count_
+};
+
+//* =========================================================================
+/// \brief Values that go up and down.
+//* =========================================================================
+enum class metric_gauge : std::size_t
+{
+    clients_setup,
+    clients_main,
+    clients_dead,
+    transport_writers,
+    count_
+};
+
+//* =========================================================================
+/// \brief Distributions of values, such as durations in nanoseconds.
+//* =========================================================================
+enum class metric_histogram : std::size_t
+{
+    render_duration,
+    repaint_duration,
+    tick_duration,
+    count_
+};
+
+namespace detail {
+
+//* =========================================================================
+/// \brief A histogram with buckets that are linear within each power of
+/// two, after the fashion of an HDR histogram.  This gives a relative
+/// precision of 1/16 across the whole range of 64-bit values.
+//* =========================================================================
+struct log_linear_histogram
+{
+    static constexpr int sub_bucket_bits = 4;
+    static constexpr std::size_t sub_buckets = std::size_t(1) << sub_bucket_bits;
+    static constexpr std::size_t bucket_count = 
+        (64 - sub_bucket_bits + 1) * sub_buckets;
+
+    //* =====================================================================
+    /// \brief Returns the bucket into which the value falls.
+    //* =====================================================================
+    static std::size_t bucket_of(std::uint64_t value)
+    {
+        if (value < sub_buckets)
+        {
+            return std::size_t(value);
+        }
+
+        auto const magnitude = 63 - __builtin_clzll(value);
+        auto const shift = magnitude - sub_bucket_bits;
+        auto const sub_bucket = (value >> shift) & (sub_buckets - 1);
+
+        return (shift + 1) * sub_buckets + sub_bucket;
+    }
+
+    //* =====================================================================
+    /// \brief Returns the largest value that falls into the bucket.
+    //* =====================================================================
+    static std::uint64_t upper_bound_of(std::size_t bucket)
+    {
+        if (bucket < sub_buckets)
+        {
+            return bucket;
+        }
+
+        auto const shift = bucket / sub_buckets - 1;
+        auto const sub_bucket = bucket % sub_buckets;
+        auto const lower = (sub_buckets + sub_bucket) << shift;
+
+        return lower + ((std::uint64_t(1) << shift) - 1);
+    }
+
+    std::array<std::atomic<std::uint64_t>, bucket_count> buckets;
+    std::atomic<std::uint64_t> sum;
+};
+
+//* =========================================================================
+/// \brief The metrics recorded by a single thread.  Each is written only
+/// by its own thread, so updates need no atomic read-modify-write; the
+/// values are atomic only so that they can be read safely for reporting.
+//* =========================================================================
+struct metrics_shard
+{
+    std::array<std::atomic<std::uint64_t>, std::size_t(metric_counter::count_)> counters;
+    std::array<std::atomic<std::int64_t>, std::size_t(metric_gauge::count_)> gauges;
+    std::array<log_linear_histogram, std::size_t(metric_histogram::count_)> histograms;
+};
+
+//* =========================================================================
+/// \brief Creates a shard for the calling thread and registers it for
+/// reporting.  Shards live for the rest of the program so that counts from
+/// threads that have finished are not lost.
+//* =========================================================================
+metrics_shard *register_metrics_shard();
+
+//* =========================================================================
+/// \brief Returns the calling thread's shard.
+//* =========================================================================
+inline metrics_shard &local_metrics_shard()
+{
+    thread_local metrics_shard *shard = register_metrics_shard();
+    return *shard;
+}
+
+template <class T, class U>
+void add_relaxed(std::atomic<T> &value, U amount)
+{
+    value.store(
+        value.load(std::memory_order_relaxed) + amount,
+        std::memory_order_relaxed);
+}
+
+}
+
+//* =========================================================================
+/// \brief Increases a counter.
+//* =========================================================================
+inline void count(metric_counter counter, std::uint64_t amount = 1)
+{
+    detail::add_relaxed(
+        detail::local_metrics_shard().counters[std::size_t(counter)],
+        amount);
+}
+
+//* =========================================================================
+/// \brief Adjusts a gauge up or down.
+//* =========================================================================
+inline void adjust(metric_gauge gauge, std::int64_t amount)
+{
+    detail::add_relaxed(
+        detail::local_metrics_shard().gauges[std::size_t(gauge)],
+        amount);
+}
+
+//* =========================================================================
+/// \brief Records a value in a histogram.
+//* =========================================================================
+inline void observe(metric_histogram histogram, std::uint64_t value)
+{
+    auto &hist = detail::local_metrics_shard().histograms[std::size_t(histogram)];
+    detail::add_relaxed(
+        hist.buckets[detail::log_linear_histogram::bucket_of(value)], 1);
+    detail::add_relaxed(hist.sum, value);
+}
+
+//* =========================================================================
+/// \brief Records the lifetime of the timer, in nanoseconds, in a
+/// histogram.
+//* =========================================================================
+class scoped_metric_timer
+{
+public :
+    explicit scoped_metric_timer(metric_histogram histogram)
+      : histogram_(histogram),
+        start_(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~scoped_metric_timer()
+    {
+        observe(
+            histogram_,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start_).count());
+    }
+
+    scoped_metric_timer(scoped_metric_timer const &) = delete;
+    scoped_metric_timer &operator=(scoped_metric_timer const &) = delete;
+
+private :
+    metric_histogram histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+//* =========================================================================
+/// \brief Returns all metrics, summed across threads, in the Prometheus
+/// text exposition format.
+//* =========================================================================
+std::string metrics_text();
+
+}
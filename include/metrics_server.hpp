@@ -0,0 +1,57 @@
+#pragma once
+
+#include <serverpp/core.hpp>
+#include <boost/asio/io_context.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace textray {
+
+//* =========================================================================
+/// \brief A minimal HTTP server, bound to localhost, that exposes the
+/// server's metrics in the Prometheus text format at /metrics.
+/// \par
+/// Other diagnostic pages can be added with add_page.  Each request is
+/// answered with a single response and the connection is then closed.
+//* =========================================================================
+class metrics_server final
+{
+public :
+    //* =====================================================================
+    /// \brief A function that produces the body of a page, given the query
+    /// string of the request (without the leading '?').
+    //* =====================================================================
+    using page_function = std::function<std::string (std::string const &)>;
+
+    //* =====================================================================
+    /// \brief Constructor
+    //* =====================================================================
+    metrics_server(
+        boost::asio::io_context &io_context,
+        serverpp::port_identifier port);
+
+    //* =====================================================================
+    /// \brief Destructor
+    //* =====================================================================
+    ~metrics_server();
+
+    //* =====================================================================
+    /// \brief Serves the output of the given function at the given path.
+    //* =====================================================================
+    void add_page(
+        std::string const &path,
+        std::string const &content_type,
+        page_function const &page);
+
+    //* =====================================================================
+    /// \brief Stops accepting requests.
+    //* =====================================================================
+    void shutdown();
+
+private :
+    struct impl;
+    std::shared_ptr<impl> pimpl_;
+};
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+//* =========================================================================
+/// \file probes.hpp
+/// \brief Static tracepoints for perf, bpftrace and SystemTap.
+///
+/// When the build finds <sys/sdt.h>, each TEXTRAY_PROBE* macro emits a USDT
+/// probe in the "textray" provider.  A probe costs a single nop until a
+/// tracer attaches to it.  Otherwise, the macros compile to nothing.
+///
+/// The probes and their arguments are:
+///
+///   render__start(camera, width, height)
+///   render__end(camera, width, height)
+///     Bracket the ray casting of one frame in camera::do_draw.  camera is
+///     the address of the camera; width and height are its size in cells.
+///
+///   repaint__start(client)
+///   repaint__end(client)
+///     Bracket a repaint of the window of a client in the main state.
+///     client is the address of the client's main state.
+///
+///   compress(connection, uncompressed_bytes, compressed_bytes)
+///     Fires when a block of output has passed through the compressor and
+///     is about to be written to the transport.  compressed_bytes is equal
+///     to uncompressed_bytes if compression is not active.  As the
+///     compressor may buffer, this can fire for less data than was given.
+///
+///   state__change(client, old_state, new_state)
+///     Fires when a client moves between connection states.  The states
+///     are 0 (init), 1 (setup), 2 (main) and 3 (dead).
+///
+/// For example, to list the probes and to count frames per camera:
+///
+///   perf probe -x ./textray --add 'sdt_textray:*'
+///   bpftrace -e 'usdt:./textray:textray:render__end { @[arg0] = count(); }'
+//* =========================================================================
+
+#ifdef TEXTRAY_HAVE_SYS_SDT_H
+
+#include <sys/sdt.h>
+
+#define TEXTRAY_PROBE1(name, a) \
+    DTRACE_PROBE1(textray, name, a)
+#define TEXTRAY_PROBE3(name, a, b, c) \
+    DTRACE_PROBE3(textray, name, a, b, c)
+
+#else
+
+#define TEXTRAY_PROBE1(name, a) \
+    do { } while (false)
+#define TEXTRAY_PROBE3(name, a, b, c) \
+    do { } while (false)
+
+#endif
@@ -0,0 +1,198 @@
+#pragma once
+
+#include "chunk_cache.hpp"
+#include "floorplan.hpp"
+#include "vector2d.hpp"
+#include "visibility_set.hpp"
+#include "world.hpp"
+#include <terminalpp/string.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace textray {
+
+//* =========================================================================
+/// \brief How many colours a terminal can show.
+//* =========================================================================
+enum class colour_depth : std::uint8_t
+{
+    low,         ///< the 16 ANSI colours
+    high,        ///< the 256-colour palette
+    true_colour, ///< 24-bit colour
+};
+
+//* =========================================================================
+/// \brief Returns the colour depth implied by a terminal type, such as
+/// "xterm-256color".  Terminals of unknown types are assumed to show 16
+/// colours.
+//* =========================================================================
+colour_depth colour_depth_of(std::string const &terminal_type);
+
+//* =========================================================================
+/// \brief The colours in which walls are drawn.
+/// \par
+/// The low palette shows each wall in its tile's colour, with walls that
+/// face along the y axis in reverse video.  The high palette additionally
+/// darkens walls with distance.  The saver palette tells the faces apart by
+/// glyph rather than by attribute, so that the fewest attribute changes
+/// need to be encoded.
+//* =========================================================================
+enum class palette : std::uint8_t
+{
+    low,
+    high,
+    saver,
+    count_
+};
+
+//* =========================================================================
+/// \brief Returns the richest palette that a terminal of the given depth
+/// can show, or the saver palette if bandwidth is to be saved.
+//* =========================================================================
+palette palette_for(colour_depth depth, bool save_bandwidth);
+
+//* =========================================================================
+/// \brief Returns the name of a palette, or parses one, returning false if
+/// the name is not known.
+//* =========================================================================
+char const *palette_name(palette colours);
+bool parse_palette(std::string const &name, palette &colours);
+
+//* =========================================================================
+/// \brief Makes the content the given size.  Rows that are already the
+/// right width are kept, so that this does not allocate when the size has
+/// not changed.
+//* =========================================================================
+void resize_content(
+    std::vector<terminalpp::string> &content,
+    terminalpp::extent size);
+
+//* =========================================================================
+/// \brief Draws the ceiling rows (the top half of the view).  Rows that the
+/// content does not yet have are appended.
+//* =========================================================================
+void render_ceiling(
+    std::vector<terminalpp::string> &content,
+    terminalpp::extent size);
+
+//* =========================================================================
+/// \brief Draws the floor rows (the bottom half of the view).  Rows that
+/// the content does not yet have are appended.
+//* =========================================================================
+void render_floor(
+    std::vector<terminalpp::string> &content,
+    terminalpp::extent size);
+
+//* =========================================================================
+/// \brief Casts one ray per column of the content from the given position
+/// and heading across the floorplan, drawing the walls that they hit over
+/// the existing ceiling and floor.
+/// \param fov horizontal field of view, in radians.  Must be between 0 and
+/// pi (exclusive).
+/// \param depth if not null, receives the distance to the wall in each
+/// column (infinity where there is none), for use by render_sprites.
+/// \param colours the palette in which to draw the walls.
+//* =========================================================================
+void render_walls(
+    std::vector<terminalpp::string> &content,
+    floorplan const &plan,
+    vector2d const &position,
+    double heading,
+    double fov,
+    std::vector<double> *depth = nullptr,
+    palette colours = palette::low);
+
+//* =========================================================================
+/// \brief As above, casting rays across a snapshot of the shared world.
+//* =========================================================================
+void render_walls(
+    std::vector<terminalpp::string> &content,
+    world_snapshot const &plan,
+    vector2d const &position,
+    double heading,
+    double fov,
+    std::vector<double> *depth = nullptr,
+    palette colours = palette::low);
+
+//* =========================================================================
+/// \brief As above, casting rays across the resident chunks of a streamed
+/// world.  Used only by the streaming benchmark; see chunk_cache.
+//* =========================================================================
+void render_walls(
+    std::vector<terminalpp::string> &content,
+    chunk_view const &plan,
+    vector2d const &position,
+    double heading,
+    double fov,
+    std::vector<double> *depth = nullptr,
+    palette colours = palette::low);
+
+//* =========================================================================
+/// \brief A sprite projected onto the view, as used by render_sprites.
+//* =========================================================================
+struct projected_sprite
+{
+    double depth;
+    double column;
+    double half_width;
+    std::uint8_t appearance;
+};
+
+//* =========================================================================
+/// \brief Projects the given entities onto the view, culling those that it
+/// cannot show, and sorts them nearest first.
+//* =========================================================================
+void project_sprites(
+    std::vector<entity_sighting> const &sprites,
+    vector2d const &position,
+    double heading,
+    double fov,
+    std::vector<projected_sprite> &projected);
+
+//* =========================================================================
+/// \brief Draws sprites projected by project_sprites over the walls, as
+/// render_sprites does.
+//* =========================================================================
+void draw_sprites(
+    std::vector<terminalpp::string> &content,
+    std::vector<double> &depth,
+    std::vector<projected_sprite> const &projected,
+    double fov);
+
+//* =========================================================================
+/// \brief Draws the given entities as billboards over the walls, nearest
+/// first.  A sprite is drawn only in the columns where it is nearer than
+/// what is already there, and those columns' depths are brought forward to
+/// it, so that sprites hidden behind walls or other sprites cost nothing
+/// beyond their projection.
+/// \param depth the per-column depths from render_walls.  These are
+/// updated.
+/// \param scratch storage for the projected sprites, kept between frames
+/// so that this does not allocate once it has grown.
+//* =========================================================================
+void render_sprites(
+    std::vector<terminalpp::string> &content,
+    std::vector<double> &depth,
+    std::vector<entity_sighting> const &sprites,
+    vector2d const &position,
+    double heading,
+    double fov,
+    std::vector<projected_sprite> &scratch);
+
+//* =========================================================================
+/// \brief Records in visible the cells through which the rays cast by
+/// render_walls passed, given the depths that it recorded, so that changes
+/// to the world can be matched against what the view could show.  It must
+/// be given the depths before render_sprites brings them forward, since a
+/// wall still shows above a sprite in front of it.
+//* =========================================================================
+void trace_view(
+    visibility_set &visible,
+    world_snapshot const &plan,
+    std::vector<double> const &depth,
+    vector2d const &position,
+    double heading,
+    double fov);
+
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <serverpp/core.hpp>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace textray {
+
+//* =========================================================================
+/// \brief An event received from a client, as stored in a session
+/// recording.
+//* =========================================================================
+struct session_event
+{
+    enum class kind : std::uint8_t
+    {
+        data          = 1,
+        window_size   = 2,
+        terminal_type = 3
+    };
+
+    /// The kind of event.
+    kind type;
+
+    /// The time of the event, measured from the start of the session.
+    std::chrono::microseconds time;
+
+    /// For data events, the bytes received.  For terminal_type events, the
+    /// terminal type.
+    serverpp::byte_storage content;
+
+    /// For window_size events, the new window size.
+    std::uint16_t width;
+    std::uint16_t height;
+};
+
+//* =========================================================================
+/// \brief Records the input of a session to a file so that it can later
+/// be replayed.
+/// \par
+/// The file starts with the magic "TXRS" and a version byte.  Each event
+/// follows as a kind byte, the microseconds since the previous event as a
+/// varint, and then its payload: a varint length and bytes for data and
+/// terminal types, or two varints for window sizes.
+//* =========================================================================
+class session_recorder
+{
+public :
+    //* =====================================================================
+    /// \brief Constructor.  Creates a new recording at the given path.
+    ///        Throws std::runtime_error if the file cannot be created.
+    //* =====================================================================
+    explicit session_recorder(std::string const &path);
+
+    //* =====================================================================
+    /// \brief Creates a recorder that writes to a uniquely named file in
+    ///        the given directory.
+    //* =====================================================================
+    static std::shared_ptr<session_recorder> create_in(
+        std::string const &directory);
+
+    //* =====================================================================
+    /// \brief Records data received from the client.
+    //* =====================================================================
+    void data(serverpp::bytes content);
+
+    //* =====================================================================
+    /// \brief Records a change in the client's window size.
+    //* =====================================================================
+    void window_size(std::uint16_t width, std::uint16_t height);
+
+    //* =====================================================================
+    /// \brief Records the client's terminal type.
+    //* =====================================================================
+    void terminal_type(std::string const &type);
+
+private :
+    void begin_event(session_event::kind type);
+    void write_varint(std::uint64_t value);
+
+    std::ofstream file_;
+    std::chrono::steady_clock::time_point last_event_;
+};
+
+//* =========================================================================
+/// \brief Reads all of the events from a session recording.  Throws
+/// std::runtime_error if the stream is not a session recording.
+//* =========================================================================
+std::vector<session_event> read_session_recording(std::istream &in);
+
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include "spsc_queue.hpp"
+#include "vector2d.hpp"
+#include "world.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace textray {
+
+class simulation;
+
+//* =========================================================================
+/// \brief The things a player can ask to do in the world.
+//* =========================================================================
+enum class player_command : std::uint8_t
+{
+    move_forward,
+    move_backward,
+    move_left,
+    move_right,
+    rotate_left,
+    rotate_right,
+};
+
+//* =========================================================================
+/// \brief Where a player is and which way they are facing.
+//* =========================================================================
+struct player_state
+{
+    vector2d position;
+    double heading;
+};
+
+//* =========================================================================
+/// \brief A player in a simulation.
+/// \par
+/// The player's client submits commands, which the simulation applies at
+/// its next tick.  The resulting state is published as an immutable
+/// snapshot and the player's handler is called to say that it has changed.
+/// For as long as the player exists, it is an entity in the world.
+//* =========================================================================
+class player
+{
+public :
+    //* =====================================================================
+    /// \brief Constructor
+    /// \param on_update called, on the simulation's thread, after a tick
+    /// that changed the player's state.  It must be cheap and must not
+    /// call back into the simulation.
+    //* =====================================================================
+    player(
+        simulation &sim,
+        player_state initial_state,
+        std::uint8_t appearance,
+        std::function<void ()> on_update);
+
+    //* =====================================================================
+    /// \brief Destructor.  Once this returns, the handler is not called
+    /// again.
+    //* =====================================================================
+    ~player();
+
+    player(player const &) = delete;
+    player &operator=(player const &) = delete;
+
+    //* =====================================================================
+    /// \brief Returns the player's entity in the world.
+    //* =====================================================================
+    entity_id entity() const
+    {
+        return entity_;
+    }
+
+    //* =====================================================================
+    /// \brief Queues a command for the next tick.  Must only be called from
+    /// one thread at a time.  Returns false, dropping the command, if too
+    /// many are already queued.
+    //* =====================================================================
+    bool submit(player_command command);
+
+    //* =====================================================================
+    /// \brief Returns the state of the player as of the last tick.
+    //* =====================================================================
+    std::shared_ptr<player_state const> state() const
+    {
+        return std::atomic_load(&published_);
+    }
+
+private :
+    friend class simulation;
+
+    simulation &simulation_;
+    entity_id entity_;
+    std::function<void ()> on_update_;
+
+    // Owned by the simulation's thread.
+    spsc_queue<player_command, 64> commands_;
+    player_state state_;
+
+    std::shared_ptr<player_state const> published_;
+};
+
+//* =========================================================================
+/// \brief Advances the players in a world.
+/// \par
+/// Input handlers only queue commands; the simulation applies them all at
+/// once, at a fixed tick on a thread of its own, so that how much work the
+/// world does is decoupled from how input and rendering are scheduled.
+/// A simulation that has not been started is advanced by calling step(),
+/// which makes its behaviour deterministic for tools and benchmarks.
+//* =========================================================================
+class simulation
+{
+public :
+    //* =====================================================================
+    /// \brief Constructor
+    //* =====================================================================
+    explicit simulation(std::shared_ptr<world> shared_world);
+
+    //* =====================================================================
+    /// \brief Destructor.  Stops the simulation if it is running.
+    //* =====================================================================
+    ~simulation();
+
+    //* =====================================================================
+    /// \brief Starts a thread that calls step() once every tick.
+    //* =====================================================================
+    void start(std::chrono::nanoseconds tick);
+
+    //* =====================================================================
+    /// \brief Stops the thread started by start(), if any.
+    //* =====================================================================
+    void stop();
+
+    //* =====================================================================
+    /// \brief Returns whether the simulation's thread is running.
+    //* =====================================================================
+    bool running() const
+    {
+        return running_;
+    }
+
+    //* =====================================================================
+    /// \brief Applies every queued command and publishes the new state of
+    /// each player that changed.
+    //* =====================================================================
+    void step();
+
+private :
+    friend class player;
+
+    void run(std::chrono::nanoseconds tick);
+
+    std::shared_ptr<world> world_;
+
+    // Held for the whole of a step, so that a player that has left the
+    // list can wait for the step that might still be telling it.
+    std::mutex step_mutex_;
+
+    // Held only while the list of players is read or changed.
+    std::mutex players_mutex_;
+    std::vector<player *> players_;
+
+    // The players that changed in the current step.  Used only under the
+    // step mutex, and kept between steps so that it does not allocate.
+    std::vector<player *> updated_;
+
+    std::mutex stop_mutex_;
+    std::condition_variable stop_condition_;
+    bool stopping_ = false;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
+
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include "render.hpp"
+#include "terminal_profile.hpp"
+#include "vector2d.hpp"
+#include "world.hpp"
+#include <serverpp/core.hpp>
+#include <terminalpp/extent.hpp>
+#include <boost/asio/io_context.hpp>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace textray {
+
+//* =========================================================================
+/// \brief An encoded frame of a spectator feed.  The same bytes are shared
+/// by every spectator that receives the frame.
+//* =========================================================================
+using spectator_frame = std::shared_ptr<serverpp::byte_storage const>;
+
+//* =========================================================================
+/// \brief A player's view, as seen by those watching them.
+/// \par
+/// The player's client tells the feed where its camera is.  While anyone
+/// is watching, the feed renders and encodes each frame once for each size
+/// and profile of terminal and palette being watched with, on a strand of
+/// its own, and hands the same encoded bytes to every spectator watching
+/// that way.
+/// The feed's lock is held only to take the camera and to hand out frames,
+/// so that the player never waits for frames to be encoded.
+/// \par
+/// Frames are encoded as changes to the one before, so a spectator that
+/// joins is first sent a frame encoded in full for it alone, along with
+/// any others that joined at the same time, rather than restarting the
+/// stream of those already watching.  Such streams are merged back
+/// together as they grow.
+//* =========================================================================
+class spectator_feed
+{
+public :
+    //* =====================================================================
+    /// \brief Constructor
+    /// \param subject the entity whose view this is, which is not drawn.
+    //* =====================================================================
+    spectator_feed(
+        boost::asio::io_context &io_context,
+        std::shared_ptr<world> shared_world,
+        entity_id subject,
+        vector2d position,
+        double heading,
+        double fov);
+
+    //* =====================================================================
+    /// \brief Destructor.  Those watching are sent no further frames, and
+    /// are told that the feed has closed.
+    //* =====================================================================
+    ~spectator_feed();
+
+    spectator_feed(spectator_feed const &) = delete;
+    spectator_feed &operator=(spectator_feed const &) = delete;
+
+    //* =====================================================================
+    /// \brief Returns the entity whose view this is.
+    //* =====================================================================
+    entity_id subject() const;
+
+    //* =====================================================================
+    /// \brief Moves the camera to the specified position and heading.
+    //* =====================================================================
+    void move_to(vector2d position, double heading);
+
+    //* =====================================================================
+    /// \brief Sets the camera's horizontal field of view, in radians.
+    //* =====================================================================
+    void set_fov(double fov);
+
+    //* =====================================================================
+    /// \brief Renders the view again, for example because something in it
+    /// has changed.
+    //* =====================================================================
+    void redraw();
+
+private :
+    friend class spectator;
+
+    struct impl;
+    std::shared_ptr<impl> pimpl_;
+};
+
+//* =========================================================================
+/// \brief Someone watching a spectator feed.
+/// \par
+/// For as long as the spectator exists, its frame handler is called with
+/// each frame of the feed, starting with one encoded in full, until the
+/// feed is destroyed, when its close handler is called instead.  The
+/// handlers are called with the feed's lock held, so they must be cheap
+/// and must not call back into the feed.
+//* =========================================================================
+class spectator
+{
+public :
+    //* =====================================================================
+    /// \brief Constructor
+    /// \param profile the profile of the terminal being watched from, which
+    /// must outlive the spectator.
+    //* =====================================================================
+    spectator(
+        spectator_feed const &feed,
+        terminalpp::extent size,
+        terminal_profile const &profile,
+        palette colours,
+        std::function<void (spectator_frame const &)> on_frame,
+        std::function<void ()> on_closed);
+
+    //* =====================================================================
+    /// \brief Destructor.  Once this returns, the handler is not called
+    /// again.
+    //* =====================================================================
+    ~spectator();
+
+    spectator(spectator const &) = delete;
+    spectator &operator=(spectator const &) = delete;
+
+    //* =====================================================================
+    /// \brief Changes the size of terminal being watched from.  The next
+    /// frame is encoded in full.
+    //* =====================================================================
+    void resize(terminalpp::extent size);
+
+    //* =====================================================================
+    /// \brief Changes the palette being watched with.  The next frame is
+    /// encoded in full.
+    //* =====================================================================
+    void set_palette(palette colours);
+
+private :
+    friend struct spectator_feed::impl;
+
+    std::shared_ptr<spectator_feed::impl> feed_;
+    terminalpp::extent size_;
+    terminal_profile const &profile_;
+    palette colours_;
+    std::function<void (spectator_frame const &)> on_frame_;
+    std::function<void ()> on_closed_;
+};
+
+//* =========================================================================
+/// \brief The feeds of the players that can be watched, by entity.
+//* =========================================================================
+class spectator_directory
+{
+public :
+    //* =====================================================================
+    /// \brief Creates a feed of the subject's view and lists it for as
+    /// long as the feed exists.
+    //* =====================================================================
+    std::shared_ptr<spectator_feed> open(
+        boost::asio::io_context &io_context,
+        std::shared_ptr<world> shared_world,
+        entity_id subject,
+        vector2d position,
+        double heading,
+        double fov);
+
+    //* =====================================================================
+    /// \brief Returns the feed listed after that of the given subject, or
+    /// the first if it is no_entity, other than the viewer's own.  Returns
+    /// null after the last.
+    //* =====================================================================
+    std::shared_ptr<spectator_feed> next(entity_id viewer, entity_id after);
+
+private :
+    std::mutex mutex_;
+    std::map<entity_id, std::weak_ptr<spectator_feed>> feeds_;
+};
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace textray {
+
+//* =========================================================================
+/// \brief A bounded, lock-free queue with a single producer and a single
+/// consumer.
+/// \par
+/// The producer only writes the tail and the consumer only writes the
+/// head, each of which is on its own cache line, so that neither waits for
+/// the other and the two do not contend for the same line.  They are kept
+/// apart by padding rather than by over-alignment, since queues live in
+/// objects made with new, which under C++14 need not honour alignments
+/// above that of std::max_align_t.
+//* =========================================================================
+template <class T, std::size_t Capacity>
+class spsc_queue
+{
+    static_assert(
+        Capacity != 0 && (Capacity & (Capacity - 1)) == 0,
+        "capacity must be a power of two");
+
+public :
+    //* =====================================================================
+    /// \brief Adds an item to the queue.  Must only be called by the
+    /// producer.  Returns false, without adding it, if the queue is full.
+    //* =====================================================================
+    bool push(T const &item)
+    {
+        auto const tail = tail_.load(std::memory_order_relaxed);
+
+        if (tail - head_.load(std::memory_order_acquire) == Capacity)
+        {
+            return false;
+        }
+
+        items_[tail & (Capacity - 1)] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    //* =====================================================================
+    /// \brief Removes the oldest item from the queue into item.  Must only
+    /// be called by the consumer.  Returns false if the queue is empty.
+    //* =====================================================================
+    bool pop(T &item)
+    {
+        auto const head = head_.load(std::memory_order_relaxed);
+
+        if (head == tail_.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        item = items_[head & (Capacity - 1)];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private :
+    using index = std::atomic<std::size_t>;
+    static constexpr std::size_t cache_line_size = 64;
+
+    // Each index is a whole cache line from anything else that is written,
+    // wherever the queue is placed, so that no line holds two of them.
+    char leading_padding_[cache_line_size];
+    index head_{0};
+    char head_padding_[cache_line_size];
+    index tail_{0};
+    char tail_padding_[cache_line_size];
+    std::array<T, Capacity> items_;
+};
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "transport.hpp"
+#include <serverpp/tcp_socket.hpp>
+
+namespace textray {
+
+//* =========================================================================
+/// \brief A transport that carries data over a TCP socket.
+//* =========================================================================
+class tcp_transport final : public transport
+{
+public :
+    //* =====================================================================
+    /// \brief Constructor
+    //* =====================================================================
+    explicit tcp_transport(serverpp::tcp_socket &&socket);
+
+    bool is_alive() const override;
+    void close() override;
+    void async_read(
+        std::function<void (serverpp::bytes)> const &continuation) override;
+    void write(serverpp::bytes data) override;
+
+private :
+    serverpp::tcp_socket socket_;
+};
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "render.hpp"
+#include <serverpp/core.hpp>
+#include <terminalpp/behaviour.hpp>
+#include <string>
+
+namespace textray {
+
+//* =========================================================================
+/// \brief What a type of terminal is known to support.  Anything not known
+/// is assumed to be unsupported.
+//* =========================================================================
+struct terminal_profile
+{
+    /// The terminal type that the profile was made for, in lower case.
+    std::string type;
+
+    /// How many colours the terminal can show.
+    colour_depth colours = colour_depth::low;
+
+    /// Whether the terminal reports mouse clicks.
+    bool mouse = false;
+
+    /// Whether the terminal can show a frame all at once (DEC mode 2026).
+    bool synchronized_output = false;
+
+    /// Whether the terminal's title can be set with a sequence ending in
+    /// BEL.
+    bool window_title = false;
+};
+
+//* =========================================================================
+/// \brief Returns the profile of the given terminal type.
+/// \par
+/// Profiles are made the first time that a type is asked for and kept for
+/// the life of the process, so that clients of the same type share one and
+/// the reference returned stays valid.  Clients look at the profile's
+/// members rather than at the type, so that nothing compares terminal
+/// types once a client is connected.
+//* =========================================================================
+terminal_profile const &terminal_profile_for(std::string const &type);
+
+//* =========================================================================
+/// \brief Returns how a terminal with the given profile is to be encoded
+/// for.
+//* =========================================================================
+terminalpp::behaviour terminal_behaviour(terminal_profile const &profile);
+
+//* =========================================================================
+/// \brief Sent before and after a frame to a terminal whose profile
+/// supports synchronized output, so that it shows the frame all at once.
+//* =========================================================================
+extern serverpp::byte const begin_synchronized_update[8];
+extern serverpp::byte const end_synchronized_update[8];
+
+}
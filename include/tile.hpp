@@ -1,12 +1,14 @@
 #pragma once
 
-#include <terminalpp/element.hpp>
+#include <cstdint>
 
 namespace textray {
-    
-struct tile
-{
-    terminalpp::element fill;
-};
 
-}
\ No newline at end of file
+//* =========================================================================
+/// \brief A single cell of a floorplan.  A tile of 0 is open space; any
+/// other value is a solid wall.  Walls 1 to 7 are drawn in the ANSI colour
+/// of the same index, and higher values repeat those seven colours.
+//* =========================================================================
+using tile = std::uint8_t;
+
+}
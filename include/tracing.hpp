@@ -0,0 +1,93 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace textray {
+
+//* =========================================================================
+/// \brief Identifies a sampled input event as it makes its way through
+/// the server.  A trace id of 0 means that the event is not being traced.
+//* =========================================================================
+using trace_id = std::uint64_t;
+
+//* =========================================================================
+/// \brief The stages through which an input event passes on its way to
+/// becoming output on the wire.
+//* =========================================================================
+enum class trace_stage : std::uint8_t
+{
+    read,
+    keypress,
+    camera_update,
+    repaint,
+    render,
+    encode,
+    compress,
+    write
+};
+
+//* =========================================================================
+/// \brief Sets the proportion of input events that are traced: one in
+/// every n.  0 disables tracing, which is the default.
+//* =========================================================================
+void set_trace_sampling(unsigned int one_in_n);
+
+//* =========================================================================
+/// \brief Returns a new trace id if the current input event is sampled,
+/// or 0 otherwise.
+//* =========================================================================
+trace_id begin_trace();
+
+//* =========================================================================
+/// \brief Returns the trace id of the event that the calling thread is
+/// currently processing, or 0 if there is none.
+//* =========================================================================
+trace_id current_trace();
+
+//* =========================================================================
+/// \brief Makes the given trace current on the calling thread for the
+/// lifetime of the object, so that spans opened by code that it calls
+/// are attributed to it.
+//* =========================================================================
+class trace_scope
+{
+public :
+    explicit trace_scope(trace_id id);
+    ~trace_scope();
+
+    trace_scope(trace_scope const &) = delete;
+    trace_scope &operator=(trace_scope const &) = delete;
+
+private :
+    trace_id previous_;
+};
+
+//* =========================================================================
+/// \brief Records the lifetime of the object as a stage of a trace in the
+/// calling thread's ring buffer.  Does nothing if the trace id is 0.
+//* =========================================================================
+class trace_span
+{
+public :
+    trace_span(trace_id id, trace_stage stage);
+    explicit trace_span(trace_stage stage);
+    ~trace_span();
+
+    trace_span(trace_span const &) = delete;
+    trace_span &operator=(trace_span const &) = delete;
+
+private :
+    trace_id id_;
+    trace_stage stage_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+//* =========================================================================
+/// \brief Returns the spans currently held in every thread's ring buffer
+/// in the Chrome trace event JSON format.
+//* =========================================================================
+std::string trace_json();
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <serverpp/core.hpp>
+#include <functional>
+
+namespace textray {
+
+//* =========================================================================
+/// \brief An interface to the byte stream that underlies a connection,
+/// allowing it to be carried by something other than a TCP socket.
+//* =========================================================================
+class transport
+{
+public :
+    //* =====================================================================
+    /// \brief Destructor
+    //* =====================================================================
+    virtual ~transport() = default;
+
+    //* =====================================================================
+    /// \brief Returns whether the other end of the transport is still
+    ///        connected.
+    //* =====================================================================
+    virtual bool is_alive() const = 0;
+
+    //* =====================================================================
+    /// \brief Closes the transport.
+    //* =====================================================================
+    virtual void close() = 0;
+
+    //* =====================================================================
+    /// \brief Asynchronously reads from the transport, calling the
+    ///        continuation once with whatever data arrives.  If the
+    ///        transport dies, the continuation is called with no data.
+    //* =====================================================================
+    virtual void async_read(
+        std::function<void (serverpp::bytes)> const &continuation) = 0;
+
+    //* =====================================================================
+    /// \brief Writes to the transport.
+    //* =====================================================================
+    virtual void write(serverpp::bytes data) = 0;
+};
+
+}
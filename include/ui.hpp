@@ -1,8 +1,11 @@
 #pragma once
 
-#include "floorplan.hpp"
+#include "render.hpp"
 #include "vector2d.hpp"
+#include "visibility_set.hpp"
+#include "world.hpp"
 #include <munin/composite_component.hpp>
+#include <cstdint>
 #include <memory>
 
 namespace textray {
@@ -10,11 +13,22 @@ namespace textray {
 class ui : public munin::composite_component
 {
 public :
-    ui(std::shared_ptr<floorplan> plan, vector2d position, double heading, double fov);
+    ui(
+        std::shared_ptr<world> shared_world,
+        entity_id viewer,
+        vector2d position,
+        double heading,
+        double fov);
     ~ui();
     
     void move_camera_to(vector2d const &position, double heading);
     void set_camera_fov(double fov);
+    void set_camera_palette(palette colours);
+    void redraw_camera();
+    void redraw();
+    std::uint64_t prepare_frame();
+
+    visibility_set const &camera_visibility() const;
     
 private :
     struct impl;
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "vector2d.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace textray {
+
+//* =========================================================================
+/// \brief The parts of the world that a view could show: the coarse grid
+/// cells through which its rays passed in the last frame.
+/// \par
+/// Cells are 8x8 tiles.  They are held as a bitset over the bounding box
+/// of the view, so that testing a tile is a single bit lookup and copying
+/// the set does not allocate once its storage has grown.
+//* =========================================================================
+class visibility_set
+{
+public :
+    static constexpr int cell_bits = 3;
+
+    //* =====================================================================
+    /// \brief Empties the set and sizes it to cover the cells under the
+    /// given rectangle of tiles (inclusive).
+    //* =====================================================================
+    void reset(int min_x, int min_y, int max_x, int max_y);
+
+    //* =====================================================================
+    /// \brief Adds the cells through which the line between two points
+    /// passes.  Both must lie within the rectangle given to reset().
+    //* =====================================================================
+    void add_segment(vector2d from, vector2d to);
+
+    //* =====================================================================
+    /// \brief Returns whether the cell holding the given tile is in the
+    /// set.
+    //* =====================================================================
+    bool contains(int x, int y) const;
+
+    //* =====================================================================
+    /// \brief Returns whether any cell under the given rectangle is in the
+    /// set.
+    //* =====================================================================
+    bool intersects(vector2d minimum, vector2d maximum) const;
+
+    //* =====================================================================
+    /// \brief Calls function(cell_x, cell_y) for each cell in the set.
+    //* =====================================================================
+    template <class Function>
+    void for_each_cell(Function &&function) const
+    {
+        for (std::size_t word = 0; word < bits_.size(); ++word)
+        {
+            for (auto bits = bits_[word]; bits != 0; bits &= bits - 1)
+            {
+                auto const bit = word * 64 + std::size_t(__builtin_ctzll(bits));
+
+                function(
+                    origin_x_ + int(bit % width_),
+                    origin_y_ + int(bit / width_));
+            }
+        }
+    }
+
+    //* =====================================================================
+    /// \brief Returns the cell that holds the given coordinate, in either
+    /// axis.
+    //* =====================================================================
+    static int cell_of(double coordinate);
+
+private :
+    void add_cell(int cell_x, int cell_y);
+    bool contains_cell(int cell_x, int cell_y) const;
+
+    int origin_x_ = 0;
+    int origin_y_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+    std::vector<std::uint64_t> bits_;
+};
+
+}
@@ -0,0 +1,325 @@
+#pragma once
+
+#include "entity_store.hpp"
+#include "floorplan.hpp"
+#include "map_file.hpp"
+#include "tile.hpp"
+#include "visibility_set.hpp"
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace textray {
+
+class view_subscription;
+
+//* =========================================================================
+/// \brief A change to a single tile, such as a door opening.
+//* =========================================================================
+struct tile_change
+{
+    int x;
+    int y;
+    tile value;
+};
+
+//* =========================================================================
+/// \brief An immutable view of the world at one moment.
+/// \par
+/// Tiles are stored in square chunks, which are grouped into square
+/// regions.  Both are shared between successive snapshots, so that changing
+/// a tile copies only the chunk that contains it, that chunk's region's
+/// table of chunks and the table of regions, which is small whatever the
+/// size of the world.
+//* =========================================================================
+class world_snapshot
+{
+public :
+    static constexpr int chunk_bits = map_file::chunk_bits;
+    static constexpr int chunk_size = 1 << chunk_bits;
+    static constexpr int region_bits = 4;  // in chunks
+    static constexpr int region_size = 1 << region_bits;
+
+    //* =====================================================================
+    /// \brief Constructor
+    /// \par
+    /// Constructs a snapshot with the same tiles as the floorplan.
+    //* =====================================================================
+    explicit world_snapshot(floorplan const &plan);
+
+    //* =====================================================================
+    /// \brief Constructor
+    /// \par
+    /// Constructs a snapshot of a mapped map file.  If the file's chunks
+    /// are the same size as a snapshot's, they are used in place, and only
+    /// chunks that are later changed are copied.
+    //* =====================================================================
+    explicit world_snapshot(std::shared_ptr<map_file const> const &file);
+
+    //* =====================================================================
+    /// \brief Returns the number of columns in the world.
+    //* =====================================================================
+    int width() const
+    {
+        return width_;
+    }
+
+    //* =====================================================================
+    /// \brief Returns the number of rows in the world.
+    //* =====================================================================
+    int height() const
+    {
+        return height_;
+    }
+
+    //* =====================================================================
+    /// \brief Returns whether the given co-ordinate lies in the world.
+    //* =====================================================================
+    bool contains(int x, int y) const
+    {
+        return x >= 0 && y >= 0 && x < width_ && y < height_;
+    }
+
+    //* =====================================================================
+    /// \brief Returns the tile at the given co-ordinate, which must lie in
+    /// the world.
+    //* =====================================================================
+    tile tile_at(int x, int y) const
+    {
+        auto const chunk_x = x >> chunk_bits;
+        auto const chunk_y = y >> chunk_bits;
+        auto const &chunks = regions_[
+            (chunk_y >> region_bits) * regions_wide_ + (chunk_x >> region_bits)]->chunks;
+        auto const &tiles = chunks[
+            (chunk_y & (region_size - 1)) * region_size + (chunk_x & (region_size - 1))]->tiles;
+        return tiles[(y & (chunk_size - 1)) * chunk_size + (x & (chunk_size - 1))];
+    }
+
+    //* =====================================================================
+    /// \brief Returns a number that increases with every change to the
+    /// world.
+    //* =====================================================================
+    std::uint64_t version() const
+    {
+        return version_;
+    }
+
+    //* =====================================================================
+    /// \brief Returns a new snapshot that differs from this one only in
+    /// the given tile.
+    //* =====================================================================
+    std::shared_ptr<world_snapshot const> with_tile(int x, int y, tile value) const;
+
+    //* =====================================================================
+    /// \brief Returns a new snapshot that differs from this one only in
+    /// the given tiles.  Each chunk and region that they touch is copied
+    /// once, however many of them it contains.
+    //* =====================================================================
+    std::shared_ptr<world_snapshot const> with_tiles(
+        std::vector<tile_change> const &changes) const;
+
+private :
+    struct chunk
+    {
+        std::array<tile, chunk_size * chunk_size> tiles;
+    };
+
+    struct region
+    {
+        std::array<std::shared_ptr<chunk const>, region_size * region_size> chunks;
+    };
+
+    world_snapshot() = default;
+
+    template <class MakeChunk>
+    void build(MakeChunk &&make_chunk);
+
+    int width_;
+    int height_;
+    int regions_wide_;
+    std::uint64_t version_;
+    std::vector<std::shared_ptr<region const>> regions_;
+};
+
+//* =========================================================================
+/// \brief An entity as seen by a viewer.
+//* =========================================================================
+struct entity_sighting
+{
+    entity_id id;
+    vector2d position;
+    double heading;
+    std::uint8_t appearance;
+};
+
+//* =========================================================================
+/// \brief The world shared by every client.
+/// \par
+/// Readers take the current snapshot once per frame and then read it
+/// without any synchronisation.  Writers build a new snapshot from the
+/// current one and publish it with an atomic pointer swap; they are
+/// serialised among themselves but never wait for readers.
+/// \par
+/// The world also holds the entities that move around it.  These change
+/// far more often than tiles, so rather than being snapshotted they are
+/// kept in a single store behind a reader-writer lock.
+/// \par
+/// Views subscribe to be told of changes.  Subscriptions are indexed by
+/// the cells that each view last saw, so that a change is matched only
+/// against the views that could show it, however many others there are.
+//* =========================================================================
+class world
+{
+public :
+    //* =====================================================================
+    /// \brief Constructor.  Players enter at the open tile nearest the
+    /// centre of the plan.
+    //* =====================================================================
+    explicit world(floorplan const &plan);
+
+    //* =====================================================================
+    /// \brief Constructor.  Players enter at the given position.
+    //* =====================================================================
+    world(floorplan const &plan, vector2d spawn_point);
+
+    //* =====================================================================
+    /// \brief Constructor.  Players enter at the open tile nearest the
+    /// centre of the map.
+    //* =====================================================================
+    explicit world(std::shared_ptr<map_file const> const &file);
+
+    //* =====================================================================
+    /// \brief Returns where players enter the world.
+    //* =====================================================================
+    vector2d spawn_point() const
+    {
+        return spawn_point_;
+    }
+
+    //* =====================================================================
+    /// \brief Returns the current snapshot of the world.
+    //* =====================================================================
+    std::shared_ptr<world_snapshot const> snapshot() const
+    {
+        return std::atomic_load(&current_);
+    }
+
+    //* =====================================================================
+    /// \brief Changes a tile of the world.
+    //* =====================================================================
+    void set_tile(int x, int y, tile value);
+
+    //* =====================================================================
+    /// \brief Changes several tiles of the world at once, publishing a
+    /// single new snapshot.
+    //* =====================================================================
+    void set_tiles(std::vector<tile_change> const &changes);
+
+    //* =====================================================================
+    /// \brief Adds an entity to the world and returns its id.
+    //* =====================================================================
+    entity_id add_entity(
+        vector2d position, double heading, std::uint8_t appearance);
+
+    //* =====================================================================
+    /// \brief Removes an entity from the world.
+    //* =====================================================================
+    void remove_entity(entity_id id);
+
+    //* =====================================================================
+    /// \brief Moves an entity.
+    //* =====================================================================
+    void move_entity(entity_id id, vector2d position, double heading);
+
+    //* =====================================================================
+    /// \brief Appends to out the entities within range of the given
+    /// position and inside the field of view, other than the viewer's own.
+    //* =====================================================================
+    void visible_entities(
+        entity_id viewer,
+        vector2d position,
+        double heading,
+        double fov,
+        double range,
+        std::vector<entity_sighting> &out) const;
+
+private :
+    friend class view_subscription;
+
+    void notify_tile(int x, int y);
+    void notify_entity(entity_id id, vector2d from, vector2d to);
+
+    void watch_cell(std::uint64_t cell, view_subscription *subscription);
+    void unwatch_cell(std::uint64_t cell, view_subscription *subscription);
+
+    std::mutex write_mutex_;
+    std::shared_ptr<world_snapshot const> current_;
+    vector2d spawn_point_;
+
+    mutable std::shared_timed_mutex entities_mutex_;
+    entity_store entities_;
+
+    // The subscriptions whose views could show each cell.  Cells that
+    // nobody can see any more keep their empty lists, so that views moving
+    // back and forth do not allocate.
+    std::shared_timed_mutex subscriptions_mutex_;
+    std::unordered_map<std::uint64_t, std::vector<view_subscription *>>
+        watchers_;
+};
+
+//* =========================================================================
+/// \brief A view's subscription to changes in the world.
+/// \par
+/// For as long as the subscription exists, its handler is called whenever
+/// a tile or entity changes within the cells last published to it.  The
+/// handler is called on the thread that made the change, so it must be
+/// cheap and must not call back into the world.
+//* =========================================================================
+class view_subscription
+{
+public :
+    //* =====================================================================
+    /// \brief Constructor
+    /// \param viewer the entity whose view this is, changes to which are
+    /// not reported, or no_entity.
+    //* =====================================================================
+    view_subscription(
+        world &watched,
+        entity_id viewer,
+        std::function<void ()> on_change);
+
+    //* =====================================================================
+    /// \brief Destructor.  Once this returns, the handler is not called
+    /// again.
+    //* =====================================================================
+    ~view_subscription();
+
+    view_subscription(view_subscription const &) = delete;
+    view_subscription &operator=(view_subscription const &) = delete;
+
+    //* =====================================================================
+    /// \brief Replaces the cells that the view could show.  Only the cells
+    /// that differ from those last published are re-indexed.  Must not be
+    /// called from more than one thread at once.
+    //* =====================================================================
+    void publish(visibility_set const &visible);
+
+private :
+    friend class world;
+
+    world &world_;
+    entity_id viewer_;
+    std::function<void ()> on_change_;
+
+    // The cells under which the subscription is indexed, in order, and a
+    // buffer in which publish() gathers their replacements.
+    std::vector<std::uint64_t> cells_;
+    std::vector<std::uint64_t> next_cells_;
+};
+
+}
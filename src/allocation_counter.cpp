@@ -0,0 +1,56 @@
+#include "allocation_counter.hpp"
+
+namespace textray {
+
+namespace {
+
+thread_local allocation_count thread_count{};
+thread_local allocation_count site_counts[std::size_t(allocation_site::count_)]{};
+
+}
+
+// ==========================================================================
+// THREAD_ALLOCATION_COUNT
+// ==========================================================================
+allocation_count thread_allocation_count()
+{
+    return thread_count;
+}
+
+// ==========================================================================
+// THREAD_ALLOCATION_COUNT (SITE)
+// ==========================================================================
+allocation_count thread_allocation_count(allocation_site site)
+{
+    return site_counts[std::size_t(site)];
+}
+
+// ==========================================================================
+// SCOPED_ALLOCATION_COUNTER
+// ==========================================================================
+scoped_allocation_counter::scoped_allocation_counter(allocation_site site)
+  : site_(site),
+    start_(thread_count)
+{
+}
+
+scoped_allocation_counter::~scoped_allocation_counter()
+{
+    auto &count = site_counts[std::size_t(site_)];
+    count.allocations += thread_count.allocations - start_.allocations;
+    count.bytes += thread_count.bytes - start_.bytes;
+}
+
+namespace detail {
+
+// ==========================================================================
+// THREAD_ALLOCATION_TALLY
+// ==========================================================================
+allocation_count &thread_allocation_tally()
+{
+    return thread_count;
+}
+
+}
+
+}
@@ -0,0 +1,36 @@
+#include "allocation_counter.hpp"
+#include <cstdlib>
+#include <new>
+
+// ==========================================================================
+// OPERATOR NEW
+// ==========================================================================
+void *operator new(std::size_t size)
+{
+    auto &tally = textray::detail::thread_allocation_tally();
+    ++tally.allocations;
+    tally.bytes += size;
+
+    if (auto *ptr = std::malloc(size == 0 ? 1 : size))
+    {
+        return ptr;
+    }
+
+    throw std::bad_alloc{};
+}
+
+// ==========================================================================
+// OPERATOR DELETE
+// ==========================================================================
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+// ==========================================================================
+// OPERATOR DELETE (SIZED)
+// ==========================================================================
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
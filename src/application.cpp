@@ -1,9 +1,20 @@
 #include "application.hpp"
+#include "client_usage.hpp"
 #include "connection.hpp"
 #include "client.hpp"
+#include "frame_cache.hpp"
+#include "metrics.hpp"
+#include "metrics_server.hpp"
+#include "session_recording.hpp"
+#include "simulation.hpp"
+#include "spectator.hpp"
+#include "tracing.hpp"
 #include <serverpp/tcp_server.hpp>
 #include <boost/make_unique.hpp>
 #include <boost/range/algorithm/find_if.hpp>
+#include <boost/format.hpp>
+#include <iostream>
+#include <stdexcept>
 #include <utility>
 
 namespace textray {
@@ -17,7 +28,13 @@ public :
     // ======================================================================
     // CONSTRUCTOR
     // ======================================================================
-    impl(boost::asio::io_context &io_context, serverpp::port_identifier port)
+    impl(
+        boost::asio::io_context &io_context, 
+        serverpp::port_identifier port,
+        std::string recording_directory,
+        serverpp::port_identifier metrics_port,
+        std::shared_ptr<world> shared_world,
+        unsigned int tick_rate)
       : server_(
             io_context, 
             port,
@@ -25,8 +42,33 @@ public :
             {
                 on_accept(std::move(new_socket));
             }),
-        io_context_(io_context)
+        io_context_(io_context),
+        recording_directory_(std::move(recording_directory)),
+        world_(std::move(shared_world)),
+        spectators_(std::make_shared<spectator_directory>()),
+        frames_(std::make_shared<frame_cache>())
     {
+        if (tick_rate != 0)
+        {
+            simulation_ = std::make_shared<simulation>(world_);
+            simulation_->start(std::chrono::nanoseconds(
+                std::chrono::seconds(1)) / tick_rate);
+        }
+
+        if (metrics_port != 0)
+        {
+            metrics_server_ = boost::make_unique<metrics_server>(
+                io_context, metrics_port);
+            metrics_server_->add_page(
+                "/trace",
+                "application/json",
+                [](std::string const &)
+                {
+                    return trace_json();
+                });
+            metrics_server_->add_page(
+                "/clients", "text/plain", client_usage_text);
+        }
     }
 
     // ======================================================================
@@ -35,6 +77,17 @@ public :
     void shutdown()
     {
         server_.shutdown();
+
+        if (metrics_server_)
+        {
+            metrics_server_->shutdown();
+        }
+
+        if (simulation_)
+        {
+            simulation_->stop();
+        }
+
         close_all_connections();
     }
 
@@ -44,6 +97,8 @@ private :
     // ======================================================================
     void on_accept(serverpp::tcp_socket &&new_socket)
     {
+        count(metric_counter::connections_accepted);
+
         auto new_client = boost::make_unique<client>(
             connection(std::move(new_socket)),
             io_context_,
@@ -54,12 +109,42 @@ private :
             [this]()
             {
                 shutdown();
-            });
+            },
+            create_recorder(),
+            world_,
+            simulation_,
+            spectators_,
+            frames_);
 
         auto clients_lock = std::unique_lock<std::mutex>(clients_mutex_);
         clients_.push_back(std::move(new_client));
     }
 
+    // ======================================================================
+    // CREATE_RECORDER
+    // ======================================================================
+    // Returns a recorder for a new session, or null if sessions are not
+    // being recorded.  A recording that cannot be created is reported, and
+    // the session carries on without one.
+    // ======================================================================
+    std::shared_ptr<session_recorder> create_recorder()
+    {
+        if (recording_directory_.empty())
+        {
+            return nullptr;
+        }
+
+        try
+        {
+            return session_recorder::create_in(recording_directory_);
+        }
+        catch (std::runtime_error const &err)
+        {
+            std::cerr << boost::format("WARNING: %s\n") % err.what();
+            return nullptr;
+        }
+    }
+
     // ======================================================================
     // CLOSE_ALL_CONNECTIONS
     // ======================================================================
@@ -93,6 +178,12 @@ private :
 
     serverpp::tcp_server server_;
     boost::asio::io_context &io_context_;
+    std::string recording_directory_;
+    std::unique_ptr<metrics_server> metrics_server_;
+    std::shared_ptr<world> world_;
+    std::shared_ptr<simulation> simulation_;
+    std::shared_ptr<spectator_directory> spectators_;
+    std::shared_ptr<frame_cache> frames_;
 
     std::mutex clients_mutex_;
     std::vector<std::unique_ptr<client>> clients_;
@@ -103,8 +194,18 @@ private :
 // ==========================================================================
 application::application(
     boost::asio::io_context &io_context,
-    serverpp::port_identifier port)
-    : pimpl_(boost::make_unique<impl>(io_context, port))
+    serverpp::port_identifier port,
+    std::string recording_directory,
+    serverpp::port_identifier metrics_port,
+    std::shared_ptr<world> shared_world,
+    unsigned int tick_rate)
+    : pimpl_(boost::make_unique<impl>(
+          io_context, 
+          port, 
+          std::move(recording_directory), 
+          metrics_port,
+          std::move(shared_world),
+          tick_rate))
 {
 }
 
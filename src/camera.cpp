@@ -1,191 +1,52 @@
 #include "camera.hpp"
+#include "allocation_counter.hpp"
+#include "client_usage.hpp"
+#include "frame_cache.hpp"
+#include "metrics.hpp"
+#include "probes.hpp"
+#include "tracing.hpp"
+#include "render.hpp"
 #include <math.h>
-#include <vector2d.hpp>
 
-static void render_ceiling(
-    std::vector<terminalpp::string> &content,
-    terminalpp::extent size)
-{
-    using namespace terminalpp::literals;
-    static auto const ceiling_brush = "\\[7="_ets[0];
-    
-    auto const max_ceiling_row = size.height_ / 2;
-
-    for (int row = 0; row < max_ceiling_row; ++row)
-    {
-        content.emplace_back(size.width_, ceiling_brush);
-    }
-}
-
-static void render_floor(
-    std::vector<terminalpp::string> &content,
-    terminalpp::extent size)
-{
-    using namespace terminalpp::literals;
-    static auto const floor_brush = "\\[4#"_ets[0];
-    
-    auto const min_floor_row = size.height_ / 2;
-    for (int row = min_floor_row; row < size.height_; ++row)
-    {
-        content.emplace_back(size.width_, floor_brush);
-    }
-}
-
-static void render_walls(
-    std::vector<terminalpp::string> &content,
-    textray::floorplan const& plan,
-    textray::vector2d const& position,
-    double heading,
-    double fov)
-{
-    static const double TEXTEL_ASPECT = 2.0;  // textel_height / textel_width
-    static const double WALL_HEIGHT   = 1.0;  // height of walls, in world units
-
-    // FoV has to be between 0 and 180 degrees (exclusive).
-    assert(fov > 0.0001);
-    assert(fov < M_PI - 0.0001);
-    
-    const auto view_height = int(content.size());
-    if (view_height == 0)
-    {
-        return;
-    }
-    
-    const auto view_width  = int(content[0].size());
-    if (view_width == 0)
-    {
-        return;
-    }
-    
-    // identify components of a unit vector in the direction of the camera
-    // heading and a plane perpendicular to it on which the textels(!) are
-    // rendered.
-    const auto dir   = textray::vector2d::from_angle(heading);
-    const auto right = textray::vector2d::from_angle(heading - M_PI/2);
-    
-    // Calculate the linear scale of the vertical FoV based on the viewport's aspect ratio
-    // (taking the textel aspect ratio into consideration as well).
-    const double tanHalfFov = tan(fov / 2);
-    const double fovScaleY = tanHalfFov / view_width * view_height * TEXTEL_ASPECT;
-
-    for (terminalpp::coordinate_type x = 0; x < view_width; ++x)
-    {
-        // calculate (normalized) ray direction
-        double camerax = 2 * (x + 0.5) / view_width - 1; // x-coordinate in camera space (range [-1,+1])
-        textray::vector2d ray = normalize(dir / tanHalfFov + right * camerax);
-        
-        auto mapX = int(position.x);
-        auto mapY = int(position.y);
-        
-        //length of ray from current position to next x or y-side
-        double sideDistX;
-        double sideDistY;
-  
-        //length of ray from one x or y-side to next x or y-side
-        double deltaDistX = std::abs(1 / ray.x);
-        double deltaDistY = std::abs(1 / ray.y);
-  
-        //what direction to step in x or y-direction (either +1 or -1)
-        int stepX;
-        int stepY;
-        
-        //calculate step and initial sideDist
-        if (ray.x < 0)
-        {
-            stepX = -1;
-            sideDistX = (position.x - mapX) * deltaDistX;
-        }
-        else
-        {
-            stepX = 1;
-            sideDistX = (mapX + 1.0 - position.x) * deltaDistX;
-        }
-        if (ray.y < 0)
-        {
-            stepY = -1;
-            sideDistY = (position.y - mapY) * deltaDistY;
-        }
-        else
-        {
-            stepY = 1;
-            sideDistY = (mapY + 1.0 - position.y) * deltaDistY;
-        }
-        
-        //perform DDA (Digital Differential Analysis)
-        double wallDist;
-        int side;
-        do
-        {
-            //jump to next map square, OR in x-direction, OR in y-direction
-            if (sideDistX < sideDistY)
-            {
-                wallDist = sideDistX;
-                sideDistX += deltaDistX;
-                mapX += stepX;
-                side = 0;
-            }
-            else
-            {
-                wallDist = sideDistY;
-                sideDistY += deltaDistY;
-                mapY += stepY;
-                side = 1;
-            }
-        
-            //Check if ray has hit a wall
-            // TODO: fix when fill is more than a character code.
-        } while (plan[mapY][mapX].fill.glyph_.character_ == 0);
-
-        // Calculate distance projected on camera direction (direct distance along ray will give fisheye effect!)
-        const auto perpWallDist = dot(wallDist * ray, dir);
-        if (perpWallDist > 0.001)
-        {
-            // Calculate height of line to draw on screen.
-            // Correct for the textel aspect ratio to make sure the height is correct on the screen.
-            auto lineHeight = view_height * WALL_HEIGHT / perpWallDist / fovScaleY / TEXTEL_ASPECT;
-  
-            // Calculate lowest and highest textel to fill in current stripe
-            int drawStart = std::max( (int)round(view_height / 2.0 - lineHeight / 2), 0);
-            int drawEnd   = std::min( (int)round(view_height / 2.0 + lineHeight / 2), view_height);
-        
-            for (terminalpp::coordinate_type row = drawStart; row < drawEnd; ++row)
-            {
-                terminalpp::element brush('o');
-                brush.attribute_.foreground_colour_ = terminalpp::graphics::colour(
-                  plan[mapY][mapX].fill.glyph_.character_);
-
-                if (side == 0)
-                {
-                    brush.attribute_.polarity_ = terminalpp::graphics::polarity::negative;
-                }
-
-                content[row][x] = brush;
-            }
-        }
-    }
-}
+// Entities further away than this are not drawn.
+static constexpr double sight_range = 32.0;
 
 static void render_camera_image(
     terminalpp::extent size,
-    munin::image& img,
-    textray::floorplan const& plan,
+    std::vector<terminalpp::string>& content,
+    std::vector<double>& depth,
+    textray::visibility_set& visible,
+    textray::world_snapshot const& plan,
+    std::vector<textray::entity_sighting> const& sightings,
+    std::vector<textray::projected_sprite>& sprites,
     textray::vector2d const& position,
     double heading,
-    double fov)
+    double fov,
+    textray::palette colours)
 {
-    std::vector<terminalpp::string> content;
-    render_ceiling(content, size);
-    render_floor(content, size);
-    render_walls(content, plan, position, heading, fov);
-    
-    img.set_content(content);    
+    textray::resize_content(content, size);
+    textray::render_ceiling(content, size);
+    textray::render_floor(content, size);
+    textray::render_walls(
+        content, plan, position, heading, fov, &depth, colours);
+
+    // Traced from the walls' depths, before sprites bring them forward:
+    // sprites are shorter than walls, so the wall behind one still shows.
+    textray::trace_view(visible, plan, depth, position, heading, fov);
+    textray::render_sprites(
+        content, depth, sightings, position, heading, fov, sprites);
 }
 
 namespace textray {
 
-camera::camera(std::shared_ptr<floorplan> plan, vector2d position, double heading, double fov)
-  : image_(std::make_shared<munin::image>()),
-    floorplan_(std::move(plan)),
+camera::camera(
+    std::shared_ptr<world> shared_world,
+    entity_id viewer,
+    vector2d position,
+    double heading,
+    double fov)
+  : world_(std::move(shared_world)),
+    viewer_(viewer),
     position_(std::move(position)),
     heading_(std::move(heading)),
     fov_(std::move(fov))
@@ -194,11 +55,14 @@ camera::camera(std::shared_ptr<floorplan> plan, vector2d position, double headin
 
 terminalpp::extent camera::do_get_preferred_size() const
 {
-    return image_->get_preferred_size();
+    return content_.empty()
+      ? terminalpp::extent(0, 0)
+      : terminalpp::extent(content_[0].size(), content_.size());
 }
 
 void camera::move_to(vector2d position, double heading)
 {
+    trace_span span(trace_stage::camera_update);
     position_ = std::move(position);
     heading_ = std::move(heading);
     on_redraw({
@@ -208,6 +72,7 @@ void camera::move_to(vector2d position, double heading)
 
 void camera::set_fov(double fov)
 {
+    trace_span span(trace_stage::camera_update);
     assert(fov > 0.0001);
     assert(fov < M_PI - 0.0001);
     fov_ = std::move(fov);
@@ -216,10 +81,58 @@ void camera::set_fov(double fov)
     });
 }
 
-void camera::do_set_size(terminalpp::extent const &size)
+void camera::set_palette(palette colours)
+{
+    colours_ = colours;
+    on_redraw({
+        terminalpp::rectangle({}, get_size())
+    });
+}
+
+void camera::redraw()
+{
+    on_redraw({
+        terminalpp::rectangle({}, get_size())
+    });
+}
+
+std::uint64_t camera::prepare_frame()
+{
+    gather();
+    prepared_ = true;
+
+    // The world is identified by its address, and its tiles by the
+    // snapshot's version within it.
+    auto const size = get_size();
+    auto hash = hash_combine(
+        std::uint64_t(reinterpret_cast<std::uintptr_t>(world_.get())),
+        snapshot_->version());
+    hash = hash_combine(hash, std::uint64_t(size.width_));
+    hash = hash_combine(hash, std::uint64_t(size.height_));
+    hash = hash_combine(hash, position_.x);
+    hash = hash_combine(hash, position_.y);
+    hash = hash_combine(hash, heading_);
+    hash = hash_combine(hash, fov_);
+    hash = hash_combine(hash, std::uint64_t(colours_));
+
+    for (auto const &sighting : sightings_)
+    {
+        hash = hash_combine(hash, std::uint64_t(sighting.id));
+        hash = hash_combine(hash, sighting.position.x);
+        hash = hash_combine(hash, sighting.position.y);
+        hash = hash_combine(hash, sighting.heading);
+        hash = hash_combine(hash, std::uint64_t(sighting.appearance));
+    }
+
+    return hash;
+}
+
+void camera::gather() const
 {
-    image_->set_size(size);
-    basic_component::do_set_size(size);
+    snapshot_ = world_->snapshot();
+    sightings_.clear();
+    world_->visible_entities(
+        viewer_, position_, heading_, fov_, sight_range, sightings_);
 }
 
 void camera::do_draw(
@@ -228,8 +141,35 @@ void camera::do_draw(
 {
     if (get_size() != terminalpp::extent(0, 0))
     {
-        render_camera_image(get_size(), *image_, *floorplan_, position_, heading_, fov_);
-        image_->draw(surface, region);    
+        scoped_allocation_counter allocations(allocation_site::camera_draw);
+        scoped_metric_timer timer(metric_histogram::render_duration);
+        trace_span span(trace_stage::render);
+        scoped_usage_cpu_timer cpu_timer(usage_metric::render_cpu_ns);
+        auto const size = get_size();
+        charge(usage_metric::cells_rendered, std::uint64_t(size.width_) * size.height_);
+        TEXTRAY_PROBE3(render__start, this, size.width_, size.height_);
+
+        if (!prepared_)
+        {
+            gather();
+        }
+
+        render_camera_image(
+            size, content_, depth_, visible_, *snapshot_, sightings_, sprites_,
+            position_, heading_, fov_, colours_);
+        TEXTRAY_PROBE3(render__end, this, size.width_, size.height_);
+
+        for (auto row = region.origin_.y_;
+             row < region.origin_.y_ + region.size_.height_;
+             ++row)
+        {
+            for (auto column = region.origin_.x_;
+                 column < region.origin_.x_ + region.size_.width_;
+                 ++column)
+            {
+                surface[column][row] = content_[row][column];
+            }
+        }
     }
 }
 
@@ -0,0 +1,339 @@
+#include "chunk_cache.hpp"
+#include <boost/make_unique.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace textray {
+
+constexpr int world_chunk::bits;
+constexpr int world_chunk::size;
+constexpr int chunk_view::slot_bits;
+
+namespace {
+
+using chunk_key = std::uint64_t;
+
+chunk_key make_key(int chunk_x, int chunk_y)
+{
+    return (std::uint64_t(std::uint32_t(chunk_x)) << 32) | std::uint32_t(chunk_y);
+}
+
+int key_x(chunk_key key)
+{
+    return int(std::uint32_t(key >> 32));
+}
+
+int key_y(chunk_key key)
+{
+    return int(std::uint32_t(key));
+}
+
+}
+
+// ==========================================================================
+// CHUNK_CACHE IMPLEMENTATION STRUCTURE
+// ==========================================================================
+struct chunk_cache::impl
+{
+    struct entry
+    {
+        std::shared_ptr<world_chunk const> chunk;
+        std::list<chunk_key>::iterator recency;
+    };
+
+    impl(int width, int height, chunk_loader loader, std::size_t budget_bytes)
+      : width_(width),
+        height_(height),
+        chunks_wide_((width + world_chunk::size - 1) >> world_chunk::bits),
+        chunks_high_((height + world_chunk::size - 1) >> world_chunk::bits),
+        loader_(std::move(loader)),
+        budget_chunks_(std::max<std::size_t>(1, budget_bytes / sizeof(world_chunk))),
+        loading_thread_([this]{ load_chunks(); })
+    {
+    }
+
+    ~impl()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+
+        work_available_.notify_all();
+        loading_thread_.join();
+    }
+
+    // ======================================================================
+    // FIND
+    // ======================================================================
+    std::shared_ptr<world_chunk const> find(int chunk_x, int chunk_y)
+    {
+        auto const key = make_key(chunk_x, chunk_y);
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto const it = resident_.find(key);
+
+        if (it != resident_.end())
+        {
+            ++stats_.hits;
+            recency_.splice(recency_.begin(), recency_, it->second.recency);
+            return it->second.chunk;
+        }
+
+        ++stats_.misses;
+        enqueue(key);
+        return nullptr;
+    }
+
+    // ======================================================================
+    // PREFETCH
+    // ======================================================================
+    void prefetch(int chunk_x, int chunk_y, int radius)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        for (auto y = std::max(0, chunk_y - radius); 
+             y <= std::min(chunks_high_ - 1, chunk_y + radius); 
+             ++y)
+        {
+            for (auto x = std::max(0, chunk_x - radius); 
+                 x <= std::min(chunks_wide_ - 1, chunk_x + radius); 
+                 ++x)
+            {
+                auto const key = make_key(x, y);
+
+                if (resident_.find(key) == resident_.end())
+                {
+                    enqueue(key);
+                }
+            }
+        }
+    }
+
+    // ======================================================================
+    // WAIT_UNTIL_IDLE
+    // ======================================================================
+    void wait_until_idle()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this]{ return pending_.empty(); });
+    }
+
+    // ======================================================================
+    // STATS
+    // ======================================================================
+    statistics stats() const
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto result = stats_;
+        result.resident = resident_.size();
+        return result;
+    }
+
+    int width_;
+    int height_;
+    int chunks_wide_;
+    int chunks_high_;
+
+private :
+    // ======================================================================
+    // ENQUEUE
+    // ======================================================================
+    // Must be called with the mutex held.
+    // ======================================================================
+    void enqueue(chunk_key key)
+    {
+        if (key_x(key) < 0 || key_y(key) < 0 
+         || key_x(key) >= chunks_wide_ || key_y(key) >= chunks_high_)
+        {
+            return;
+        }
+
+        if (pending_.insert(key).second)
+        {
+            queue_.push_back(key);
+            work_available_.notify_one();
+        }
+    }
+
+    // ======================================================================
+    // LOAD_CHUNKS
+    // ======================================================================
+    void load_chunks()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        for (;;)
+        {
+            work_available_.wait(
+                lock, [this]{ return stopping_ || !queue_.empty(); });
+
+            if (stopping_)
+            {
+                return;
+            }
+
+            auto const key = queue_.front();
+            queue_.pop_front();
+
+            lock.unlock();
+            auto chunk = std::make_shared<world_chunk>();
+            chunk->tiles.fill(0);
+            loader_(key_x(key), key_y(key), *chunk);
+            lock.lock();
+
+            insert(key, std::move(chunk));
+            pending_.erase(key);
+
+            if (pending_.empty())
+            {
+                idle_.notify_all();
+            }
+        }
+    }
+
+    // ======================================================================
+    // INSERT
+    // ======================================================================
+    // Must be called with the mutex held.
+    // ======================================================================
+    void insert(chunk_key key, std::shared_ptr<world_chunk const> chunk)
+    {
+        ++stats_.loads;
+        recency_.push_front(key);
+        resident_[key] = entry{std::move(chunk), recency_.begin()};
+
+        while (resident_.size() > budget_chunks_)
+        {
+            resident_.erase(recency_.back());
+            recency_.pop_back();
+            ++stats_.evictions;
+        }
+    }
+
+    chunk_loader loader_;
+    std::size_t budget_chunks_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_available_;
+    std::condition_variable idle_;
+    bool stopping_ = false;
+
+    std::unordered_map<chunk_key, entry> resident_;
+    std::list<chunk_key> recency_;
+    std::deque<chunk_key> queue_;
+    std::unordered_set<chunk_key> pending_;
+    statistics stats_{};
+
+    // Declared last so that everything it uses is constructed first.
+    std::thread loading_thread_;
+};
+
+// ==========================================================================
+// CONSTRUCTOR
+// ==========================================================================
+chunk_cache::chunk_cache(
+    int width, 
+    int height, 
+    chunk_loader loader, 
+    std::size_t budget_bytes)
+  : pimpl_(boost::make_unique<impl>(
+        width, height, std::move(loader), budget_bytes))
+{
+}
+
+// ==========================================================================
+// DESTRUCTOR
+// ==========================================================================
+chunk_cache::~chunk_cache()
+{
+}
+
+// ==========================================================================
+// WIDTH
+// ==========================================================================
+int chunk_cache::width() const
+{
+    return pimpl_->width_;
+}
+
+// ==========================================================================
+// HEIGHT
+// ==========================================================================
+int chunk_cache::height() const
+{
+    return pimpl_->height_;
+}
+
+// ==========================================================================
+// FIND
+// ==========================================================================
+std::shared_ptr<world_chunk const> chunk_cache::find(int chunk_x, int chunk_y)
+{
+    return pimpl_->find(chunk_x, chunk_y);
+}
+
+// ==========================================================================
+// PREFETCH
+// ==========================================================================
+void chunk_cache::prefetch(int chunk_x, int chunk_y, int radius)
+{
+    pimpl_->prefetch(chunk_x, chunk_y, radius);
+}
+
+// ==========================================================================
+// WAIT_UNTIL_IDLE
+// ==========================================================================
+void chunk_cache::wait_until_idle()
+{
+    pimpl_->wait_until_idle();
+}
+
+// ==========================================================================
+// STATS
+// ==========================================================================
+chunk_cache::statistics chunk_cache::stats() const
+{
+    return pimpl_->stats();
+}
+
+// ==========================================================================
+// CHUNK_VIEW::CONSTRUCTOR
+// ==========================================================================
+chunk_view::chunk_view(chunk_cache &cache)
+  : cache_(cache),
+    width_(cache.width()),
+    height_(cache.height())
+{
+}
+
+// ==========================================================================
+// MAP_FILE_CHUNK_LOADER
+// ==========================================================================
+chunk_cache::chunk_loader map_file_chunk_loader(
+    std::shared_ptr<map_file const> file)
+{
+    return [file](int chunk_x, int chunk_y, world_chunk &chunk)
+    {
+        auto const origin_x = chunk_x * world_chunk::size;
+        auto const origin_y = chunk_y * world_chunk::size;
+        auto const last_x = std::min(origin_x + world_chunk::size, file->width());
+        auto const last_y = std::min(origin_y + world_chunk::size, file->height());
+
+        for (int y = origin_y; y < last_y; ++y)
+        {
+            for (int x = origin_x; x < last_x; ++x)
+            {
+                chunk.tiles[((y - origin_y) << world_chunk::bits) + (x - origin_x)] =
+                    file->tile_at(x, y);
+            }
+        }
+    };
+}
+
+}
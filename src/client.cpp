@@ -1,9 +1,19 @@
 #include "client.hpp"
+#include "allocation_counter.hpp"
+#include "client_usage.hpp"
 #include "connection.hpp"
 #include "camera.hpp"
-#include "floorplan.hpp"
+#include "frame_cache.hpp"
 #include "lambda_visitor.hpp"
+#include "metrics.hpp"
+#include "probes.hpp"
+#include "session_recording.hpp"
+#include "simulation.hpp"
+#include "spectator.hpp"
+#include "terminal_profile.hpp"
+#include "tracing.hpp"
 #include "vector2d.hpp"
+#include "world.hpp"
 #include "ui.hpp"
 
 #include <terminalpp/terminal.hpp>
@@ -16,23 +26,12 @@
 #include <boost/range/algorithm/find_if.hpp>
 #include <atomic>
 #include <cmath>
+#include <mutex>
 
 namespace textray {
 
 namespace {
 
-floorplan level_map = {{
- { 1, 1, 2, 2, 3, 3, 4, 4 },
- { 3, 0, 0, 0, 0, 0, 0, 4 },
- { 3, 0, 0, 0, 5, 0, 0, 4 },
- { 4, 2, 0, 0, 0, 0, 0, 5 },
- { 4, 2, 0, 0, 0, 0, 0, 5 },
- { 5, 0, 0, 0, 0, 0, 0, 6 },
- { 5, 0, 0, 1, 0, 0, 0, 6 },
- { 7, 0, 0, 0, 0, 0, 0, 7 },
- { 7, 4, 4, 2, 2, 5, 5, 9 }
-}};
-
 // ======================================================================
 // TO_RADIANS
 // ======================================================================
@@ -49,6 +48,50 @@ enum class connection_state
     dead
 };
 
+// ======================================================================
+// ADJUST_CLIENT_COUNT
+// ======================================================================
+void adjust_client_count(connection_state state, std::int64_t amount)
+{
+    switch (state)
+    {
+        case connection_state::setup:
+            adjust(metric_gauge::clients_setup, amount);
+            break;
+
+        case connection_state::main:
+            adjust(metric_gauge::clients_main, amount);
+            break;
+
+        case connection_state::dead:
+            adjust(metric_gauge::clients_dead, amount);
+            break;
+
+        default:
+            break;
+    }
+}
+
+// ======================================================================
+// ENCODER_ORIGIN
+// ======================================================================
+// The state, as the frame cache addresses it, of a client's terminal and
+// canvas when they are created or replaced with the given size.  The two
+// differ because a replaced terminal's window has been told to draw the
+// whole screen again, and a new one's has not.
+// ======================================================================
+std::uint64_t encoder_origin(
+    terminal_profile const &profile, terminalpp::extent size, bool replaced)
+{
+    // Every terminal of a type shares its profile, so the profile is
+    // identified by its address.
+    auto state = hash_combine(
+        std::uint64_t(reinterpret_cast<std::uintptr_t>(&profile)),
+        std::uint64_t(replaced));
+    state = hash_combine(state, std::uint64_t(size.width_));
+    return hash_combine(state, std::uint64_t(size.height_));
+}
+
 // ======================================================================
 // STATE STRUCTURE
 // ======================================================================
@@ -103,26 +146,90 @@ public:
     main_state(
         connection &cnx, 
         boost::asio::io_context &io_context, 
-        std::function<void ()> const &shutdown)
+        std::function<void ()> const &shutdown,
+        client_usage &usage,
+        std::shared_ptr<world> shared_world,
+        std::shared_ptr<simulation> shared_simulation,
+        std::shared_ptr<spectator_directory> spectators,
+        std::shared_ptr<frame_cache> frames,
+        terminal_profile const &profile)
       : connection_(cnx),
         io_context_(io_context),
         strand_(io_context),
+        lifetime_(std::make_shared<lifetime>()),
         shutdown_(shutdown),
-        terminal_(main_state::create_behaviour()),
+        terminal_(terminal_behaviour(profile)),
         canvas_({80, 24}),
-        floorplan_(std::make_shared<floorplan>(level_map)),
-        position_({3, 2}),
+        world_(std::move(shared_world)),
+        position_(world_->spawn_point()),
         heading_(to_radians(210)),
         fov_(90),
-        ui_(std::make_shared<ui>(floorplan_, position_, heading_, to_radians(fov_))),
+        simulation_(std::move(shared_simulation)),
+        player_updated_(false),
+        player_trace_(0),
+        player_(boost::make_unique<player>(
+            *simulation_,
+            player_state{position_, heading_},
+            std::uint8_t(1 + usage.id() % 9),
+            [this]
+            {
+                // Called from the simulation's thread after each tick that
+                // moved the player.
+                if (!player_updated_.exchange(true))
+                {
+                    post([this]{on_player_updated();});
+                }
+            })),
+        ui_(std::make_shared<ui>(
+            world_, player_->entity(), position_, heading_, to_radians(fov_))),
         window_(ui_),
-        repaint_requested_(false)
+        spectators_(std::move(spectators)),
+        feed_(spectators_->open(
+            io_context,
+            world_,
+            player_->entity(),
+            position_,
+            heading_,
+            to_radians(fov_))),
+        watched_(no_entity),
+        watch_generation_(0),
+        profile_(profile),
+        save_bandwidth_(false),
+        frames_(std::move(frames)),
+        encoder_state_(encoder_origin(profile, canvas_.size(), false)),
+        encoder_behind_(false),
+        input_posted_(false),
+        repaint_requested_(false),
+        repaint_trace_(0),
+        view_changed_(false),
+        usage_(usage),
+        subscription_(
+            *world_,
+            player_->entity(),
+            [this]
+            {
+                // Called from whichever thread changed the world.  Changes
+                // arriving before the redraw has run are folded into it.
+                if (!view_changed_.exchange(true))
+                {
+                    post([this]{on_view_changed();});
+                }
+            })
     {
+        ui_->set_camera_palette(palette_for(profile_.colours, save_bandwidth_));
+
         window_.on_repaint_request.connect(
             [this]
             {
+                // Carry any trace of the input that caused this repaint
+                // over to the strand that performs it.
+                if (auto const trace = current_trace())
+                {
+                    repaint_trace_ = trace;
+                }
+
                 repaint_requested_ = true;
-                strand_.post([this]{on_repaint();});
+                post([this]{on_repaint();});
             });
         window_.on_repaint_request();
     }
@@ -142,14 +249,42 @@ public:
             });
     }
 
+    // ======================================================================
+    // DESTRUCTOR
+    // ======================================================================
+    // Handlers already posted to the strand may run after this, so they are
+    // told not to touch the state.  If one is running, this waits for it.
+    // ======================================================================
+    ~main_state() override
+    {
+        std::unique_lock<std::mutex> lock(lifetime_->mutex);
+        lifetime_->alive = false;
+    }
+
+    // ======================================================================
+    // HANDLE_DATA
+    // ======================================================================
+    // Called on the connection's thread.  The terminal, the window and
+    // everything else that input touches belong to the strand, so the data
+    // is queued for it.  Data arriving before the strand has taken what was
+    // queued is added to it.
+    // ======================================================================
     connection_state handle_data(serverpp::bytes data) override
     {
-        terminal_.read(
-            [this](terminalpp::tokens tokens)
-            {
-                handle_tokens(tokens);
-            })
-            >> data;
+        scoped_allocation_counter allocations(allocation_site::handle_data);
+        bool posted;
+
+        {
+            std::unique_lock<std::mutex> lock(input_mutex_);
+            input_.insert(input_.end(), data.begin(), data.end());
+            posted = input_posted_;
+            input_posted_ = true;
+        }
+
+        if (!posted)
+        {
+            post([this]{on_input();});
+        }
 
         return connection_state::main;
     }
@@ -161,27 +296,140 @@ public:
 
     connection_state window_size_changed(
         std::uint16_t width, std::uint16_t height) override
+    {
+        post(
+            [this, width, height]
+            {
+                on_window_size_changed(width, height);
+            });
+
+        return connection_state::main;
+    }
+
+private:
+    // ======================================================================
+    // LIFETIME STRUCTURE
+    // ======================================================================
+    // Shared with every handler posted to the strand, so that handlers that
+    // run after the state has been destroyed can tell.
+    // ======================================================================
+    struct lifetime
+    {
+        std::mutex mutex;
+        bool alive = true;
+    };
+
+    // ======================================================================
+    // POST
+    // ======================================================================
+    // Posts a handler to the strand that is only called if the state still
+    // exists when it runs.
+    // ======================================================================
+    template <class Handler>
+    void post(Handler &&handler)
+    {
+        strand_.post(
+            [token = lifetime_, handler = std::forward<Handler>(handler)]
+            {
+                std::unique_lock<std::mutex> lock(token->mutex);
+
+                if (token->alive)
+                {
+                    handler();
+                }
+            });
+    }
+
+    // ======================================================================
+    // ON_INPUT
+    // ======================================================================
+    // Reads the queued input.  The buffers are swapped rather than moved so
+    // that both keep their capacity.
+    // ======================================================================
+    void on_input()
+    {
+        scoped_allocation_counter allocations(allocation_site::handle_data);
+
+        {
+            std::unique_lock<std::mutex> lock(input_mutex_);
+            input_.swap(reading_);
+            input_posted_ = false;
+        }
+
+        terminal_.read(
+            [this](terminalpp::tokens tokens)
+            {
+                handle_tokens(tokens);
+            })
+            >> serverpp::bytes(reading_.data(), reading_.size());
+
+        reading_.clear();
+
+        // Without a simulation thread, the input is applied straight away.
+        if (!simulation_->running())
+        {
+            simulation_->step();
+        }
+    }
+
+    // ======================================================================
+    // ON_WINDOW_SIZE_CHANGED
+    // ======================================================================
+    void on_window_size_changed(std::uint16_t width, std::uint16_t height)
     {
         if (canvas_.size() != terminalpp::extent{width, height})
         {
             canvas_ = terminalpp::canvas({width, height});
             terminal_.set_size({width, height});
+            encoder_state_ = hash_combine(
+                hash_combine(encoder_state_, std::uint64_t(width)),
+                std::uint64_t(height));
+
+            if (watching_)
+            {
+                watching_->resize({width, height});
+            }
         }
-            
+
+        // The canvas and the camera's image each hold an element per cell.
+        usage_.set(
+            usage_metric::memory_bytes,
+            2 * std::uint64_t(width) * height * sizeof(terminalpp::element));
+
         window_.on_repaint_request();
+    }
 
-        return connection_state::main;
+    // ======================================================================
+    // SUBMIT
+    // ======================================================================
+    // Queues a command for the simulation, carrying any trace of the input
+    // over to the camera update that follows.
+    // ======================================================================
+    void submit(player_command command)
+    {
+        if (auto const trace = current_trace())
+        {
+            player_trace_ = trace;
+        }
+
+        player_->submit(command);
     }
 
-private:
     // ======================================================================
-    // MOVE_DIRECTION
+    // ON_PLAYER_UPDATED
+    // ======================================================================
+    // Moves the camera to where the simulation has put the player.
     // ======================================================================
-    void move_direction(double angle)
+    void on_player_updated()
     {
-        constexpr auto VELOCITY = 0.25;
-        position_ += vector2d::from_angle(angle) * VELOCITY;
+        trace_scope scope(player_trace_.exchange(0));
+        player_updated_ = false;
+
+        auto const state = player_->state();
+        position_ = state->position;
+        heading_ = state->heading;
         ui_->move_camera_to(position_, heading_);
+        feed_->move_to(position_, heading_);
     }
 
     // ======================================================================
@@ -189,7 +437,7 @@ private:
     // ======================================================================
     void move_forward()
     {
-        move_direction(heading_);
+        submit(player_command::move_forward);
     }
 
     // ======================================================================
@@ -197,7 +445,7 @@ private:
     // ======================================================================
     void move_backward()
     {
-        move_direction(heading_ + M_PI);
+        submit(player_command::move_backward);
     }
 
     // ======================================================================
@@ -205,7 +453,7 @@ private:
     // ======================================================================
     void move_left()
     {
-        move_direction(heading_ + M_PI/2);
+        submit(player_command::move_left);
     }
 
     // ======================================================================
@@ -213,7 +461,7 @@ private:
     // ======================================================================
     void move_right()
     {
-        move_direction(heading_ - M_PI/2);
+        submit(player_command::move_right);
     }
 
     // ======================================================================
@@ -221,8 +469,7 @@ private:
     // ======================================================================
     void rotate_left()
     {
-        heading_ += to_radians(15);
-        ui_->move_camera_to(position_, heading_);
+        submit(player_command::rotate_left);
     }
     
     // ======================================================================
@@ -230,8 +477,7 @@ private:
     // ======================================================================
     void rotate_right()
     {
-        heading_ -= to_radians(15);
-        ui_->move_camera_to(position_, heading_);
+        submit(player_command::rotate_right);
     }
 
     // ======================================================================
@@ -241,6 +487,7 @@ private:
     {
         fov_ = std::max(5.0, fov_ - 5.0);
         ui_->set_camera_fov(to_radians(fov_));
+        feed_->set_fov(to_radians(fov_));
     }
 
     // ======================================================================
@@ -250,15 +497,131 @@ private:
     {
         fov_ = std::min(175.0, fov_ + 5.0);
         ui_->set_camera_fov(to_radians(fov_));
+        feed_->set_fov(to_radians(fov_));
     }
 
     // ======================================================================
-    // ZOOM_OUT
+    // RESET_ZOOM
     // ======================================================================
     void reset_zoom()
     {
         fov_ = 90;
         ui_->set_camera_fov(to_radians(fov_));
+        feed_->set_fov(to_radians(fov_));
+    }
+
+    // ======================================================================
+    // WATCH_NEXT
+    // ======================================================================
+    // Watches the next player after the one being watched, if any, or
+    // returns to the client's own view after the last.
+    // ======================================================================
+    void watch_next()
+    {
+        watching_.reset();
+
+        // Frames from the feed that was being watched may still be queued
+        // on the strand; they are discarded.
+        auto const generation = ++watch_generation_;
+        auto const feed = spectators_->next(player_->entity(), watched_);
+
+        if (feed)
+        {
+            watched_ = feed->subject();
+            watching_ = boost::make_unique<spectator>(
+                *feed,
+                canvas_.size(),
+                profile_,
+                palette_for(profile_.colours, save_bandwidth_),
+                [this, generation](spectator_frame const &frame)
+                {
+                    post(
+                        [this, generation, frame]
+                        {
+                            on_spectator_frame(generation, frame);
+                        });
+                },
+                [this, generation]
+                {
+                    post(
+                        [this, generation]
+                        {
+                            on_spectator_closed(generation);
+                        });
+                });
+        }
+        else
+        {
+            // The screen shows the last player watched, so the client's
+            // own view is drawn again in full.
+            watched_ = no_entity;
+            reset_encoder();
+        }
+    }
+
+    // ======================================================================
+    // RESET_ENCODER
+    // ======================================================================
+    // Replaces the terminal and canvas with ones that know nothing of what
+    // the screen shows, and draws the whole screen again.
+    // ======================================================================
+    void reset_encoder()
+    {
+        terminal_ = terminalpp::terminal(terminal_behaviour(profile_));
+        terminal_.set_size(canvas_.size());
+        canvas_ = terminalpp::canvas(canvas_.size());
+        encoder_state_ = encoder_origin(profile_, canvas_.size(), true);
+        encoder_behind_ = false;
+        ui_->redraw();
+    }
+
+    // ======================================================================
+    // TOGGLE_BANDWIDTH_SAVING
+    // ======================================================================
+    // Switches between the palette that the terminal can show and the one
+    // that is cheapest to send.
+    // ======================================================================
+    void toggle_bandwidth_saving()
+    {
+        save_bandwidth_ = !save_bandwidth_;
+
+        auto const colours = palette_for(profile_.colours, save_bandwidth_);
+        ui_->set_camera_palette(colours);
+
+        if (watching_)
+        {
+            watching_->set_palette(colours);
+        }
+    }
+
+    // ======================================================================
+    // ON_SPECTATOR_FRAME
+    // ======================================================================
+    void on_spectator_frame(
+        std::uint64_t generation, spectator_frame const &frame)
+    {
+        if (generation == watch_generation_)
+        {
+            client_usage_scope usage_scope(usage_);
+            usage_.add(usage_metric::frames_rendered, 1);
+
+            // The feed has already bracketed the frame for this client's
+            // profile, so the shared bytes are written as they are.
+            connection_.write(*frame);
+        }
+    }
+
+    // ======================================================================
+    // ON_SPECTATOR_CLOSED
+    // ======================================================================
+    // The player being watched has left, so the next is watched instead.
+    // ======================================================================
+    void on_spectator_closed(std::uint64_t generation)
+    {
+        if (generation == watch_generation_)
+        {
+            watch_next();
+        }
     }
 
     // ======================================================================
@@ -282,6 +645,9 @@ private:
     // ======================================================================
     bool keypress_event(terminalpp::virtual_key const &vk)
     {
+        trace_span span(trace_stage::keypress);
+        usage_.add(usage_metric::input_events, 1);
+
         static struct {
             terminalpp::vk key;
             void (main_state::*handle)();
@@ -296,6 +662,8 @@ private:
             { terminalpp::vk::lowercase_z, &main_state::zoom_in       },
             { terminalpp::vk::lowercase_x, &main_state::zoom_out      },
             { terminalpp::vk::lowercase_c, &main_state::reset_zoom    },
+            { terminalpp::vk::lowercase_v, &main_state::watch_next    },
+            { terminalpp::vk::lowercase_b, &main_state::toggle_bandwidth_saving },
             { terminalpp::vk::uppercase_q, &main_state::quit          },
             { terminalpp::vk::uppercase_p, &main_state::shutdown      },
         };
@@ -318,30 +686,25 @@ private:
         }
     }
 
-    void event(boost::any const &ev)
+    // ======================================================================
+    // EVENT
+    // ======================================================================
+    // Keys are offered to the key handlers before the window, so that those
+    // the handlers consume are never wrapped in a boost::any, which would
+    // allocate.
+    // ======================================================================
+    void event(terminalpp::virtual_key const &vk)
     {
-        // General key handler for movement
-        bool consumed = false;
-        auto *vk = boost::any_cast<terminalpp::virtual_key>(&ev);
-        
-        if (vk != nullptr)
-        {
-            consumed = keypress_event(*vk);
-        }
-
-        if (!consumed)
+        if (!keypress_event(vk))
         {
-            window_.event(ev);
+            window_.event(vk);
         }
     }
 
-    static terminalpp::behaviour create_behaviour()
+    template <class Event>
+    void event(Event const &ev)
     {
-        terminalpp::behaviour behaviour;
-        behaviour.supports_basic_mouse_tracking = true;
-        behaviour.supports_window_title_bel = true;
-        
-        return behaviour;
+        window_.event(ev);
     }
 
     static serverpp::bytes string_to_bytes(std::string const &str)
@@ -360,35 +723,213 @@ private:
 
     void on_repaint()
     {
+        auto const trace = repaint_trace_.exchange(0);
+        trace_scope scope(trace);
+        trace_span span(trace, trace_stage::repaint);
+        client_usage_scope usage_scope(usage_);
+
+        // While watching another player, the screen shows their view.
+        if (watching_)
+        {
+            return;
+        }
+
         bool b = true;
-        if (repaint_requested_.compare_exchange_strong(b, false))
+        if (!repaint_requested_.compare_exchange_strong(b, false))
         {
-            window_.repaint(
-                canvas_, 
-                terminal_,
-                [this](terminalpp::bytes data)
+            usage_.add(usage_metric::frames_skipped, 1);
+            return;
+        }
+
+        auto const frame = ui_->prepare_frame();
+
+        if (frames_->find(
+                encoder_state_, frame, cached_frame_, cached_visibility_))
+        {
+            // This frame has already been encoded for a terminal in the
+            // same state, so those bytes are sent as they are.
+            count(metric_counter::repaints);
+            usage_.add(usage_metric::frames_rendered, 1);
+
+            send_frame(
+                [this](auto &&append)
                 {
-                    connection_.write(data);
+                    append(serverpp::bytes(
+                        cached_frame_.data(), cached_frame_.size()));
                 });
+
+            encoder_state_ = hash_combine(encoder_state_, frame);
+            encoder_behind_ = true;
+            subscription_.publish(cached_visibility_);
+        }
+        else if (encoder_behind_)
+        {
+            // The terminal and canvas know nothing of the frames that were
+            // sent from the cache, so they cannot encode what follows them.
+            // They are replaced, and the repaint that that requests draws
+            // the whole screen.
+            reset_encoder();
+        }
+        else
+        {
+            count(metric_counter::repaints);
+            usage_.add(usage_metric::frames_rendered, 1);
+            scoped_metric_timer timer(metric_histogram::repaint_duration);
+            trace_span encode_span(trace, trace_stage::encode);
+            TEXTRAY_PROBE1(repaint__start, this);
+
+            cached_frame_.clear();
+            send_frame(
+                [this](auto &&append)
+                {
+                    window_.repaint(
+                        canvas_,
+                        terminal_,
+                        [this, &append](terminalpp::bytes data)
+                        {
+                            usage_.add(usage_metric::bytes_encoded, data.size());
+                            cached_frame_.insert(
+                                cached_frame_.end(), data.begin(), data.end());
+                            append(data);
+                        });
+                });
+
+            TEXTRAY_PROBE1(repaint__end, this);
+
+            // A repaint that wrote nothing left the terminal as it was.
+            if (!cached_frame_.empty())
+            {
+                frames_->store(
+                    encoder_state_,
+                    frame,
+                    cached_frame_,
+                    ui_->camera_visibility());
+                encoder_state_ = hash_combine(encoder_state_, frame);
+            }
+
+            // Changes to the world are now only of interest where this
+            // frame could show them.
+            subscription_.publish(ui_->camera_visibility());
+        }
+    }
+
+    // ======================================================================
+    // SEND_FRAME
+    // ======================================================================
+    // Collects everything that encode appends into a single write, so that
+    // each write to the connection is exactly one displayed frame.  For
+    // terminals that support it, the frame is bracketed so that it is shown
+    // all at once.  Nothing is written if encode appends nothing.
+    // ======================================================================
+    template <class Encode>
+    void send_frame(Encode &&encode)
+    {
+        auto const append =
+            [this](serverpp::bytes data)
+            {
+                frame_.insert(frame_.end(), data.begin(), data.end());
+            };
+
+        frame_.clear();
+
+        if (profile_.synchronized_output)
+        {
+            append(serverpp::bytes(
+                begin_synchronized_update,
+                sizeof(begin_synchronized_update)));
+        }
+
+        auto const header_size = frame_.size();
+        encode(append);
+
+        if (frame_.size() == header_size)
+        {
+            return;
+        }
+
+        if (profile_.synchronized_output)
+        {
+            append(serverpp::bytes(
+                end_synchronized_update,
+                sizeof(end_synchronized_update)));
         }
+
+        connection_.write(frame_);
+    }
+
+    // ======================================================================
+    // ON_VIEW_CHANGED
+    // ======================================================================
+    void on_view_changed()
+    {
+        view_changed_ = false;
+        ui_->redraw_camera();
+        feed_->redraw();
     }
 
     connection &connection_;
     boost::asio::io_context &io_context_;
+
+    // Everything below that is not atomic or guarded by a mutex is used
+    // only on the strand.
     boost::asio::io_context::strand strand_;
+    std::shared_ptr<lifetime> lifetime_;
     std::function<void ()> shutdown_;
     terminalpp::terminal terminal_;
     terminalpp::canvas canvas_;
     
-    std::shared_ptr<floorplan> floorplan_;
+    std::shared_ptr<world> world_;
     vector2d position_;
     double heading_;
     double fov_;
 
+    std::shared_ptr<simulation> simulation_;
+    std::atomic<bool> player_updated_;
+    std::atomic<trace_id> player_trace_;
+    std::unique_ptr<player> player_;
+
     std::shared_ptr<ui> ui_;
     munin::window window_;
 
+    std::shared_ptr<spectator_directory> spectators_;
+    std::shared_ptr<spectator_feed> feed_;
+    entity_id watched_;
+    std::uint64_t watch_generation_;
+    std::unique_ptr<spectator> watching_;
+
+    terminal_profile const &profile_;
+    bool save_bandwidth_;
+
+    // Reused for every frame, so that it does not allocate once it has
+    // grown to the size of a full repaint.
+    serverpp::byte_storage frame_;
+
+    // The cache of frames shared with other clients, and the state of the
+    // terminal and canvas as it addresses them.  While the client is
+    // behind, it has been sent frames from the cache that its terminal and
+    // canvas did not encode.  Frames found in the cache are copied into
+    // buffers that are reused for every frame.
+    std::shared_ptr<frame_cache> frames_;
+    std::uint64_t encoder_state_;
+    bool encoder_behind_;
+    serverpp::byte_storage cached_frame_;
+    visibility_set cached_visibility_;
+
+    // Input queued by the connection's thread for the strand, and the
+    // input that the strand is reading.
+    std::mutex input_mutex_;
+    serverpp::byte_storage input_;
+    bool input_posted_;
+    serverpp::byte_storage reading_;
+
     std::atomic<bool> repaint_requested_;
+    std::atomic<trace_id> repaint_trace_;
+    std::atomic<bool> view_changed_;
+    client_usage &usage_;
+
+    // Declared last so that it is withdrawn before anything that its
+    // handler uses is destroyed.
+    view_subscription subscription_;
 };
 
 // ======================================================================
@@ -428,21 +969,51 @@ public :
         connection &&cnx, 
         boost::asio::io_context &io_context,
         std::function<void ()> const &connection_died,
-        std::function<void ()> const &shutdown)
+        std::function<void ()> const &shutdown,
+        std::shared_ptr<session_recorder> recorder,
+        std::shared_ptr<world> shared_world,
+        std::shared_ptr<simulation> shared_simulation,
+        std::shared_ptr<spectator_directory> spectators,
+        std::shared_ptr<frame_cache> frames)
       : connection_(std::move(cnx)),
         io_context_(io_context),
         connection_died_(connection_died),
-        shutdown_(shutdown)
+        shutdown_(shutdown),
+        recorder_(std::move(recorder)),
+        world_(std::move(shared_world)),
+        simulation_(
+            shared_simulation
+              ? std::move(shared_simulation)
+              : std::make_shared<simulation>(world_)),
+        spectators_(
+            spectators
+              ? std::move(spectators)
+              : std::make_shared<spectator_directory>()),
+        frames_(
+            frames
+              ? std::move(frames)
+              : std::make_shared<frame_cache>())
     {
         connection_.async_get_terminal_type(
             [&](std::string const &type)
             {
+                if (recorder_)
+                {
+                    recorder_->terminal_type(type);
+                }
+
+                profile_ = &terminal_profile_for(type);
                 enter_state(state_->terminal_type(type));
             });
 
         connection_.on_window_size_changed(
             [&](std::uint16_t width, std::uint16_t height)
             {
+                if (recorder_)
+                {
+                    recorder_->window_size(width, height);
+                }
+
                 window_width_ = width;
                 window_height_ = height;
                 enter_state(state_->window_size_changed(width, height));
@@ -452,6 +1023,14 @@ public :
         schedule_next_read();
     }
 
+    // ======================================================================
+    // DESTRUCTOR
+    // ======================================================================
+    ~impl()
+    {
+        adjust_client_count(connection_state_, -1);
+    }
+
     // ======================================================================
     // CLOSE
     // ======================================================================
@@ -485,7 +1064,15 @@ private :
     void enter_main_state()
     {
         state_ = boost::make_unique<main_state>(
-            std::ref(connection_), io_context_, shutdown_);
+            std::ref(connection_), 
+            io_context_, 
+            shutdown_, 
+            std::ref(usage_),
+            world_,
+            simulation_,
+            spectators_,
+            frames_,
+            *profile_);
 
         serverpp::byte_storage discarded_data;
         discarded_data_.swap(discarded_data);
@@ -513,6 +1100,15 @@ private :
 
         if (new_state != old_state)
         {
+            TEXTRAY_PROBE3(
+                state__change,
+                this,
+                static_cast<int>(old_state),
+                static_cast<int>(new_state));
+
+            adjust_client_count(old_state, -1);
+            adjust_client_count(new_state, 1);
+
             switch (new_state)
             {
                 case connection_state::setup:
@@ -538,6 +1134,13 @@ private :
         connection_.async_read(
             [this](serverpp::bytes data)
             {
+                client_usage_scope usage_scope(usage_);
+
+                if (recorder_)
+                {
+                    recorder_->data(data);
+                }
+
                 enter_state(state_->handle_data(data));
             },
             [this]()
@@ -558,10 +1161,17 @@ private :
 
     std::function<void ()> connection_died_;
     std::function<void ()> shutdown_;
+    std::shared_ptr<session_recorder> recorder_;
+    std::shared_ptr<world> world_;
+    std::shared_ptr<simulation> simulation_;
+    std::shared_ptr<spectator_directory> spectators_;
+    std::shared_ptr<frame_cache> frames_;
+    client_usage usage_;
 
     connection_state connection_state_{connection_state::init};
     std::unique_ptr<state> state_;
 
+    terminal_profile const *profile_{&terminal_profile_for({})};
     std::uint16_t window_width_{80};
     std::uint16_t window_height_{24};
 
@@ -575,7 +1185,12 @@ client::client(
     connection &&cnx,
     boost::asio::io_context &io_context,
     std::function<void (client const &)> const &connection_died,
-    std::function<void ()> const &shutdown)
+    std::function<void ()> const &shutdown,
+    std::shared_ptr<session_recorder> recorder,
+    std::shared_ptr<world> shared_world,
+    std::shared_ptr<simulation> shared_simulation,
+    std::shared_ptr<spectator_directory> spectators,
+    std::shared_ptr<frame_cache> frames)
   : pimpl_(boost::make_unique<impl>(
         std::move(cnx), 
         io_context,
@@ -583,7 +1198,12 @@ client::client(
         {
             connection_died(*this);
         },
-        shutdown))
+        shutdown,
+        std::move(recorder),
+        std::move(shared_world),
+        std::move(shared_simulation),
+        std::move(spectators),
+        std::move(frames)))
 {
 }
 
@@ -0,0 +1,236 @@
+#include "client_usage.hpp"
+#include <boost/format.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+#include <time.h>
+
+namespace textray {
+
+namespace {
+
+char const *const metric_names[] = {
+    "render_cpu_ns",
+    "cells_rendered",
+    "bytes_encoded",
+    "bytes_uncompressed",
+    "bytes_sent",
+    "frames_rendered",
+    "frames_skipped",
+    "input_events",
+    "memory_bytes",
+};
+
+static_assert(
+    sizeof(metric_names) / sizeof(metric_names[0]) 
+        == std::size_t(usage_metric::count_),
+    "every usage metric must be named");
+
+std::mutex registry_mutex;
+std::vector<client_usage *> registry;
+std::uint64_t next_id = 1;
+
+thread_local client_usage *current_usage = nullptr;
+
+// ==========================================================================
+// THREAD_CPU_NS
+// ==========================================================================
+std::uint64_t thread_cpu_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::uint64_t(ts.tv_sec) * 1000000000u + std::uint64_t(ts.tv_nsec);
+}
+
+// ==========================================================================
+// QUERY_VALUE
+// ==========================================================================
+// Returns the value of the named parameter in a query string, or the
+// empty string if it is absent.
+// ==========================================================================
+std::string query_value(std::string const &query, std::string const &name)
+{
+    std::string::size_type begin = 0;
+
+    while (begin <= query.size())
+    {
+        auto end = query.find('&', begin);
+        if (end == std::string::npos)
+        {
+            end = query.size();
+        }
+
+        auto const parameter = query.substr(begin, end - begin);
+        auto const equals = parameter.find('=');
+
+        if (equals != std::string::npos && parameter.substr(0, equals) == name)
+        {
+            return parameter.substr(equals + 1);
+        }
+
+        begin = end + 1;
+    }
+
+    return {};
+}
+
+}
+
+// ==========================================================================
+// USAGE_METRIC_NAME
+// ==========================================================================
+char const *usage_metric_name(usage_metric metric)
+{
+    return metric_names[std::size_t(metric)];
+}
+
+// ==========================================================================
+// CLIENT_USAGE::CONSTRUCTOR
+// ==========================================================================
+client_usage::client_usage()
+{
+    for (auto &value : values_)
+    {
+        value.store(0, std::memory_order_relaxed);
+    }
+
+    std::unique_lock<std::mutex> lock(registry_mutex);
+    id_ = next_id++;
+    registry.push_back(this);
+}
+
+// ==========================================================================
+// CLIENT_USAGE::DESTRUCTOR
+// ==========================================================================
+client_usage::~client_usage()
+{
+    std::unique_lock<std::mutex> lock(registry_mutex);
+    registry.erase(std::find(registry.begin(), registry.end(), this));
+}
+
+// ==========================================================================
+// CURRENT_CLIENT_USAGE
+// ==========================================================================
+client_usage *current_client_usage()
+{
+    return current_usage;
+}
+
+// ==========================================================================
+// CLIENT_USAGE_SCOPE
+// ==========================================================================
+client_usage_scope::client_usage_scope(client_usage &usage)
+  : previous_(current_usage)
+{
+    current_usage = &usage;
+}
+
+client_usage_scope::~client_usage_scope()
+{
+    current_usage = previous_;
+}
+
+// ==========================================================================
+// SCOPED_USAGE_CPU_TIMER
+// ==========================================================================
+scoped_usage_cpu_timer::scoped_usage_cpu_timer(usage_metric metric)
+  : usage_(current_usage),
+    metric_(metric),
+    start_(usage_ ? thread_cpu_ns() : 0)
+{
+}
+
+scoped_usage_cpu_timer::~scoped_usage_cpu_timer()
+{
+    if (usage_)
+    {
+        usage_->add(metric_, thread_cpu_ns() - start_);
+    }
+}
+
+// ==========================================================================
+// CLIENT_USAGE_TEXT
+// ==========================================================================
+std::string client_usage_text(std::string const &query)
+{
+    auto sort_by = usage_metric::bytes_sent;
+    auto const sort_name = query_value(query, "sort");
+
+    for (std::size_t index = 0; index < std::size_t(usage_metric::count_); ++index)
+    {
+        if (sort_name == metric_names[index])
+        {
+            sort_by = usage_metric(index);
+        }
+    }
+
+    std::size_t limit = 10;
+    auto const limit_text = query_value(query, "n");
+
+    if (!limit_text.empty())
+    {
+        limit = std::strtoul(limit_text.c_str(), nullptr, 10);
+    }
+
+    using row = std::array<std::uint64_t, std::size_t(usage_metric::count_) + 1>;
+    std::vector<row> rows;
+
+    {
+        std::unique_lock<std::mutex> lock(registry_mutex);
+        rows.reserve(registry.size());
+
+        for (auto const *usage : registry)
+        {
+            row r;
+            r[0] = usage->id();
+
+            for (std::size_t index = 0; index < std::size_t(usage_metric::count_); ++index)
+            {
+                r[index + 1] = usage->get(usage_metric(index));
+            }
+
+            rows.push_back(r);
+        }
+    }
+
+    auto const column = std::size_t(sort_by) + 1;
+    auto const shown = std::min(limit, rows.size());
+
+    std::partial_sort(
+        rows.begin(),
+        rows.begin() + shown,
+        rows.end(),
+        [column](row const &lhs, row const &rhs)
+        {
+            return lhs[column] > rhs[column];
+        });
+
+    std::string text = (boost::format("%zu clients, sorted by %s\n")
+        % rows.size()
+        % metric_names[std::size_t(sort_by)]).str();
+
+    text += (boost::format("%8s") % "client").str();
+
+    for (auto const *name : metric_names)
+    {
+        text += (boost::format(" %18s") % name).str();
+    }
+
+    text += "\n";
+
+    for (std::size_t index = 0; index < shown; ++index)
+    {
+        for (std::size_t field = 0; field < rows[index].size(); ++field)
+        {
+            text += (boost::format(field == 0 ? "%8d" : " %18d") 
+                % rows[index][field]).str();
+        }
+
+        text += "\n";
+    }
+
+    return text;
+}
+
+}
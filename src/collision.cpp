@@ -0,0 +1,127 @@
+#include "collision.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace textray {
+
+namespace {
+
+// ==========================================================================
+// IS_SOLID
+// ==========================================================================
+template <class Plan>
+bool is_solid(Plan const &plan, int x, int y)
+{
+    return !plan.contains(x, y) || plan.tile_at(x, y) != 0;
+}
+
+// ==========================================================================
+// SWEEP
+// ==========================================================================
+// Returns how far a circle can move along one axis, up to the magnitude of
+// the distance, before it touches a solid tile.  "along" and "across" are
+// the circle's co-ordinates on the axis of motion and the other axis.
+// Tiles that the centre of the circle is already level with or past are
+// ignored, so that a circle that starts overlapping a tile can move out.
+// ==========================================================================
+template <class Plan>
+double sweep(
+    Plan const &plan,
+    double along,
+    double across,
+    double distance,
+    double radius,
+    bool along_x)
+{
+    auto const step = distance < 0 ? -1 : 1;
+    auto allowed = std::abs(distance);
+
+    auto const first_across = int(std::floor(across - radius));
+    auto const last_across = int(std::ceil(across + radius)) - 1;
+
+    for (auto tile = int(std::floor(along)) + step; ; tile += step)
+    {
+        // The distance from the centre to the near face of this column of
+        // tiles.
+        auto const face = step > 0 ? tile - along : along - (tile + 1);
+
+        if (face - radius >= allowed)
+        {
+            break;
+        }
+
+        for (auto other = first_across; other <= last_across; ++other)
+        {
+            if (!(along_x ? is_solid(plan, tile, other)
+                          : is_solid(plan, other, tile)))
+            {
+                continue;
+            }
+
+            // The circle meets the tile's face, or its nearest corner if
+            // the centre is not level with the face.
+            auto const offset = std::max({0.0, other - across, across - (other + 1)});
+
+            if (offset < radius)
+            {
+                auto const contact = face - std::sqrt(radius * radius - offset * offset);
+                allowed = std::min(allowed, std::max(contact, 0.0));
+            }
+        }
+    }
+
+    return step * allowed;
+}
+
+// ==========================================================================
+// MOVE_CIRCLE_ON
+// ==========================================================================
+template <class Plan>
+vector2d move_circle_on(
+    Plan const &plan,
+    vector2d position,
+    vector2d motion,
+    double radius)
+{
+    if (motion.x != 0)
+    {
+        position.x += sweep(
+            plan, position.x, position.y, motion.x, radius, true);
+    }
+
+    if (motion.y != 0)
+    {
+        position.y += sweep(
+            plan, position.y, position.x, motion.y, radius, false);
+    }
+
+    return position;
+}
+
+}
+
+// ==========================================================================
+// MOVE_CIRCLE
+// ==========================================================================
+vector2d move_circle(
+    floorplan const &plan,
+    vector2d position,
+    vector2d motion,
+    double radius)
+{
+    return move_circle_on(plan, position, motion, radius);
+}
+
+// ==========================================================================
+// MOVE_CIRCLE (WORLD SNAPSHOT)
+// ==========================================================================
+vector2d move_circle(
+    world_snapshot const &plan,
+    vector2d position,
+    vector2d motion,
+    double radius)
+{
+    return move_circle_on(plan, position, motion, radius);
+}
+
+}
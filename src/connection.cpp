@@ -1,5 +1,10 @@
 #include "connection.hpp"
-#include <serverpp/tcp_socket.hpp>
+#include "allocation_counter.hpp"
+#include "client_usage.hpp"
+#include "metrics.hpp"
+#include "probes.hpp"
+#include "tracing.hpp"
+#include "tcp_transport.hpp"
 #include <boost/make_unique.hpp>
 #include <telnetpp/telnetpp.hpp>
 #include <telnetpp/options/echo/server.hpp>
@@ -20,8 +25,8 @@ struct connection::impl
     // ======================================================================
     // CONSTRUCTOR
     // ======================================================================
-    impl(serverpp::tcp_socket &&socket)
-      : socket_(std::move(socket))
+    impl(std::unique_ptr<transport> trans)
+      : transport_(std::move(trans))
     {
         telnet_naws_client_.on_window_size_changed.connect(
             [this](auto &&width, auto &&height, auto &&continuation)
@@ -79,7 +84,7 @@ struct connection::impl
     // ======================================================================
     bool is_alive() const
     {
-        return socket_.is_alive();
+        return transport_->is_alive();
     }
 
     // ======================================================================
@@ -87,7 +92,7 @@ struct connection::impl
     // ======================================================================
     void close()
     {
-        socket_.close();
+        transport_->close();
     }
 
     // ======================================================================
@@ -95,11 +100,26 @@ struct connection::impl
     // ======================================================================
     void raw_write(telnetpp::bytes data)
     {
+        count(metric_counter::bytes_uncompressed, data.size());
+        charge(usage_metric::bytes_uncompressed, data.size());
+        trace_span span(trace_stage::compress);
+
         telnet_mccp_compressor_(
             data,
-            [this](telnetpp::bytes compressed_data, bool)
+            [this, &data](telnetpp::bytes compressed_data, bool)
             {
-                this->socket_.write(compressed_data);
+                count(metric_counter::bytes_compressed, compressed_data.size());
+                charge(usage_metric::bytes_sent, compressed_data.size());
+                TEXTRAY_PROBE3(
+                    compress, this, data.size(), compressed_data.size());
+                trace_span span(trace_stage::write);
+
+                // Transport writes are synchronous, so nothing queues here;
+                // this counts the threads that are waiting for one to
+                // return.
+                adjust(metric_gauge::transport_writers, 1);
+                this->transport_->write(compressed_data);
+                adjust(metric_gauge::transport_writers, -1);
             });
     }
     
@@ -108,6 +128,8 @@ struct connection::impl
     // ======================================================================
     void write(telnetpp::element const &data)
     {
+        scoped_allocation_counter allocations(allocation_site::connection_write);
+
         telnet_session_.send(
             data, 
             [this](telnetpp::bytes data)
@@ -123,9 +145,13 @@ struct connection::impl
         std::function<void (serverpp::bytes)> const &data_continuation,
         std::function<void ()> const &read_complete_continuation)
     {
-        socket_.async_read(
+        transport_->async_read(
             [=](serverpp::bytes data)
             {
+                auto const trace = begin_trace();
+                trace_scope scope(trace);
+                trace_span span(trace, trace_stage::read);
+
                 telnet_session_.receive(
                     data, 
                     [=](telnetpp::bytes data, auto &&send)
@@ -174,7 +200,7 @@ struct connection::impl
         terminal_type_requests_.clear();
     }
 
-    serverpp::tcp_socket socket_;
+    std::unique_ptr<transport> transport_;
 
     telnetpp::session                                    telnet_session_;
     telnetpp::options::echo::server                      telnet_echo_server_;
@@ -194,7 +220,15 @@ struct connection::impl
 // CONSTRUCTOR
 // ==========================================================================
 connection::connection(serverpp::tcp_socket &&new_socket)
-    : pimpl_(boost::make_unique<impl>(std::move(new_socket)))
+    : connection(boost::make_unique<tcp_transport>(std::move(new_socket)))
+{
+}
+
+// ==========================================================================
+// CONSTRUCTOR
+// ==========================================================================
+connection::connection(std::unique_ptr<transport> trans)
+    : pimpl_(boost::make_unique<impl>(std::move(trans)))
 {
 }
 
@@ -0,0 +1,302 @@
+#include "entity_store.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace textray {
+
+constexpr int entity_store::bucket_bits;
+
+namespace {
+
+// ==========================================================================
+// CELL_HASH
+// ==========================================================================
+std::uint32_t cell_hash(std::int64_t cell_x, std::int64_t cell_y)
+{
+    return std::uint32_t(cell_x) * 73856093u ^ std::uint32_t(cell_y) * 19349663u;
+}
+
+}
+
+// ==========================================================================
+// CONSTRUCTOR
+// ==========================================================================
+entity_store::entity_store(int cell_bits)
+  : cell_bits_(cell_bits),
+    buckets_(std::size_t(1) << bucket_bits)
+{
+}
+
+// ==========================================================================
+// ADD
+// ==========================================================================
+entity_id entity_store::add(
+    vector2d position, double heading, std::uint8_t appearance)
+{
+    entity_id id;
+
+    if (free_ids_.empty())
+    {
+        id = entity_id(index_of_.size());
+        index_of_.push_back(no_entity);
+    }
+    else
+    {
+        id = free_ids_.back();
+        free_ids_.pop_back();
+    }
+
+    auto const index = std::uint32_t(ids_.size());
+    index_of_[id] = index;
+
+    xs_.push_back(position.x);
+    ys_.push_back(position.y);
+    headings_.push_back(heading);
+    appearances_.push_back(appearance);
+    ids_.push_back(id);
+    buckets_of_.push_back(0);
+    slots_of_.push_back(0);
+
+    link(index);
+    return id;
+}
+
+// ==========================================================================
+// REMOVE
+// ==========================================================================
+void entity_store::remove(entity_id id)
+{
+    auto const index = index_of_[id];
+    assert(index != no_entity);
+
+    unlink(index);
+
+    // Move the last entity into the hole to keep the arrays dense.
+    auto const last = std::uint32_t(ids_.size() - 1);
+
+    if (index != last)
+    {
+        xs_[index] = xs_[last];
+        ys_[index] = ys_[last];
+        headings_[index] = headings_[last];
+        appearances_[index] = appearances_[last];
+        ids_[index] = ids_[last];
+        buckets_of_[index] = buckets_of_[last];
+        slots_of_[index] = slots_of_[last];
+
+        index_of_[ids_[index]] = index;
+        buckets_[buckets_of_[index]][slots_of_[index]] = index;
+    }
+
+    xs_.pop_back();
+    ys_.pop_back();
+    headings_.pop_back();
+    appearances_.pop_back();
+    ids_.pop_back();
+    buckets_of_.pop_back();
+    slots_of_.pop_back();
+
+    index_of_[id] = no_entity;
+    free_ids_.push_back(id);
+}
+
+// ==========================================================================
+// MOVE
+// ==========================================================================
+void entity_store::move(entity_id id, vector2d position, double heading)
+{
+    auto const index = index_of_[id];
+    assert(index != no_entity);
+
+    xs_[index] = position.x;
+    ys_[index] = position.y;
+    headings_[index] = heading;
+
+    if (bucket_of(position) != buckets_of_[index])
+    {
+        unlink(index);
+        link(index);
+    }
+}
+
+// ==========================================================================
+// QUERY_VIEW
+// ==========================================================================
+void entity_store::query_view(
+    vector2d position,
+    double heading,
+    double fov,
+    double range,
+    std::vector<entity_id> &out) const
+{
+    // The view is a sector of a circle; the cells searched are those under
+    // its bounding box.  Each candidate is then tested against the sector.
+    auto const direction = vector2d::from_angle(heading);
+    auto const cos_half_fov = std::cos(fov / 2);
+    auto const range_squared = range * range;
+
+    // Whether a direction, given as an offset from the position, lies
+    // within the field of view.  This compares the angle to the heading
+    // without a square root or an arc cosine:
+    // dot(offset, direction) >= |offset| * cos(fov / 2).
+    auto const in_view = 
+        [&](vector2d const &offset)
+        {
+            auto const along = dot(offset, direction);
+            auto const threshold = dot(offset, offset) * cos_half_fov * cos_half_fov;
+
+            return cos_half_fov >= 0
+                ? along >= 0 && along * along >= threshold
+                : along >= 0 || along * along <= threshold;
+        };
+
+    // The bounding box contains the apex, both ends of the arc and any
+    // point at which the arc crosses an axis.
+    auto const left = position + vector2d::from_angle(heading + fov / 2) * range;
+    auto const right = position + vector2d::from_angle(heading - fov / 2) * range;
+
+    vector2d minimum{
+        std::min({position.x, left.x, right.x}),
+        std::min({position.y, left.y, right.y})};
+    vector2d maximum{
+        std::max({position.x, left.x, right.x}),
+        std::max({position.y, left.y, right.y})};
+
+    static vector2d const axes[] = { {1, 0}, {0, 1}, {-1, 0}, {0, -1} };
+
+    for (auto const &axis : axes)
+    {
+        if (in_view(axis))
+        {
+            auto const extreme = position + axis * range;
+            minimum = { std::min(minimum.x, extreme.x), std::min(minimum.y, extreme.y) };
+            maximum = { std::max(maximum.x, extreme.x), std::max(maximum.y, extreme.y) };
+        }
+    }
+
+    query_cells(
+        minimum,
+        maximum,
+        [&](double x, double y)
+        {
+            auto const offset = vector2d{x - position.x, y - position.y};
+            return dot(offset, offset) <= range_squared && in_view(offset);
+        },
+        out);
+}
+
+// ==========================================================================
+// QUERY_RECTANGLE
+// ==========================================================================
+void entity_store::query_rectangle(
+    vector2d minimum,
+    vector2d maximum,
+    std::vector<entity_id> &out) const
+{
+    query_cells(
+        minimum,
+        maximum,
+        [&](double x, double y)
+        {
+            return x >= minimum.x && y >= minimum.y 
+                && x <= maximum.x && y <= maximum.y;
+        },
+        out);
+}
+
+// ==========================================================================
+// QUERY_CELLS
+// ==========================================================================
+// Visits each bucket under the rectangle once, even if several of its
+// cells share a bucket, and applies the predicate to its entities.
+// ==========================================================================
+template <class Predicate>
+void entity_store::query_cells(
+    vector2d minimum,
+    vector2d maximum,
+    Predicate &&accept,
+    std::vector<entity_id> &out) const
+{
+    auto const first_x = std::int64_t(std::floor(minimum.x)) >> cell_bits_;
+    auto const first_y = std::int64_t(std::floor(minimum.y)) >> cell_bits_;
+    auto const last_x = std::int64_t(std::floor(maximum.x)) >> cell_bits_;
+    auto const last_y = std::int64_t(std::floor(maximum.y)) >> cell_bits_;
+
+    auto const cell_count = (last_x - first_x + 1) * (last_y - first_y + 1);
+
+    // A rectangle covering more cells than there are buckets visits every
+    // bucket; otherwise, cells that collide in a bucket would be visited
+    // twice.
+    if (cell_count >= std::int64_t(buckets_.size()))
+    {
+        for (std::uint32_t index = 0; index < ids_.size(); ++index)
+        {
+            if (accept(xs_[index], ys_[index]))
+            {
+                out.push_back(ids_[index]);
+            }
+        }
+
+        return;
+    }
+
+    auto const mask = std::uint32_t(buckets_.size() - 1);
+
+    for (auto cell_y = first_y; cell_y <= last_y; ++cell_y)
+    {
+        for (auto cell_x = first_x; cell_x <= last_x; ++cell_x)
+        {
+            for (auto const index : buckets_[cell_hash(cell_x, cell_y) & mask])
+            {
+                // Entities from other cells that share the bucket are
+                // rejected here.
+                auto const x = xs_[index];
+                auto const y = ys_[index];
+
+                if ((std::int64_t(std::floor(x)) >> cell_bits_) == cell_x
+                 && (std::int64_t(std::floor(y)) >> cell_bits_) == cell_y
+                 && accept(x, y))
+                {
+                    out.push_back(ids_[index]);
+                }
+            }
+        }
+    }
+}
+
+// ==========================================================================
+// BUCKET_OF
+// ==========================================================================
+std::uint32_t entity_store::bucket_of(vector2d position) const
+{
+    auto const cell_x = std::int64_t(std::floor(position.x)) >> cell_bits_;
+    auto const cell_y = std::int64_t(std::floor(position.y)) >> cell_bits_;
+    return cell_hash(cell_x, cell_y) & std::uint32_t(buckets_.size() - 1);
+}
+
+// ==========================================================================
+// LINK
+// ==========================================================================
+void entity_store::link(std::uint32_t index)
+{
+    auto const bucket = bucket_of({xs_[index], ys_[index]});
+    buckets_of_[index] = bucket;
+    slots_of_[index] = std::uint32_t(buckets_[bucket].size());
+    buckets_[bucket].push_back(index);
+}
+
+// ==========================================================================
+// UNLINK
+// ==========================================================================
+void entity_store::unlink(std::uint32_t index)
+{
+    auto &bucket = buckets_[buckets_of_[index]];
+    auto const slot = slots_of_[index];
+
+    bucket[slot] = bucket.back();
+    slots_of_[bucket[slot]] = slot;
+    bucket.pop_back();
+}
+
+}
@@ -0,0 +1,73 @@
+#include "frame_cache.hpp"
+#include "metrics.hpp"
+#include <cassert>
+
+namespace textray {
+
+// ==========================================================================
+// CONSTRUCTOR
+// ==========================================================================
+frame_cache::frame_cache(std::size_t slots)
+  : slots_(slots)
+{
+    assert(slots != 0);
+}
+
+// ==========================================================================
+// FIND
+// ==========================================================================
+bool frame_cache::find(
+    std::uint64_t encoder_state,
+    std::uint64_t frame,
+    serverpp::byte_storage &bytes,
+    visibility_set &visible)
+{
+    auto &candidate = slot_for(encoder_state, frame);
+    std::unique_lock<std::mutex> lock(candidate.mutex);
+
+    if (!candidate.used
+     || candidate.encoder_state != encoder_state
+     || candidate.frame != frame)
+    {
+        lock.unlock();
+        count(metric_counter::frame_cache_misses);
+        return false;
+    }
+
+    bytes.assign(candidate.bytes.begin(), candidate.bytes.end());
+    visible = candidate.visible;
+    lock.unlock();
+
+    count(metric_counter::frame_cache_hits);
+    return true;
+}
+
+// ==========================================================================
+// STORE
+// ==========================================================================
+void frame_cache::store(
+    std::uint64_t encoder_state,
+    std::uint64_t frame,
+    serverpp::bytes bytes,
+    visibility_set const &visible)
+{
+    auto &target = slot_for(encoder_state, frame);
+    std::unique_lock<std::mutex> lock(target.mutex);
+
+    target.used = true;
+    target.encoder_state = encoder_state;
+    target.frame = frame;
+    target.bytes.assign(bytes.begin(), bytes.end());
+    target.visible = visible;
+}
+
+// ==========================================================================
+// SLOT_FOR
+// ==========================================================================
+frame_cache::slot &frame_cache::slot_for(
+    std::uint64_t encoder_state, std::uint64_t frame)
+{
+    return slots_[hash_combine(encoder_state, frame) % slots_.size()];
+}
+
+}
@@ -0,0 +1,195 @@
+#include "headless_render.hpp"
+#include "allocation_counter.hpp"
+#include "level_map.hpp"
+#include "ui.hpp"
+#include <terminalpp/canvas.hpp>
+#include <terminalpp/terminal.hpp>
+#include <munin/window.hpp>
+#include <boost/format.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+namespace textray {
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// ==========================================================================
+// THREAD_RESULTS
+// ==========================================================================
+struct thread_results
+{
+    std::vector<std::chrono::nanoseconds> frame_times;
+    allocation_count allocations{};
+    std::uint64_t bytes_written{};
+};
+
+// ==========================================================================
+// CAMERA_PATH
+// ==========================================================================
+// A circuit around the open area in the middle of the level map, looking
+// slightly inwards so that both near and far walls are in view.
+// ==========================================================================
+void camera_path(unsigned int frame, vector2d &position, double &heading)
+{
+    static constexpr double centre_x = 4.0;
+    static constexpr double centre_y = 4.5;
+    static constexpr double radius   = 1.4;
+    static constexpr double step     = M_PI / 180;
+
+    auto const angle = frame * step;
+    position = vector2d{
+        centre_x + radius * std::cos(angle),
+        centre_y + radius * std::sin(angle)};
+    heading = angle + M_PI / 2 + M_PI / 8;
+}
+
+// ==========================================================================
+// RENDER_FRAMES
+// ==========================================================================
+void render_frames(
+    headless_render_settings const &settings,
+    thread_results &results)
+{
+    vector2d position;
+    double heading;
+    camera_path(0, position, heading);
+
+    auto user_interface = std::make_shared<ui>(
+        level_world(), no_entity, position, heading, M_PI / 2);
+    user_interface->set_camera_palette(settings.colours);
+    munin::window window{user_interface};
+    terminalpp::terminal terminal{terminalpp::behaviour{}};
+    terminalpp::canvas canvas{settings.size};
+    terminal.set_size(settings.size);
+
+    auto const write =
+        [&results](terminalpp::bytes data)
+        {
+            results.bytes_written += data.size();
+        };
+
+    // The first frame lays out the components and paints the entire
+    // screen, so it is excluded from the measurements.
+    window.repaint(canvas, terminal, write);
+    results.bytes_written = 0;
+
+    results.frame_times.reserve(settings.frames);
+    auto const allocations_before = thread_allocation_count();
+
+    for (unsigned int frame = 1; frame <= settings.frames; ++frame)
+    {
+        camera_path(frame, position, heading);
+
+        auto const start = clock_type::now();
+        user_interface->move_camera_to(position, heading);
+        window.repaint(canvas, terminal, write);
+        auto const end = clock_type::now();
+
+        results.frame_times.push_back(end - start);
+    }
+
+    auto const allocations_after = thread_allocation_count();
+    results.allocations.allocations =
+        allocations_after.allocations - allocations_before.allocations;
+    results.allocations.bytes =
+        allocations_after.bytes - allocations_before.bytes;
+}
+
+// ==========================================================================
+// PERCENTILE
+// ==========================================================================
+std::chrono::nanoseconds percentile(
+    std::vector<std::chrono::nanoseconds> const &sorted_times,
+    double pct)
+{
+    if (sorted_times.empty())
+    {
+        return {};
+    }
+
+    auto const index = std::min(
+        sorted_times.size() - 1,
+        static_cast<std::size_t>(sorted_times.size() * pct / 100));
+
+    return sorted_times[index];
+}
+
+}
+
+// ==========================================================================
+// RUN_HEADLESS_RENDER
+// ==========================================================================
+void run_headless_render(
+    headless_render_settings const &settings,
+    std::ostream &out)
+{
+    auto const threads = std::max(settings.threads, 1u);
+    std::vector<thread_results> results(threads);
+    std::vector<std::thread> threadpool;
+
+    auto const start = clock_type::now();
+
+    for (unsigned int thr = 0; thr < threads; ++thr)
+    {
+        threadpool.emplace_back(
+            [&settings, &results, thr]
+            {
+                render_frames(settings, results[thr]);
+            });
+    }
+
+    for (auto &pthread : threadpool)
+    {
+        pthread.join();
+    }
+
+    auto const elapsed = std::chrono::duration<double>(
+        clock_type::now() - start);
+
+    std::vector<std::chrono::nanoseconds> frame_times;
+    allocation_count allocations{};
+    std::uint64_t bytes_written = 0;
+
+    for (auto const &result : results)
+    {
+        frame_times.insert(
+            frame_times.end(),
+            result.frame_times.begin(),
+            result.frame_times.end());
+        allocations.allocations += result.allocations.allocations;
+        allocations.bytes += result.allocations.bytes;
+        bytes_written += result.bytes_written;
+    }
+
+    std::sort(frame_times.begin(), frame_times.end());
+
+    auto const frames = std::max<std::size_t>(frame_times.size(), 1);
+
+    out << boost::format(
+            "Rendered %u frames of %ux%u in the %s palette on %u thread(s) in %.3fs\n"
+            "  frames/sec:         %.1f\n"
+            "  p50 frame time:     %uns\n"
+            "  p99 frame time:     %uns\n"
+            "  allocations/frame:  %.1f (%.1f bytes)\n"
+            "  output bytes/frame: %.1f\n")
+        % frame_times.size()
+        % settings.size.width_
+        % settings.size.height_
+        % palette_name(settings.colours)
+        % threads
+        % elapsed.count()
+        % (frame_times.size() / elapsed.count())
+        % percentile(frame_times, 50).count()
+        % percentile(frame_times, 99).count()
+        % (double(allocations.allocations) / frames)
+        % (double(allocations.bytes) / frames)
+        % (double(bytes_written) / frames);
+}
+
+}
@@ -0,0 +1,24 @@
+#include "level_map.hpp"
+#include "world.hpp"
+
+namespace textray {
+
+floorplan const level_map = {
+ { 1, 1, 2, 2, 3, 3, 4, 4 },
+ { 3, 0, 0, 0, 0, 0, 0, 4 },
+ { 3, 0, 0, 0, 5, 0, 0, 4 },
+ { 4, 2, 0, 0, 0, 0, 0, 5 },
+ { 4, 2, 0, 0, 0, 0, 0, 5 },
+ { 5, 0, 0, 0, 0, 0, 0, 6 },
+ { 5, 0, 0, 1, 0, 0, 0, 6 },
+ { 7, 0, 0, 0, 0, 0, 0, 7 },
+ { 7, 4, 4, 2, 2, 5, 5, 9 }
+};
+
+std::shared_ptr<world> level_world()
+{
+    static auto const shared_world = std::make_shared<world>(level_map, vector2d{3, 2});
+    return shared_world;
+}
+
+}
@@ -0,0 +1,190 @@
+#include "loopback_transport.hpp"
+#include <boost/asio/post.hpp>
+#include <mutex>
+
+namespace textray {
+
+// ==========================================================================
+// LOOPBACK_PEER::CHANNEL STRUCTURE
+// ==========================================================================
+struct loopback_peer::channel
+  : std::enable_shared_from_this<loopback_peer::channel>
+{
+    explicit channel(boost::asio::io_context &context)
+      : io_context(context)
+    {
+    }
+
+    // ======================================================================
+    // DISPATCH_READ
+    // ======================================================================
+    // Completes any outstanding read with any outstanding data.  Must be
+    // called with the mutex held.
+    // ======================================================================
+    void dispatch_read()
+    {
+        if (!read_continuation || (inbound.empty() && alive))
+        {
+            return;
+        }
+
+        auto continuation = std::move(read_continuation);
+        read_continuation = nullptr;
+
+        serverpp::byte_storage data;
+        data.swap(inbound);
+
+        boost::asio::post(
+            io_context,
+            [self = shared_from_this(), 
+             continuation = std::move(continuation),
+             data = std::move(data)]
+            {
+                continuation(data);
+            });
+    }
+
+    boost::asio::io_context &io_context;
+
+    mutable std::mutex mutex;
+    bool alive = true;
+    serverpp::byte_storage inbound;
+    std::function<void (serverpp::bytes)> read_continuation;
+    std::function<void (serverpp::bytes)> receive_callback;
+};
+
+// ==========================================================================
+// LOOPBACK_PEER CONSTRUCTOR
+// ==========================================================================
+loopback_peer::loopback_peer(std::shared_ptr<channel> chan)
+  : channel_(std::move(chan))
+{
+}
+
+// ==========================================================================
+// LOOPBACK_PEER::SEND
+// ==========================================================================
+void loopback_peer::send(serverpp::bytes data)
+{
+    std::unique_lock<std::mutex> lock(channel_->mutex);
+
+    if (channel_->alive)
+    {
+        channel_->inbound.insert(
+            channel_->inbound.end(), data.begin(), data.end());
+        channel_->dispatch_read();
+    }
+}
+
+// ==========================================================================
+// LOOPBACK_PEER::CLOSE
+// ==========================================================================
+void loopback_peer::close()
+{
+    std::unique_lock<std::mutex> lock(channel_->mutex);
+    channel_->alive = false;
+    channel_->dispatch_read();
+}
+
+// ==========================================================================
+// LOOPBACK_PEER::IS_ALIVE
+// ==========================================================================
+bool loopback_peer::is_alive() const
+{
+    std::unique_lock<std::mutex> lock(channel_->mutex);
+    return channel_->alive;
+}
+
+// ==========================================================================
+// LOOPBACK_PEER::ON_RECEIVE
+// ==========================================================================
+void loopback_peer::on_receive(
+    std::function<void (serverpp::bytes)> const &callback)
+{
+    std::unique_lock<std::mutex> lock(channel_->mutex);
+    channel_->receive_callback = callback;
+}
+
+// ==========================================================================
+// CONSTRUCTOR
+// ==========================================================================
+loopback_transport::loopback_transport(boost::asio::io_context &io_context)
+  : channel_(std::make_shared<loopback_peer::channel>(io_context))
+{
+}
+
+// ==========================================================================
+// DESTRUCTOR
+// ==========================================================================
+loopback_transport::~loopback_transport()
+{
+    // Any outstanding read refers to the connection that owns this
+    // transport, so it is abandoned rather than completed.
+    std::unique_lock<std::mutex> lock(channel_->mutex);
+    channel_->alive = false;
+    channel_->read_continuation = nullptr;
+}
+
+// ==========================================================================
+// PEER
+// ==========================================================================
+std::shared_ptr<loopback_peer> loopback_transport::peer() const
+{
+    return std::shared_ptr<loopback_peer>(new loopback_peer(channel_));
+}
+
+// ==========================================================================
+// IS_ALIVE
+// ==========================================================================
+bool loopback_transport::is_alive() const
+{
+    std::unique_lock<std::mutex> lock(channel_->mutex);
+    return channel_->alive;
+}
+
+// ==========================================================================
+// CLOSE
+// ==========================================================================
+void loopback_transport::close()
+{
+    std::unique_lock<std::mutex> lock(channel_->mutex);
+    channel_->alive = false;
+    channel_->dispatch_read();
+}
+
+// ==========================================================================
+// ASYNC_READ
+// ==========================================================================
+void loopback_transport::async_read(
+    std::function<void (serverpp::bytes)> const &continuation)
+{
+    std::unique_lock<std::mutex> lock(channel_->mutex);
+    channel_->read_continuation = continuation;
+    channel_->dispatch_read();
+}
+
+// ==========================================================================
+// WRITE
+// ==========================================================================
+void loopback_transport::write(serverpp::bytes data)
+{
+    std::function<void (serverpp::bytes)> callback;
+
+    {
+        std::unique_lock<std::mutex> lock(channel_->mutex);
+
+        if (!channel_->alive)
+        {
+            return;
+        }
+
+        callback = channel_->receive_callback;
+    }
+
+    if (callback)
+    {
+        callback(data);
+    }
+}
+
+}
@@ -1,7 +1,13 @@
 #include "application.hpp"
+#include "headless_render.hpp"
+#include "level_map.hpp"
+#include "map_file.hpp"
+#include "tracing.hpp"
+#include "world.hpp"
 #include <boost/format.hpp>
 #include <boost/program_options.hpp>
 #include <iostream>
+#include <stdexcept>
 #include <string>
 #include <thread>
 #include <vector>
@@ -10,15 +16,34 @@ namespace po = boost::program_options;
 
 int main(int argc, char *argv[])
 {
-    uint16_t port            = 4000;
-    std::string  threads     = "";
-    unsigned int concurrency = 0;
+    uint16_t port             = 4000;
+    std::string  threads      = "";
+    unsigned int concurrency  = 0;
+    int bench_frames          = 0;
+    uint16_t bench_width      = 80;
+    uint16_t bench_height     = 24;
+    std::string bench_palette = "low";
+    auto bench_colours        = textray::palette::low;
+    std::string record_dir    = "";
+    uint16_t metrics_port     = 0;
+    unsigned int trace_sample = 0;
+    std::string map_path      = "";
+    unsigned int tick_rate    = 30;
     
     po::options_description description("Available options");
     description.add_options()
-        ( "help,h",                                       "show this help message"                            )
-        ( "port,p",    po::value<uint16_t>(&port),        "port identifier"                                   )
-        ( "threads,t", po::value<std::string>(&threads),  "number of threads of execution (0 for autodetect)" )
+        ( "help,h",                                                   "show this help message"                               )
+        ( "port,p",       po::value<uint16_t>(&port),                 "port identifier"                                      )
+        ( "threads,t",    po::value<std::string>(&threads),           "number of threads of execution (0 for autodetect)"    )
+        ( "bench-render", po::value<int>(&bench_frames),              "render this many frames per thread headlessly, then exit" )
+        ( "bench-width",  po::value<uint16_t>(&bench_width),          "terminal width for --bench-render"                    )
+        ( "bench-height", po::value<uint16_t>(&bench_height),         "terminal height for --bench-render"                   )
+        ( "bench-palette", po::value<std::string>(&bench_palette),    "palette for --bench-render: low, high or saver"       )
+        ( "record-dir",   po::value<std::string>(&record_dir),        "record the input of every session to this directory"  )
+        ( "metrics-port", po::value<uint16_t>(&metrics_port),         "serve Prometheus metrics on this localhost port"      )
+        ( "trace-sample", po::value<unsigned int>(&trace_sample),     "trace one in this many input events (0 to disable)"   )
+        ( "map",          po::value<std::string>(&map_path),          "load the world from this binary map file"             )
+        ( "tick-rate",    po::value<unsigned int>(&tick_rate),        "simulation ticks per second (0 to move on each input)" )
         ;
 
     po::positional_options_description pos_description;
@@ -40,10 +65,18 @@ int main(int argc, char *argv[])
         {
             throw po::error("");
         }
-        else if (vm.count("port") == 0)
+        else if (vm.count("port") == 0 && vm.count("bench-render") == 0)
         {
             throw po::error("Port identifier must be specified");
         }
+        else if (vm.count("bench-render") != 0 && bench_frames <= 0)
+        {
+            throw po::error("Frame count for --bench-render must be positive");
+        }
+        else if (!textray::parse_palette(bench_palette, bench_colours))
+        {
+            throw po::error("Palette must be one of low, high or saver");
+        }
 
         if (vm.count("threads") == 0)
         {
@@ -99,8 +132,39 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
+    if (bench_frames != 0)
+    {
+        textray::headless_render_settings settings;
+        settings.frames  = static_cast<unsigned int>(bench_frames);
+        settings.threads = concurrency;
+        settings.size    = terminalpp::extent(bench_width, bench_height);
+        settings.colours = bench_colours;
+
+        textray::run_headless_render(settings, std::cout);
+        return EXIT_SUCCESS;
+    }
+
+    textray::set_trace_sampling(trace_sample);
+
+    auto shared_world = textray::level_world();
+
+    if (!map_path.empty())
+    {
+        try
+        {
+            shared_world = std::make_shared<textray::world>(
+                textray::map_file::open(map_path));
+        }
+        catch (std::runtime_error const &err)
+        {
+            std::cerr << boost::format("ERROR: %s\n") % err.what();
+            return EXIT_FAILURE;
+        }
+    }
+
     boost::asio::io_context io_context;
-    textray::application application{io_context, port};
+    textray::application application{
+        io_context, port, record_dir, metrics_port, shared_world, tick_rate};
 
     std::vector<std::thread> threadpool;
 
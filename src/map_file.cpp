@@ -0,0 +1,203 @@
+#include "map_file.hpp"
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace textray {
+
+constexpr std::uint32_t map_file::version;
+constexpr int map_file::chunk_bits;
+
+namespace {
+
+constexpr char magic[8] = { 'T', 'X', 'R', 'M', 'A', 'P', 0, 0 };
+constexpr std::size_t header_size = 64;
+
+// ==========================================================================
+// LITTLE-ENDIAN ACCESS
+// ==========================================================================
+std::uint64_t read_le(std::uint8_t const *data, std::size_t bytes)
+{
+    std::uint64_t value = 0;
+
+    for (std::size_t index = 0; index < bytes; ++index)
+    {
+        value |= std::uint64_t(data[index]) << (8 * index);
+    }
+
+    return value;
+}
+
+void write_le(std::vector<std::uint8_t> &data, std::size_t offset, std::uint64_t value, std::size_t bytes)
+{
+    for (std::size_t index = 0; index < bytes; ++index)
+    {
+        data[offset + index] = std::uint8_t(value >> (8 * index));
+    }
+}
+
+// ==========================================================================
+// LAYOUT
+// ==========================================================================
+// The size and offset of the tiles of a map with the given dimensions.
+// ==========================================================================
+struct layout
+{
+    layout(std::uint64_t width, std::uint64_t height)
+    {
+        auto const chunk_size = std::uint64_t(1) << map_file::chunk_bits;
+        chunks_wide = (width + chunk_size - 1) >> map_file::chunk_bits;
+        chunks_high = (height + chunk_size - 1) >> map_file::chunk_bits;
+
+        tiles_offset = header_size;
+        tiles_size = chunks_wide * chunks_high * chunk_size * chunk_size;
+        file_size = tiles_offset + tiles_size;
+    }
+
+    std::uint64_t chunks_wide;
+    std::uint64_t chunks_high;
+    std::uint64_t tiles_offset;
+    std::uint64_t tiles_size;
+    std::uint64_t file_size;
+};
+
+}
+
+// ==========================================================================
+// OPEN
+// ==========================================================================
+std::shared_ptr<map_file const> map_file::open(std::string const &path)
+{
+    auto const fd = ::open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+    {
+        throw std::runtime_error("cannot open map " + path);
+    }
+
+    struct stat status;
+
+    if (::fstat(fd, &status) != 0 || std::size_t(status.st_size) < header_size)
+    {
+        ::close(fd);
+        throw std::runtime_error("not a map file");
+    }
+
+    auto const size = std::size_t(status.st_size);
+    auto *const mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        throw std::runtime_error("cannot map " + path);
+    }
+
+    std::shared_ptr<map_file> file{new map_file};
+    file->mapping_ = mapping;
+    file->mapping_size_ = size;
+
+    auto const *const data = static_cast<std::uint8_t const *>(mapping);
+
+    if (std::memcmp(data, magic, sizeof(magic)) != 0
+     || read_le(data + 8, 4) != version)
+    {
+        throw std::runtime_error("not a map file");
+    }
+
+    auto const file_chunk_bits = read_le(data + 12, 4);
+    auto const width = read_le(data + 16, 4);
+    auto const height = read_le(data + 20, 4);
+
+    if (file_chunk_bits != std::uint64_t(chunk_bits))
+    {
+        throw std::runtime_error("map file has chunks of an unsupported size");
+    }
+
+    if (width > 0x7FFFFFFF || height > 0x7FFFFFFF)
+    {
+        throw std::runtime_error("map file is corrupt");
+    }
+
+    layout const expected{width, height};
+
+    if (read_le(data + 24, 8) != expected.tiles_offset
+     || size < expected.file_size)
+    {
+        throw std::runtime_error("map file is corrupt");
+    }
+
+    file->width_ = int(width);
+    file->height_ = int(height);
+    file->chunks_wide_ = int(expected.chunks_wide);
+    file->tiles_ = data + expected.tiles_offset;
+
+    // Only the header is read ahead.  The tiles are paged in as the parts
+    // of the map that players see are drawn, so opening a large map does
+    // not read all of it.
+    ::madvise(mapping, header_size, MADV_WILLNEED);
+
+    return file;
+}
+
+// ==========================================================================
+// DESTRUCTOR
+// ==========================================================================
+map_file::~map_file()
+{
+    if (mapping_ != nullptr)
+    {
+        ::munmap(mapping_, mapping_size_);
+    }
+}
+
+// ==========================================================================
+// WRITE_MAP_FILE
+// ==========================================================================
+void write_map_file(std::ostream &out, floorplan const &plan)
+{
+    constexpr auto chunk_bits = map_file::chunk_bits;
+    constexpr auto chunk_size = std::uint64_t(1) << chunk_bits;
+
+    auto const width = std::uint64_t(plan.width());
+    auto const height = std::uint64_t(plan.height());
+
+    layout const sections{width, height};
+    std::vector<std::uint8_t> data(sections.file_size, 0);
+
+    std::memcpy(data.data(), magic, sizeof(magic));
+    write_le(data, 8, map_file::version, 4);
+    write_le(data, 12, std::uint64_t(chunk_bits), 4);
+    write_le(data, 16, width, 4);
+    write_le(data, 20, height, 4);
+    write_le(data, 24, sections.tiles_offset, 8);
+
+    for (std::uint64_t y = 0; y < height; ++y)
+    {
+        for (std::uint64_t x = 0; x < width; ++x)
+        {
+            auto const id = plan[int(y)][x];
+
+            if (id == 0)
+            {
+                continue;
+            }
+
+            auto const chunk_x = x >> chunk_bits;
+            auto const chunk_y = y >> chunk_bits;
+            auto const chunk_index = chunk_y * sections.chunks_wide + chunk_x;
+            auto const within = 
+                ((y & (chunk_size - 1)) << chunk_bits) + (x & (chunk_size - 1));
+
+            data[sections.tiles_offset + chunk_index * chunk_size * chunk_size + within] = id;
+        }
+    }
+
+    out.write(reinterpret_cast<char const *>(data.data()), std::streamsize(data.size()));
+}
+
+}
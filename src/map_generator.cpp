@@ -0,0 +1,430 @@
+#include "map_generator.hpp"
+#include "chunk_cache.hpp"
+#include "world.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace textray {
+
+namespace {
+
+// ==========================================================================
+// MAP_RANDOM
+// ==========================================================================
+// A splitmix64 generator.  The standard distributions are not specified
+// exactly, so values are derived here to keep maps identical everywhere.
+// ==========================================================================
+class map_random
+{
+public :
+    explicit map_random(std::uint64_t seed)
+      : state_(seed)
+    {
+    }
+
+    std::uint64_t next()
+    {
+        auto z = (state_ += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Returns a value in [0, bound).
+    int below(int bound)
+    {
+        return int(next() % std::uint64_t(bound));
+    }
+
+    // Returns a wall colour.
+    tile colour()
+    {
+        return tile(1 + below(9));
+    }
+
+private :
+    std::uint64_t state_;
+};
+
+// ==========================================================================
+// DRAW_BORDER
+// ==========================================================================
+void draw_border(floorplan &plan, map_random &random)
+{
+    auto const colour = random.colour();
+
+    for (int x = 0; x < plan.width(); ++x)
+    {
+        plan[0][x] = colour;
+        plan[plan.height() - 1][x] = colour;
+    }
+
+    for (int y = 0; y < plan.height(); ++y)
+    {
+        plan[y][0] = colour;
+        plan[y][plan.width() - 1] = colour;
+    }
+}
+
+// ==========================================================================
+// GENERATE_MAZE
+// ==========================================================================
+// Cells lie on odd co-ordinates; a depth-first search knocks out the walls
+// between them.  The search uses an explicit stack so that very large
+// mazes do not exhaust the call stack.
+// ==========================================================================
+void generate_maze(floorplan &plan, map_random &random)
+{
+    for (int y = 0; y < plan.height(); ++y)
+    {
+        for (int x = 0; x < plan.width(); ++x)
+        {
+            plan[y][x] = tile(1 + (x / 8 + y / 8) % 9);
+        }
+    }
+
+    auto const cells_wide = (plan.width() - 1) / 2;
+    auto const cells_high = (plan.height() - 1) / 2;
+
+    if (cells_wide == 0 || cells_high == 0)
+    {
+        return;
+    }
+
+    static int const dx[] = { 1, -1, 0, 0 };
+    static int const dy[] = { 0, 0, 1, -1 };
+
+    std::vector<std::pair<int, int>> stack;
+    stack.emplace_back(0, 0);
+    plan[1][1] = 0;
+
+    while (!stack.empty())
+    {
+        auto const cell = stack.back();
+        int choices[4];
+        int choice_count = 0;
+
+        for (int direction = 0; direction < 4; ++direction)
+        {
+            auto const nx = cell.first + dx[direction];
+            auto const ny = cell.second + dy[direction];
+
+            if (nx >= 0 && ny >= 0 && nx < cells_wide && ny < cells_high
+             && plan[ny * 2 + 1][nx * 2 + 1] != 0)
+            {
+                choices[choice_count++] = direction;
+            }
+        }
+
+        if (choice_count == 0)
+        {
+            stack.pop_back();
+            continue;
+        }
+
+        auto const direction = choices[random.below(choice_count)];
+        auto const nx = cell.first + dx[direction];
+        auto const ny = cell.second + dy[direction];
+
+        plan[cell.second * 2 + 1 + dy[direction]][cell.first * 2 + 1 + dx[direction]] = 0;
+        plan[ny * 2 + 1][nx * 2 + 1] = 0;
+        stack.emplace_back(nx, ny);
+    }
+}
+
+// ==========================================================================
+// ARENA_TILE
+// ==========================================================================
+// Returns the tile at a position inside an arena: mostly open, with one in
+// every two hundred a pillar.
+// ==========================================================================
+tile arena_tile(map_random &random)
+{
+    return random.below(200) == 0 ? random.colour() : tile(0);
+}
+
+// ==========================================================================
+// GENERATE_ARENA
+// ==========================================================================
+void generate_arena(floorplan &plan, map_random &random)
+{
+    for (int y = 1; y < plan.height() - 1; ++y)
+    {
+        for (int x = 1; x < plan.width() - 1; ++x)
+        {
+            plan[y][x] = arena_tile(random);
+        }
+    }
+}
+
+// ==========================================================================
+// GENERATE_CITY
+// ==========================================================================
+// Streets two tiles wide run in both directions at random intervals.  The
+// blocks between them are filled with buildings, some of which are left
+// as open squares.
+// ==========================================================================
+void generate_city(floorplan &plan, map_random &random)
+{
+    auto const street_positions = 
+        [&random](int extent)
+        {
+            std::vector<int> positions;
+
+            for (int position = 1; position < extent - 1; )
+            {
+                positions.push_back(position);
+                position += 2 + 4 + random.below(9);
+            }
+
+            positions.push_back(extent - 1);
+            return positions;
+        };
+
+    auto const columns = street_positions(plan.width());
+    auto const rows = street_positions(plan.height());
+
+    for (std::size_t row = 0; row + 1 < rows.size(); ++row)
+    {
+        for (std::size_t column = 0; column + 1 < columns.size(); ++column)
+        {
+            if (random.below(8) == 0)
+            {
+                continue;
+            }
+
+            auto const colour = random.colour();
+
+            for (int y = rows[row] + 2; y < rows[row + 1]; ++y)
+            {
+                for (int x = columns[column] + 2; x < columns[column + 1]; ++x)
+                {
+                    plan[y][x] = colour;
+                }
+            }
+        }
+    }
+}
+
+// ==========================================================================
+// GENERATE_CORRIDORS
+// ==========================================================================
+// Horizontal corridors three tiles high separated by single walls, with a
+// gap in each wall roughly every sixty-four tiles.
+// ==========================================================================
+void generate_corridors(floorplan &plan, map_random &random)
+{
+    for (int y = 4; y < plan.height() - 1; y += 4)
+    {
+        auto const colour = random.colour();
+
+        for (int x = 1; x < plan.width() - 1; ++x)
+        {
+            plan[y][x] = random.below(64) == 0 ? 0 : colour;
+        }
+    }
+}
+
+}
+
+// ==========================================================================
+// GENERATE_MAP
+// ==========================================================================
+floorplan generate_map(
+    map_style style, int width, int height, std::uint64_t seed)
+{
+    if (width < 3 || height < 3)
+    {
+        throw std::invalid_argument("maps must be at least 3x3");
+    }
+
+    floorplan plan{width, height};
+    map_random random{seed};
+
+    switch (style)
+    {
+        case map_style::maze :
+            generate_maze(plan, random);
+            break;
+
+        case map_style::arena :
+            generate_arena(plan, random);
+            break;
+
+        case map_style::city :
+            generate_city(plan, random);
+            break;
+
+        case map_style::corridors :
+            generate_corridors(plan, random);
+            break;
+    }
+
+    draw_border(plan, random);
+    return plan;
+}
+
+// ==========================================================================
+// GENERATE_ARENA_CHUNK
+// ==========================================================================
+void generate_arena_chunk(
+    int width, 
+    int height, 
+    int chunk_x, 
+    int chunk_y, 
+    std::uint64_t seed, 
+    world_chunk &chunk)
+{
+    auto const border_colour = map_random{seed}.colour();
+    auto const chunk_key = 
+        (std::uint64_t(std::uint32_t(chunk_y)) << 32 | std::uint32_t(chunk_x)) + 1;
+    map_random random{seed ^ (chunk_key * 0x9E3779B97F4A7C15ull)};
+
+    for (int y = 0; y < world_chunk::size; ++y)
+    {
+        for (int x = 0; x < world_chunk::size; ++x)
+        {
+            auto const world_x = chunk_x * world_chunk::size + x;
+            auto const world_y = chunk_y * world_chunk::size + y;
+            auto &value = chunk.tiles[y * world_chunk::size + x];
+
+            if (world_x >= width || world_y >= height)
+            {
+                value = 0;
+            }
+            else if (world_x == 0 || world_y == 0
+                  || world_x == width - 1 || world_y == height - 1)
+            {
+                value = border_colour;
+            }
+            else
+            {
+                value = arena_tile(random);
+            }
+        }
+    }
+}
+
+// ==========================================================================
+// PARSE_MAP_STYLE
+// ==========================================================================
+map_style parse_map_style(std::string const &name)
+{
+    static std::pair<char const *, map_style> const styles[] = {
+        { "maze",      map_style::maze      },
+        { "arena",     map_style::arena     },
+        { "city",      map_style::city      },
+        { "corridors", map_style::corridors },
+    };
+
+    for (auto const &style : styles)
+    {
+        if (name == style.first)
+        {
+            return style.second;
+        }
+    }
+
+    throw std::invalid_argument("unknown map style " + name);
+}
+
+namespace {
+
+// ==========================================================================
+// FIND_OPEN_TILE_IN
+// ==========================================================================
+// Each ring is walked in row-major order, visiting only the tiles on its
+// edges that lie on the map: the top edge, the two ends of each row in
+// between, and then the bottom edge.  A search that finds nothing
+// therefore looks at each tile once.
+// ==========================================================================
+template <class Plan>
+void find_open_tile_in(Plan const &plan, int &x, int &y)
+{
+    auto const centre_x = plan.width() / 2;
+    auto const centre_y = plan.height() / 2;
+    auto const max_radius = std::max(plan.width(), plan.height()) / 2;
+
+    auto const open_at = 
+        [&](int tx, int ty)
+        {
+            if (plan.contains(tx, ty) && plan.tile_at(tx, ty) == 0)
+            {
+                x = tx;
+                y = ty;
+                return true;
+            }
+
+            return false;
+        };
+
+    auto const open_in_row =
+        [&](int ty, int left, int right)
+        {
+            if (ty < 0 || ty >= plan.height())
+            {
+                return false;
+            }
+
+            for (int tx = std::max(left, 0); tx <= std::min(right, plan.width() - 1); ++tx)
+            {
+                if (open_at(tx, ty))
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        };
+
+    for (int radius = 0; radius <= max_radius; ++radius)
+    {
+        auto const left = centre_x - radius;
+        auto const right = centre_x + radius;
+        auto const top = centre_y - radius;
+        auto const bottom = centre_y + radius;
+
+        if (open_in_row(top, left, right))
+        {
+            return;
+        }
+
+        for (int ty = std::max(top + 1, 0); ty < std::min(bottom, plan.height()); ++ty)
+        {
+            if (open_at(left, ty) || open_at(right, ty))
+            {
+                return;
+            }
+        }
+
+        if (radius != 0 && open_in_row(bottom, left, right))
+        {
+            return;
+        }
+    }
+
+    x = centre_x;
+    y = centre_y;
+}
+
+}
+
+// ==========================================================================
+// FIND_OPEN_TILE
+// ==========================================================================
+void find_open_tile(floorplan const &plan, int &x, int &y)
+{
+    find_open_tile_in(plan, x, y);
+}
+
+// ==========================================================================
+// FIND_OPEN_TILE (WORLD SNAPSHOT)
+// ==========================================================================
+void find_open_tile(world_snapshot const &snapshot, int &x, int &y)
+{
+    find_open_tile_in(snapshot, x, y);
+}
+
+}
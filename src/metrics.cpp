@@ -0,0 +1,234 @@
+#include "metrics.hpp"
+#include <boost/format.hpp>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace textray {
+
+namespace {
+
+// ==========================================================================
+// METRIC_DESCRIPTION
+// ==========================================================================
+// Metrics that share a family name are reported together, distinguished
+// by their labels.
+// ==========================================================================
+struct metric_description
+{
+    char const *family;
+    char const *labels;
+    char const *help;
+};
+
+metric_description const counter_descriptions[] = {
+    { "textray_connections_accepted_total", "",                         "Connections accepted"                },
+    { "textray_repaints_total",             "",                         "Screen repaints sent to clients"     },
+    { "textray_output_bytes_total",         "stage=\"uncompressed\"",   "Bytes written to clients"            },
+    { "textray_output_bytes_total",         "stage=\"compressed\"",     "Bytes written to clients"            },
+    { "textray_inputs_dropped_total",       "",                         "Inputs dropped because a client's queue was full" },
+    { "textray_spectator_frames_total",     "stage=\"encoded\"",        "Frames of spectator feeds"             },
+    { "textray_spectator_frames_total",     "stage=\"sent\"",           "Frames of spectator feeds"             },
+    { "textray_frame_cache_lookups_total",  "result=\"hit\"",           "Frames looked up in the encoded frame cache" },
+    { "textray_frame_cache_lookups_total",  "result=\"miss\"",          "Frames looked up in the encoded frame cache" },
+};
+
+metric_description const gauge_descriptions[] = {
+    { "textray_clients",                    "state=\"setup\"",          "Clients in each connection state"    },
+    { "textray_clients",                    "state=\"main\"",           "Clients in each connection state"    },
+    { "textray_clients",                    "state=\"dead\"",           "Clients in each connection state"    },
+    { "textray_transport_writers",          "",                         "Threads currently inside a synchronous transport write" },
+};
+
+metric_description const histogram_descriptions[] = {
+    { "textray_render_duration_nanoseconds",  "", "Time taken to ray-cast a camera frame" },
+    { "textray_repaint_duration_nanoseconds", "", "Time taken to draw, diff and encode a repaint" },
+    { "textray_tick_duration_nanoseconds",    "", "Time taken to advance the simulation by one tick" },
+};
+
+static_assert(
+    sizeof(counter_descriptions) / sizeof(counter_descriptions[0]) 
+        == std::size_t(metric_counter::count_),
+    "every counter must be described");
+static_assert(
+    sizeof(gauge_descriptions) / sizeof(gauge_descriptions[0]) 
+        == std::size_t(metric_gauge::count_),
+    "every gauge must be described");
+static_assert(
+    sizeof(histogram_descriptions) / sizeof(histogram_descriptions[0]) 
+        == std::size_t(metric_histogram::count_),
+    "every histogram must be described");
+
+std::mutex shards_mutex;
+std::vector<std::unique_ptr<detail::metrics_shard>> shards;
+
+// ==========================================================================
+// SERIES_NAME
+// ==========================================================================
+std::string series_name(
+    std::string const &name, std::string const &labels)
+{
+    return labels.empty() ? name : name + "{" + labels + "}";
+}
+
+// ==========================================================================
+// APPEND_HEADER
+// ==========================================================================
+// Families are written with a single HELP and TYPE, before their first
+// series.
+// ==========================================================================
+void append_header(
+    std::string &text,
+    metric_description const *descriptions,
+    std::size_t index,
+    char const *type)
+{
+    if (index == 0 
+     || std::string(descriptions[index].family) 
+            != descriptions[index - 1].family)
+    {
+        text += (boost::format("# HELP %s %s\n# TYPE %s %s\n")
+            % descriptions[index].family
+            % descriptions[index].help
+            % descriptions[index].family
+            % type).str();
+    }
+}
+
+}
+
+namespace detail {
+
+// ==========================================================================
+// REGISTER_METRICS_SHARD
+// ==========================================================================
+metrics_shard *register_metrics_shard()
+{
+    auto shard = std::unique_ptr<metrics_shard>(new metrics_shard{});
+    auto *result = shard.get();
+
+    std::unique_lock<std::mutex> lock(shards_mutex);
+    shards.push_back(std::move(shard));
+
+    return result;
+}
+
+}
+
+// ==========================================================================
+// METRICS_TEXT
+// ==========================================================================
+std::string metrics_text()
+{
+    using detail::log_linear_histogram;
+
+    std::unique_lock<std::mutex> lock(shards_mutex);
+    std::string text;
+
+    for (std::size_t index = 0; index < std::size_t(metric_counter::count_); ++index)
+    {
+        std::uint64_t total = 0;
+
+        for (auto const &shard : shards)
+        {
+            total += shard->counters[index].load(std::memory_order_relaxed);
+        }
+
+        append_header(text, counter_descriptions, index, "counter");
+        text += series_name(
+            counter_descriptions[index].family, 
+            counter_descriptions[index].labels);
+        text += " " + std::to_string(total) + "\n";
+    }
+
+    for (std::size_t index = 0; index < std::size_t(metric_gauge::count_); ++index)
+    {
+        std::int64_t total = 0;
+
+        for (auto const &shard : shards)
+        {
+            total += shard->gauges[index].load(std::memory_order_relaxed);
+        }
+
+        append_header(text, gauge_descriptions, index, "gauge");
+        text += series_name(
+            gauge_descriptions[index].family, 
+            gauge_descriptions[index].labels);
+        text += " " + std::to_string(total) + "\n";
+    }
+
+    for (std::size_t index = 0; index < std::size_t(metric_histogram::count_); ++index)
+    {
+        std::vector<std::uint64_t> buckets(log_linear_histogram::bucket_count);
+        std::uint64_t sum = 0;
+
+        for (auto const &shard : shards)
+        {
+            auto const &histogram = shard->histograms[index];
+
+            for (std::size_t bucket = 0; bucket < buckets.size(); ++bucket)
+            {
+                buckets[bucket] += 
+                    histogram.buckets[bucket].load(std::memory_order_relaxed);
+            }
+
+            sum += histogram.sum.load(std::memory_order_relaxed);
+        }
+
+        auto const &description = histogram_descriptions[index];
+        append_header(text, histogram_descriptions, index, "histogram");
+
+        // Report cumulative counts at each power of two, up to the one that
+        // covers the largest value seen.
+        std::size_t last_used = 0;
+
+        for (std::size_t bucket = 0; bucket < buckets.size(); ++bucket)
+        {
+            if (buckets[bucket] != 0)
+            {
+                last_used = bucket | (log_linear_histogram::sub_buckets - 1);
+            }
+        }
+
+        std::uint64_t cumulative = 0;
+        auto const bucket_name = std::string(description.family) + "_bucket";
+        auto const label_prefix = std::string(description.labels).empty()
+          ? std::string()
+          : std::string(description.labels) + ",";
+
+        for (std::size_t bucket = 0; bucket <= last_used; ++bucket)
+        {
+            cumulative += buckets[bucket];
+
+            if (bucket % log_linear_histogram::sub_buckets 
+                    == log_linear_histogram::sub_buckets - 1)
+            {
+                text += (boost::format("%s{%sle=\"%u\"} %u\n")
+                    % bucket_name
+                    % label_prefix
+                    % log_linear_histogram::upper_bound_of(bucket)
+                    % cumulative).str();
+            }
+        }
+
+        for (std::size_t bucket = last_used + 1; bucket < buckets.size(); ++bucket)
+        {
+            cumulative += buckets[bucket];
+        }
+
+        text += (boost::format("%s{%sle=\"+Inf\"} %u\n")
+            % bucket_name
+            % label_prefix
+            % cumulative).str();
+        text += series_name(
+            std::string(description.family) + "_sum", description.labels);
+        text += " " + std::to_string(sum) + "\n";
+        text += series_name(
+            std::string(description.family) + "_count", description.labels);
+        text += " " + std::to_string(cumulative) + "\n";
+    }
+
+    return text;
+}
+
+}
@@ -0,0 +1,289 @@
+#include "metrics_server.hpp"
+#include "metrics.hpp"
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/io_context_strand.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/format.hpp>
+#include <chrono>
+#include <istream>
+#include <map>
+#include <mutex>
+
+namespace textray {
+
+using boost::asio::ip::tcp;
+
+namespace {
+
+// The most that is read of a request before it is dropped.  Requests are
+// only ever a request line and a few headers.
+constexpr std::size_t max_request_size = 8192;
+
+// How long a session may take to send its request and read the response
+// before its connection is closed.
+constexpr auto session_timeout = std::chrono::seconds(5);
+
+// ==========================================================================
+// PAGE
+// ==========================================================================
+struct page
+{
+    std::string content_type;
+    metrics_server::page_function function;
+};
+
+// ==========================================================================
+// HTTP_SESSION
+// ==========================================================================
+// Reads a single request from a socket, writes the response and closes.
+// A request that is too large, or a session that takes too long, is
+// closed without a response.
+// ==========================================================================
+class http_session : public std::enable_shared_from_this<http_session>
+{
+public :
+    http_session(
+        boost::asio::io_context &io_context,
+        tcp::socket &&socket,
+        std::function<std::string (std::string const &)> const &respond)
+      : strand_(io_context),
+        timer_(io_context),
+        socket_(std::move(socket)),
+        respond_(respond),
+        request_(max_request_size)
+    {
+    }
+
+    void start()
+    {
+        timer_.expires_after(session_timeout);
+        timer_.async_wait(boost::asio::bind_executor(
+            strand_,
+            [self = shared_from_this()](boost::system::error_code const &ec)
+            {
+                if (ec != boost::asio::error::operation_aborted)
+                {
+                    self->close();
+                }
+            }));
+
+        boost::asio::async_read_until(
+            socket_,
+            request_,
+            "\r\n\r\n",
+            boost::asio::bind_executor(
+                strand_,
+                [self = shared_from_this()](
+                    boost::system::error_code const &ec, std::size_t)
+                {
+                    if (ec)
+                    {
+                        self->close();
+                    }
+                    else
+                    {
+                        self->on_request();
+                    }
+                }));
+    }
+
+private :
+    void on_request()
+    {
+        std::istream request(&request_);
+        std::string method;
+        std::string target;
+        request >> method >> target;
+
+        response_ = respond_(target);
+
+        boost::asio::async_write(
+            socket_,
+            boost::asio::buffer(response_),
+            boost::asio::bind_executor(
+                strand_,
+                [self = shared_from_this()](
+                    boost::system::error_code const &, std::size_t)
+                {
+                    self->close();
+                }));
+    }
+
+    void close()
+    {
+        boost::system::error_code ec;
+        timer_.cancel(ec);
+        socket_.shutdown(tcp::socket::shutdown_both, ec);
+        socket_.close(ec);
+    }
+
+    boost::asio::io_context::strand strand_;
+    boost::asio::steady_timer timer_;
+    tcp::socket socket_;
+    std::function<std::string (std::string const &)> respond_;
+    boost::asio::streambuf request_;
+    std::string response_;
+};
+
+// ==========================================================================
+// MAKE_RESPONSE
+// ==========================================================================
+std::string make_response(
+    char const *status,
+    std::string const &content_type,
+    std::string const &body)
+{
+    return (boost::format(
+            "HTTP/1.1 %s\r\n"
+            "Content-Type: %s\r\n"
+            "Content-Length: %u\r\n"
+            "Connection: close\r\n"
+            "\r\n")
+        % status
+        % content_type
+        % body.size()).str()
+      + body;
+}
+
+}
+
+// ==========================================================================
+// METRICS_SERVER::IMPLEMENTATION STRUCTURE
+// ==========================================================================
+struct metrics_server::impl : std::enable_shared_from_this<metrics_server::impl>
+{
+    // ======================================================================
+    // CONSTRUCTOR
+    // ======================================================================
+    impl(boost::asio::io_context &io_context, serverpp::port_identifier port)
+      : io_context_(io_context),
+        acceptor_(
+            io_context, 
+            tcp::endpoint(boost::asio::ip::address_v4::loopback(), port))
+    {
+    }
+
+    // ======================================================================
+    // ACCEPT
+    // ======================================================================
+    void accept()
+    {
+        acceptor_.async_accept(
+            [weak_this = std::weak_ptr<impl>(shared_from_this())](
+                boost::system::error_code const &ec, tcp::socket socket)
+            {
+                auto self = weak_this.lock();
+
+                if (!self || ec == boost::asio::error::operation_aborted)
+                {
+                    return;
+                }
+
+                if (!ec)
+                {
+                    std::make_shared<http_session>(
+                        self->io_context_,
+                        std::move(socket),
+                        [weak_this](std::string const &target)
+                        {
+                            auto self = weak_this.lock();
+                            return self 
+                                 ? self->respond(target) 
+                                 : make_response(
+                                       "503 Service Unavailable", "text/plain", "");
+                        })->start();
+                }
+
+                self->accept();
+            });
+    }
+
+    // ======================================================================
+    // RESPOND
+    // ======================================================================
+    std::string respond(std::string const &target)
+    {
+        auto const query_start = target.find('?');
+        auto const path = target.substr(0, query_start);
+        auto const query = query_start == std::string::npos
+          ? std::string()
+          : target.substr(query_start + 1);
+
+        page handler;
+
+        {
+            std::unique_lock<std::mutex> lock(pages_mutex_);
+            auto const it = pages_.find(path);
+
+            if (it == pages_.end())
+            {
+                return make_response("404 Not Found", "text/plain", "");
+            }
+
+            handler = it->second;
+        }
+
+        return make_response(
+            "200 OK", handler.content_type, handler.function(query));
+    }
+
+    boost::asio::io_context &io_context_;
+    tcp::acceptor acceptor_;
+
+    std::mutex pages_mutex_;
+    std::map<std::string, page> pages_;
+};
+
+// ==========================================================================
+// CONSTRUCTOR
+// ==========================================================================
+metrics_server::metrics_server(
+    boost::asio::io_context &io_context,
+    serverpp::port_identifier port)
+  : pimpl_(std::make_shared<impl>(io_context, port))
+{
+    add_page(
+        "/metrics",
+        "text/plain; version=0.0.4",
+        [](std::string const &)
+        {
+            return metrics_text();
+        });
+
+    pimpl_->accept();
+}
+
+// ==========================================================================
+// DESTRUCTOR
+// ==========================================================================
+metrics_server::~metrics_server()
+{
+    shutdown();
+}
+
+// ==========================================================================
+// ADD_PAGE
+// ==========================================================================
+void metrics_server::add_page(
+    std::string const &path,
+    std::string const &content_type,
+    page_function const &function)
+{
+    std::unique_lock<std::mutex> lock(pimpl_->pages_mutex_);
+    pimpl_->pages_[path] = page{content_type, function};
+}
+
+// ==========================================================================
+// SHUTDOWN
+// ==========================================================================
+void metrics_server::shutdown()
+{
+    boost::system::error_code ec;
+    pimpl_->acceptor_.close(ec);
+}
+
+}
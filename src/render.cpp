@@ -0,0 +1,717 @@
+#include "render.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cmath>
+#include <limits>
+#include <math.h>
+
+namespace textray {
+
+namespace {
+
+// ==========================================================================
+// FILL_ROW
+// ==========================================================================
+// Overwrites a row of the content with the brush in place, appending it
+// if the content does not reach that far.
+// ==========================================================================
+void fill_row(
+    std::vector<terminalpp::string> &content,
+    terminalpp::coordinate_type row,
+    terminalpp::coordinate_type width,
+    terminalpp::element const &brush)
+{
+    if (row >= terminalpp::coordinate_type(content.size()))
+    {
+        content.emplace_back(width, brush);
+        return;
+    }
+
+    auto &line = content[row];
+
+    if (terminalpp::coordinate_type(line.size()) != width)
+    {
+        line = terminalpp::string(width, brush);
+        return;
+    }
+
+    for (terminalpp::coordinate_type column = 0; column < width; ++column)
+    {
+        line[column] = brush;
+    }
+}
+
+}
+
+// ==========================================================================
+// COLOUR_DEPTH_OF
+// ==========================================================================
+colour_depth colour_depth_of(std::string const &terminal_type)
+{
+    std::string type;
+    type.reserve(terminal_type.size());
+
+    for (auto const ch : terminal_type)
+    {
+        type.push_back(char(std::tolower(static_cast<unsigned char>(ch))));
+    }
+
+    auto const mentions =
+        [&type](char const *text)
+        {
+            return type.find(text) != std::string::npos;
+        };
+
+    if (mentions("truecolor") || mentions("24bit") || mentions("direct"))
+    {
+        return colour_depth::true_colour;
+    }
+
+    if (mentions("256"))
+    {
+        return colour_depth::high;
+    }
+
+    return colour_depth::low;
+}
+
+// ==========================================================================
+// PALETTE_FOR
+// ==========================================================================
+palette palette_for(colour_depth depth, bool save_bandwidth)
+{
+    if (save_bandwidth)
+    {
+        return palette::saver;
+    }
+
+    // Walls need no more than the 256-colour palette, whose codes are
+    // shorter than those of 24-bit colour.
+    return depth == colour_depth::low ? palette::low : palette::high;
+}
+
+namespace {
+
+char const *const palette_names[] = { "low", "high", "saver" };
+
+}
+
+// ==========================================================================
+// PALETTE_NAME
+// ==========================================================================
+char const *palette_name(palette colours)
+{
+    return palette_names[std::size_t(colours)];
+}
+
+// ==========================================================================
+// PARSE_PALETTE
+// ==========================================================================
+bool parse_palette(std::string const &name, palette &colours)
+{
+    for (std::size_t index = 0; index < std::size_t(palette::count_); ++index)
+    {
+        if (name == palette_names[index])
+        {
+            colours = palette(index);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// ==========================================================================
+// RESIZE_CONTENT
+// ==========================================================================
+void resize_content(
+    std::vector<terminalpp::string> &content,
+    terminalpp::extent size)
+{
+    content.resize(size.height_);
+
+    for (auto &line : content)
+    {
+        if (terminalpp::coordinate_type(line.size()) != size.width_)
+        {
+            line = terminalpp::string(size.width_, terminalpp::element{' '});
+        }
+    }
+}
+
+// ==========================================================================
+// RENDER_CEILING
+// ==========================================================================
+void render_ceiling(
+    std::vector<terminalpp::string> &content,
+    terminalpp::extent size)
+{
+    using namespace terminalpp::literals;
+    static auto const ceiling_brush = "\\[7="_ets[0];
+    
+    auto const max_ceiling_row = size.height_ / 2;
+
+    for (int row = 0; row < max_ceiling_row; ++row)
+    {
+        fill_row(content, row, size.width_, ceiling_brush);
+    }
+}
+
+// ==========================================================================
+// RENDER_FLOOR
+// ==========================================================================
+void render_floor(
+    std::vector<terminalpp::string> &content,
+    terminalpp::extent size)
+{
+    using namespace terminalpp::literals;
+    static auto const floor_brush = "\\[4#"_ets[0];
+    
+    auto const min_floor_row = size.height_ / 2;
+    for (int row = min_floor_row; row < size.height_; ++row)
+    {
+        fill_row(content, row, size.width_, floor_brush);
+    }
+}
+
+namespace {
+
+constexpr double TEXTEL_ASPECT = 2.0;  // textel_height / textel_width
+constexpr double WALL_HEIGHT   = 1.0;  // height of walls, in world units
+
+// Sprites stand on the floor.  They must be at least half as tall as the
+// walls so that, seen from the same column, a nearer sprite covers every
+// row of a farther one; that is what lets render_sprites keep a single
+// depth per column.
+constexpr double SPRITE_WIDTH  = 0.5;  // width of sprites, in world units
+constexpr double SPRITE_HEIGHT = 0.75; // height of sprites, in world units
+constexpr double SPRITE_NEAR   = 0.1;  // nearest distance at which sprites are drawn
+
+// Walls are shaded in bands of distance in palettes that can show it.
+constexpr int    DISTANCE_BANDS = 4;
+constexpr double BAND_DEPTH     = 2.0;  // depth of each band, in world units
+
+// ==========================================================================
+// TILE_COLOURS
+// ==========================================================================
+// The ANSI colour that every palette draws each tile in.  Tiles 1 to 7 are
+// drawn in the colour of the same index, and higher tiles repeat those
+// seven, so that no wall is drawn in black or in an index that is not a
+// colour.
+// ==========================================================================
+struct tile_colours
+{
+    tile_colours()
+    {
+        colours[0] = terminalpp::graphics::colour::black;
+
+        for (int value = 1; value < 256; ++value)
+        {
+            colours[value] = terminalpp::graphics::colour(1 + (value - 1) % 7);
+        }
+    }
+
+    terminalpp::graphics::colour colours[256];
+};
+
+terminalpp::graphics::colour tile_colour(tile value)
+{
+    static tile_colours const table;
+    return table.colours[value];
+}
+
+// ==========================================================================
+// SHADE
+// ==========================================================================
+// Returns the 256-colour equivalent of an ANSI colour, darkened for the
+// given distance band.
+// ==========================================================================
+terminalpp::high_colour shade(terminalpp::graphics::colour colour, int band)
+{
+    // Which of red, green and blue make up each of the eight ANSI colours.
+    static constexpr std::uint8_t components[8][3] = {
+        {0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1, 1, 0},
+        {0, 0, 1}, {1, 0, 1}, {0, 1, 1}, {1, 1, 1},
+    };
+
+    auto const &base = components[int(colour)];
+    auto const intensity = std::uint8_t(5 - band);
+
+    return terminalpp::high_colour(
+        base[0] * intensity, base[1] * intensity, base[2] * intensity);
+}
+
+// ==========================================================================
+// MAKE_WALL_BRUSH
+// ==========================================================================
+// side is 0 for walls that face along the x axis and 1 for the y axis.
+// ==========================================================================
+terminalpp::element make_wall_brush(
+    palette colours, tile value, int side, int band)
+{
+    terminalpp::element brush(colours == palette::saver && side == 0 ? 'O' : 'o');
+
+    if (colours == palette::high)
+    {
+        brush.attribute_.foreground_colour_ = shade(tile_colour(value), band);
+    }
+    else
+    {
+        brush.attribute_.foreground_colour_ = tile_colour(value);
+    }
+
+    if (side == 0 && colours != palette::saver)
+    {
+        brush.attribute_.polarity_ = terminalpp::graphics::polarity::negative;
+    }
+
+    return brush;
+}
+
+// ==========================================================================
+// WALL_BRUSHES
+// ==========================================================================
+// Every brush that each palette can draw a wall with, built once so that
+// drawing a wall column is a table lookup.
+// ==========================================================================
+struct wall_brushes
+{
+    wall_brushes()
+    {
+        for (std::size_t colours = 0; colours < std::size_t(palette::count_); ++colours)
+        {
+            for (int value = 0; value < 256; ++value)
+            {
+                for (int side = 0; side < 2; ++side)
+                {
+                    for (int band = 0; band < DISTANCE_BANDS; ++band)
+                    {
+                        brushes[colours][value][side][band] = make_wall_brush(
+                            palette(colours), tile(value), side, band);
+                    }
+                }
+            }
+        }
+    }
+
+    terminalpp::element const &get(
+        palette colours, tile value, int side, double distance) const
+    {
+        auto const band = std::min(int(distance / BAND_DEPTH), DISTANCE_BANDS - 1);
+        return brushes[std::size_t(colours)][value][side][band];
+    }
+
+    terminalpp::element brushes
+        [std::size_t(palette::count_)][256][2][DISTANCE_BANDS];
+};
+
+wall_brushes const &all_wall_brushes()
+{
+    static wall_brushes const brushes;
+    return brushes;
+}
+
+// ==========================================================================
+// COLUMN_RAY
+// ==========================================================================
+// Returns the (normalized) direction of the ray cast through a column of
+// the view.
+// ==========================================================================
+vector2d column_ray(
+    vector2d const &dir,
+    vector2d const &right,
+    double tanHalfFov,
+    int x,
+    int view_width)
+{
+    double camerax = 2 * (x + 0.5) / view_width - 1; // x-coordinate in camera space (range [-1,+1])
+    return normalize(dir / tanHalfFov + right * camerax);
+}
+
+// ==========================================================================
+// RENDER_WALLS_ON
+// ==========================================================================
+// Any type with contains(x, y) and tile_at(x, y) can be rendered.
+// ==========================================================================
+template <class Plan>
+void render_walls_on(
+    std::vector<terminalpp::string> &content,
+    Plan const &plan,
+    vector2d const &position,
+    double heading,
+    double fov,
+    std::vector<double> *depth,
+    palette colours)
+{
+    // FoV has to be between 0 and 180 degrees (exclusive).
+    assert(fov > 0.0001);
+    assert(fov < M_PI - 0.0001);
+    
+    const auto view_height = int(content.size());
+    if (view_height == 0)
+    {
+        return;
+    }
+    
+    const auto view_width  = int(content[0].size());
+    if (view_width == 0)
+    {
+        return;
+    }
+
+    if (depth != nullptr)
+    {
+        depth->assign(view_width, std::numeric_limits<double>::infinity());
+    }
+    
+    // identify components of a unit vector in the direction of the camera
+    // heading and a plane perpendicular to it on which the textels(!) are
+    // rendered.
+    const auto dir   = vector2d::from_angle(heading);
+    const auto right = vector2d::from_angle(heading - M_PI/2);
+    
+    // Calculate the linear scale of the vertical FoV based on the viewport's aspect ratio
+    // (taking the textel aspect ratio into consideration as well).
+    const double tanHalfFov = tan(fov / 2);
+    const double fovScaleY = tanHalfFov / view_width * view_height * TEXTEL_ASPECT;
+    auto const &brushes = all_wall_brushes();
+
+    for (terminalpp::coordinate_type x = 0; x < view_width; ++x)
+    {
+        // calculate (normalized) ray direction
+        vector2d ray = column_ray(dir, right, tanHalfFov, x, view_width);
+        
+        auto mapX = int(position.x);
+        auto mapY = int(position.y);
+        
+        //length of ray from current position to next x or y-side
+        double sideDistX;
+        double sideDistY;
+  
+        //length of ray from one x or y-side to next x or y-side
+        double deltaDistX = std::abs(1 / ray.x);
+        double deltaDistY = std::abs(1 / ray.y);
+  
+        //what direction to step in x or y-direction (either +1 or -1)
+        int stepX;
+        int stepY;
+        
+        //calculate step and initial sideDist
+        if (ray.x < 0)
+        {
+            stepX = -1;
+            sideDistX = (position.x - mapX) * deltaDistX;
+        }
+        else
+        {
+            stepX = 1;
+            sideDistX = (mapX + 1.0 - position.x) * deltaDistX;
+        }
+        if (ray.y < 0)
+        {
+            stepY = -1;
+            sideDistY = (position.y - mapY) * deltaDistY;
+        }
+        else
+        {
+            stepY = 1;
+            sideDistY = (mapY + 1.0 - position.y) * deltaDistY;
+        }
+        
+        //perform DDA (Digital Differential Analysis)
+        double wallDist;
+        int side;
+        do
+        {
+            //jump to next map square, OR in x-direction, OR in y-direction
+            if (sideDistX < sideDistY)
+            {
+                wallDist = sideDistX;
+                sideDistX += deltaDistX;
+                mapX += stepX;
+                side = 0;
+            }
+            else
+            {
+                wallDist = sideDistY;
+                sideDistY += deltaDistY;
+                mapY += stepY;
+                side = 1;
+            }
+
+            // A ray that leaves the floorplan hits nothing.
+            if (!plan.contains(mapX, mapY))
+            {
+                break;
+            }
+        
+            //Check if ray has hit a wall
+        } while (plan.tile_at(mapX, mapY) == 0);
+
+        if (!plan.contains(mapX, mapY))
+        {
+            continue;
+        }
+
+        // Calculate distance projected on camera direction (direct distance along ray will give fisheye effect!)
+        const auto perpWallDist = dot(wallDist * ray, dir);
+
+        if (depth != nullptr)
+        {
+            (*depth)[x] = perpWallDist;
+        }
+
+        if (perpWallDist > 0.001)
+        {
+            // Calculate height of line to draw on screen.
+            // Correct for the textel aspect ratio to make sure the height is correct on the screen.
+            auto lineHeight = view_height * WALL_HEIGHT / perpWallDist / fovScaleY / TEXTEL_ASPECT;
+  
+            // Calculate lowest and highest textel to fill in current stripe
+            int drawStart = std::max( (int)round(view_height / 2.0 - lineHeight / 2), 0);
+            int drawEnd   = std::min( (int)round(view_height / 2.0 + lineHeight / 2), view_height);
+        
+            auto const &brush = brushes.get(
+                colours, plan.tile_at(mapX, mapY), side, perpWallDist);
+
+            for (terminalpp::coordinate_type row = drawStart; row < drawEnd; ++row)
+            {
+                content[row][x] = brush;
+            }
+        }
+    }
+}
+
+}
+
+// ==========================================================================
+// RENDER_WALLS
+// ==========================================================================
+void render_walls(
+    std::vector<terminalpp::string> &content,
+    floorplan const &plan,
+    vector2d const &position,
+    double heading,
+    double fov,
+    std::vector<double> *depth,
+    palette colours)
+{
+    render_walls_on(content, plan, position, heading, fov, depth, colours);
+}
+
+// ==========================================================================
+// RENDER_WALLS (WORLD SNAPSHOT)
+// ==========================================================================
+void render_walls(
+    std::vector<terminalpp::string> &content,
+    world_snapshot const &plan,
+    vector2d const &position,
+    double heading,
+    double fov,
+    std::vector<double> *depth,
+    palette colours)
+{
+    render_walls_on(content, plan, position, heading, fov, depth, colours);
+}
+
+// ==========================================================================
+// RENDER_WALLS (CHUNK VIEW)
+// ==========================================================================
+void render_walls(
+    std::vector<terminalpp::string> &content,
+    chunk_view const &plan,
+    vector2d const &position,
+    double heading,
+    double fov,
+    std::vector<double> *depth,
+    palette colours)
+{
+    render_walls_on(content, plan, position, heading, fov, depth, colours);
+}
+
+// ==========================================================================
+// PROJECT_SPRITES
+// ==========================================================================
+void project_sprites(
+    std::vector<entity_sighting> const &sprites,
+    vector2d const &position,
+    double heading,
+    double fov,
+    std::vector<projected_sprite> &projected)
+{
+    assert(fov > 0.0001);
+    assert(fov < M_PI - 0.0001);
+
+    const auto dir   = vector2d::from_angle(heading);
+    const auto right = vector2d::from_angle(heading - M_PI/2);
+    const double tanHalfFov = tan(fov / 2);
+
+    // Project each sprite into camera space, culling those behind the
+    // camera or wholly outside the field of view before sorting.
+    projected.clear();
+
+    for (auto const &sprite : sprites)
+    {
+        const auto relative = sprite.position - position;
+        const auto along = dot(relative, dir);
+        if (along < SPRITE_NEAR)
+        {
+            continue;
+        }
+
+        const auto column = dot(relative, right) / (along * tanHalfFov);
+        const auto half_width = (SPRITE_WIDTH / 2) / (along * tanHalfFov);
+        if (column + half_width < -1 || column - half_width > 1)
+        {
+            continue;
+        }
+
+        projected.push_back({along, column, half_width, sprite.appearance});
+    }
+
+    std::sort(
+        projected.begin(),
+        projected.end(),
+        [](projected_sprite const &lhs, projected_sprite const &rhs)
+        {
+            return lhs.depth < rhs.depth;
+        });
+}
+
+// ==========================================================================
+// DRAW_SPRITES
+// ==========================================================================
+void draw_sprites(
+    std::vector<terminalpp::string> &content,
+    std::vector<double> &depth,
+    std::vector<projected_sprite> const &projected,
+    double fov)
+{
+    const auto view_height = int(content.size());
+    const auto view_width  = int(depth.size());
+    if (view_height == 0 || view_width == 0)
+    {
+        return;
+    }
+
+    const double tanHalfFov = tan(fov / 2);
+    const double fovScaleY = tanHalfFov / view_width * view_height * TEXTEL_ASPECT;
+
+    for (auto const &sprite : projected)
+    {
+        // Columns whose centres lie within the sprite, in the same camera
+        // space as the rays cast by render_walls.
+        const auto left_edge  = (sprite.column - sprite.half_width + 1) * view_width / 2;
+        const auto right_edge = (sprite.column + sprite.half_width + 1) * view_width / 2;
+        const int drawLeft  = std::max((int)ceil(left_edge - 0.5), 0);
+        const int drawRight = std::min((int)floor(right_edge - 0.5), view_width - 1);
+
+        auto lineHeight = view_height * WALL_HEIGHT / sprite.depth / fovScaleY / TEXTEL_ASPECT;
+        const auto floor_row = view_height / 2.0 + lineHeight / 2;
+        int drawStart = std::max((int)round(floor_row - lineHeight * SPRITE_HEIGHT), 0);
+        int drawEnd   = std::min((int)round(floor_row), view_height);
+
+        terminalpp::element brush('@');
+        brush.attribute_.foreground_colour_ = tile_colour(sprite.appearance);
+
+        for (int x = drawLeft; x <= drawRight; ++x)
+        {
+            if (sprite.depth >= depth[x])
+            {
+                continue;
+            }
+
+            depth[x] = sprite.depth;
+
+            for (terminalpp::coordinate_type row = drawStart; row < drawEnd; ++row)
+            {
+                content[row][x] = brush;
+            }
+        }
+    }
+}
+
+// ==========================================================================
+// RENDER_SPRITES
+// ==========================================================================
+void render_sprites(
+    std::vector<terminalpp::string> &content,
+    std::vector<double> &depth,
+    std::vector<entity_sighting> const &sprites,
+    vector2d const &position,
+    double heading,
+    double fov,
+    std::vector<projected_sprite> &scratch)
+{
+    project_sprites(sprites, position, heading, fov, scratch);
+    draw_sprites(content, depth, scratch, fov);
+}
+
+// ==========================================================================
+// TRACE_VIEW
+// ==========================================================================
+void trace_view(
+    visibility_set &visible,
+    world_snapshot const &plan,
+    std::vector<double> const &depth,
+    vector2d const &position,
+    double heading,
+    double fov)
+{
+    const auto view_width = int(depth.size());
+    const auto dir   = vector2d::from_angle(heading);
+    const auto right = vector2d::from_angle(heading - M_PI/2);
+    const double tanHalfFov = tan(fov / 2);
+
+    // Returns where the ray through a column stopped: just inside the wall
+    // that it hit, or where it left the world.
+    auto const ray_end =
+        [&](int x)
+        {
+            const auto ray = column_ray(dir, right, tanHalfFov, x, view_width);
+            auto distance = depth[x] / dot(ray, dir) + 0.01;
+
+            if (!std::isfinite(distance))
+            {
+                distance = std::numeric_limits<double>::infinity();
+
+                if (ray.x != 0)
+                {
+                    distance = std::min(
+                        distance,
+                        ((ray.x < 0 ? 0 : plan.width()) - position.x) / ray.x);
+                }
+
+                if (ray.y != 0)
+                {
+                    distance = std::min(
+                        distance,
+                        ((ray.y < 0 ? 0 : plan.height()) - position.y) / ray.y);
+                }
+            }
+
+            return position + ray * std::max(distance, 0.0);
+        };
+
+    auto minimum = position;
+    auto maximum = position;
+
+    for (int x = 0; x < view_width; ++x)
+    {
+        const auto end = ray_end(x);
+        minimum = vector2d(std::min(minimum.x, end.x), std::min(minimum.y, end.y));
+        maximum = vector2d(std::max(maximum.x, end.x), std::max(maximum.y, end.y));
+    }
+
+    visible.reset(
+        int(floor(minimum.x)), int(floor(minimum.y)),
+        int(floor(maximum.x)), int(floor(maximum.y)));
+
+    for (int x = 0; x < view_width; ++x)
+    {
+        visible.add_segment(position, ray_end(x));
+    }
+}
+
+}
@@ -0,0 +1,219 @@
+#include "session_recording.hpp"
+#include <algorithm>
+#include <atomic>
+#include <istream>
+#include <stdexcept>
+
+namespace textray {
+
+namespace {
+
+constexpr char magic[] = { 'T', 'X', 'R', 'S' };
+constexpr char version = 1;
+
+// The largest payload that an event may have.  Data events hold a single
+// read from a socket and terminal types are a few bytes, so anything
+// larger is corrupt.
+constexpr std::uint64_t max_content_size = 1u << 20;
+
+// ==========================================================================
+// READ_VARINT
+// ==========================================================================
+std::uint64_t read_varint(std::istream &in)
+{
+    std::uint64_t value = 0;
+
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        auto const ch = in.get();
+
+        if (ch == std::char_traits<char>::eof())
+        {
+            throw std::runtime_error("session recording is truncated");
+        }
+
+        value |= std::uint64_t(ch & 0x7F) << shift;
+
+        if ((ch & 0x80) == 0)
+        {
+            return value;
+        }
+    }
+
+    throw std::runtime_error("session recording is corrupt");
+}
+
+// ==========================================================================
+// READ_CONTENT
+// ==========================================================================
+serverpp::byte_storage read_content(std::istream &in)
+{
+    auto const size = read_varint(in);
+
+    if (size > max_content_size)
+    {
+        throw std::runtime_error("session recording is corrupt");
+    }
+
+    serverpp::byte_storage content(size, 0);
+
+    if (size != 0)
+    {
+        in.read(reinterpret_cast<char *>(&content[0]), size);
+
+        if (static_cast<std::uint64_t>(in.gcount()) != size)
+        {
+            throw std::runtime_error("session recording is truncated");
+        }
+    }
+
+    return content;
+}
+
+}
+
+// ==========================================================================
+// CONSTRUCTOR
+// ==========================================================================
+session_recorder::session_recorder(std::string const &path)
+  : file_(path, std::ios::binary),
+    last_event_(std::chrono::steady_clock::now())
+{
+    if (!file_)
+    {
+        throw std::runtime_error("cannot create session recording " + path);
+    }
+
+    file_.write(magic, sizeof(magic));
+    file_.put(version);
+}
+
+// ==========================================================================
+// CREATE_IN
+// ==========================================================================
+std::shared_ptr<session_recorder> session_recorder::create_in(
+    std::string const &directory)
+{
+    static std::atomic<unsigned int> sequence{0};
+
+    auto const now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch());
+
+    return std::make_shared<session_recorder>(
+        directory 
+      + "/session-" 
+      + std::to_string(now.count())
+      + "-"
+      + std::to_string(sequence++)
+      + ".txrs");
+}
+
+// ==========================================================================
+// DATA
+// ==========================================================================
+void session_recorder::data(serverpp::bytes content)
+{
+    begin_event(session_event::kind::data);
+    write_varint(content.size());
+    file_.write(reinterpret_cast<char const *>(content.data()), content.size());
+}
+
+// ==========================================================================
+// WINDOW_SIZE
+// ==========================================================================
+void session_recorder::window_size(std::uint16_t width, std::uint16_t height)
+{
+    begin_event(session_event::kind::window_size);
+    write_varint(width);
+    write_varint(height);
+}
+
+// ==========================================================================
+// TERMINAL_TYPE
+// ==========================================================================
+void session_recorder::terminal_type(std::string const &type)
+{
+    begin_event(session_event::kind::terminal_type);
+    write_varint(type.size());
+    file_.write(type.data(), type.size());
+}
+
+// ==========================================================================
+// BEGIN_EVENT
+// ==========================================================================
+void session_recorder::begin_event(session_event::kind type)
+{
+    auto const now = std::chrono::steady_clock::now();
+    auto const delta = std::chrono::duration_cast<std::chrono::microseconds>(
+        now - last_event_);
+    last_event_ = now;
+
+    file_.put(static_cast<char>(type));
+    write_varint(delta.count());
+}
+
+// ==========================================================================
+// WRITE_VARINT
+// ==========================================================================
+void session_recorder::write_varint(std::uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        file_.put(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+
+    file_.put(static_cast<char>(value));
+}
+
+// ==========================================================================
+// READ_SESSION_RECORDING
+// ==========================================================================
+std::vector<session_event> read_session_recording(std::istream &in)
+{
+    char header[sizeof(magic) + 1] = {};
+    in.read(header, sizeof(header));
+
+    if (in.gcount() != sizeof(header)
+     || !std::equal(std::begin(magic), std::end(magic), header)
+     || header[sizeof(magic)] != version)
+    {
+        throw std::runtime_error("not a session recording");
+    }
+
+    std::vector<session_event> events;
+    std::chrono::microseconds time{0};
+
+    for (auto type = in.get(); 
+         type != std::char_traits<char>::eof(); 
+         type = in.get())
+    {
+        session_event event{};
+        event.type = static_cast<session_event::kind>(type);
+        time += std::chrono::microseconds(read_varint(in));
+        event.time = time;
+
+        switch (event.type)
+        {
+            case session_event::kind::data :
+                // Fall through
+            case session_event::kind::terminal_type :
+                event.content = read_content(in);
+                break;
+
+            case session_event::kind::window_size :
+                event.width = std::uint16_t(read_varint(in));
+                event.height = std::uint16_t(read_varint(in));
+                break;
+
+            default :
+                throw std::runtime_error("session recording is corrupt");
+        }
+
+        events.push_back(std::move(event));
+    }
+
+    return events;
+}
+
+}
@@ -0,0 +1,236 @@
+#include "simulation.hpp"
+#include "collision.hpp"
+#include "metrics.hpp"
+#include <algorithm>
+#include <math.h>
+
+namespace textray {
+
+namespace {
+
+constexpr double VELOCITY = 0.25;            // distance moved per command
+constexpr double ROTATION = 15 * M_PI / 180; // angle turned per command
+constexpr double RADIUS   = 0.2;             // how close a player gets to walls
+
+// ==========================================================================
+// MOVE_DIRECTION
+// ==========================================================================
+void move_direction(
+    world_snapshot const &plan, player_state &state, double angle)
+{
+    state.position = move_circle(
+        plan, state.position, vector2d::from_angle(angle) * VELOCITY, RADIUS);
+}
+
+// ==========================================================================
+// APPLY
+// ==========================================================================
+void apply(
+    world_snapshot const &plan, player_state &state, player_command command)
+{
+    switch (command)
+    {
+        case player_command::move_forward :
+            move_direction(plan, state, state.heading);
+            break;
+
+        case player_command::move_backward :
+            move_direction(plan, state, state.heading + M_PI);
+            break;
+
+        case player_command::move_left :
+            move_direction(plan, state, state.heading + M_PI/2);
+            break;
+
+        case player_command::move_right :
+            move_direction(plan, state, state.heading - M_PI/2);
+            break;
+
+        case player_command::rotate_left :
+            state.heading += ROTATION;
+            break;
+
+        case player_command::rotate_right :
+            state.heading -= ROTATION;
+            break;
+    }
+}
+
+}
+
+// ==========================================================================
+// PLAYER::CONSTRUCTOR
+// ==========================================================================
+player::player(
+    simulation &sim,
+    player_state initial_state,
+    std::uint8_t appearance,
+    std::function<void ()> on_update)
+  : simulation_(sim),
+    entity_(sim.world_->add_entity(
+        initial_state.position, initial_state.heading, appearance)),
+    on_update_(std::move(on_update)),
+    state_(initial_state),
+    published_(std::make_shared<player_state const>(initial_state))
+{
+    std::unique_lock<std::mutex> lock(simulation_.players_mutex_);
+    simulation_.players_.push_back(this);
+}
+
+// ==========================================================================
+// PLAYER::DESTRUCTOR
+// ==========================================================================
+player::~player()
+{
+    {
+        std::unique_lock<std::mutex> lock(simulation_.players_mutex_);
+        simulation_.players_.erase(
+            std::find(
+                simulation_.players_.begin(),
+                simulation_.players_.end(),
+                this));
+    }
+
+    // A step that began before the player was removed may still be
+    // publishing its state; wait for it to finish.
+    {
+        std::unique_lock<std::mutex> lock(simulation_.step_mutex_);
+    }
+
+    simulation_.world_->remove_entity(entity_);
+}
+
+// ==========================================================================
+// PLAYER::SUBMIT
+// ==========================================================================
+bool player::submit(player_command command)
+{
+    if (!commands_.push(command))
+    {
+        count(metric_counter::inputs_dropped);
+        return false;
+    }
+
+    return true;
+}
+
+// ==========================================================================
+// SIMULATION::CONSTRUCTOR
+// ==========================================================================
+simulation::simulation(std::shared_ptr<world> shared_world)
+  : world_(std::move(shared_world))
+{
+}
+
+// ==========================================================================
+// SIMULATION::DESTRUCTOR
+// ==========================================================================
+simulation::~simulation()
+{
+    stop();
+}
+
+// ==========================================================================
+// SIMULATION::START
+// ==========================================================================
+void simulation::start(std::chrono::nanoseconds tick)
+{
+    stop();
+
+    stopping_ = false;
+    thread_ = std::thread([this, tick]{ run(tick); });
+    running_ = true;
+}
+
+// ==========================================================================
+// SIMULATION::STOP
+// ==========================================================================
+void simulation::stop()
+{
+    if (!thread_.joinable())
+    {
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(stop_mutex_);
+        stopping_ = true;
+    }
+
+    stop_condition_.notify_all();
+    thread_.join();
+    running_ = false;
+}
+
+// ==========================================================================
+// SIMULATION::STEP
+// ==========================================================================
+void simulation::step()
+{
+    scoped_metric_timer timer(metric_histogram::tick_duration);
+    std::unique_lock<std::mutex> step_lock(step_mutex_);
+    auto const snapshot = world_->snapshot();
+
+    // The players list is locked only while commands are applied.  The
+    // world and the players' handlers are told afterwards, so that players
+    // joining or leaving do not wait on them.
+    {
+        std::unique_lock<std::mutex> lock(players_mutex_);
+
+        for (auto *current : players_)
+        {
+            bool changed = false;
+            player_command command;
+
+            while (current->commands_.pop(command))
+            {
+                apply(*snapshot, current->state_, command);
+                changed = true;
+            }
+
+            if (changed)
+            {
+                updated_.push_back(current);
+            }
+        }
+    }
+
+    for (auto *current : updated_)
+    {
+        auto const &state = current->state_;
+        world_->move_entity(current->entity_, state.position, state.heading);
+        std::atomic_store(
+            &current->published_,
+            std::make_shared<player_state const>(state));
+        current->on_update_();
+    }
+
+    updated_.clear();
+}
+
+// ==========================================================================
+// SIMULATION::RUN
+// ==========================================================================
+void simulation::run(std::chrono::nanoseconds tick)
+{
+    auto next_tick = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(stop_mutex_);
+
+    while (!stopping_)
+    {
+        lock.unlock();
+        step();
+        lock.lock();
+
+        // A tick that overran is not made up for; the simulation continues
+        // from now rather than running several ticks back to back.
+        next_tick += std::chrono::duration_cast<
+            std::chrono::steady_clock::duration>(tick);
+        next_tick = std::max(next_tick, std::chrono::steady_clock::now());
+
+        stop_condition_.wait_until(
+            lock, next_tick, [this]{ return stopping_; });
+    }
+}
+
+}
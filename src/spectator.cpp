@@ -0,0 +1,609 @@
+#include "spectator.hpp"
+#include "metrics.hpp"
+#include "ui.hpp"
+#include <terminalpp/canvas.hpp>
+#include <terminalpp/terminal.hpp>
+#include <munin/window.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/make_unique.hpp>
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <vector>
+
+namespace textray {
+
+namespace {
+
+// ==========================================================================
+// ENCODER
+// ==========================================================================
+// Renders and encodes a stream of frames for one size and profile of
+// terminal and palette.  Each frame is encoded as the changes since the one
+// before; a new encoder encodes its first frame in full.
+// ==========================================================================
+struct encoder
+{
+    encoder(
+        std::shared_ptr<world> const &shared_world,
+        entity_id subject,
+        vector2d position,
+        double heading,
+        double fov,
+        terminalpp::extent size,
+        terminal_profile const &profile,
+        palette colours)
+      : view(std::make_shared<ui>(
+            shared_world, subject, position, heading, fov)),
+        window(view),
+        terminal(terminal_behaviour(profile)),
+        canvas(size)
+    {
+        terminal.set_size(size);
+        view->set_camera_palette(colours);
+    }
+
+    std::shared_ptr<ui> view;
+    munin::window window;
+    terminalpp::terminal terminal;
+    terminalpp::canvas canvas;
+};
+
+// ==========================================================================
+// COHORT
+// ==========================================================================
+// Spectators watching from one size and profile of terminal with one
+// palette who receive the same stream of frames.
+// \par
+// A stream's frames only make sense to those who have seen every frame
+// since its first, so newcomers are not added to a stream that has
+// started.  They form a cohort of their own, whose first frame is encoded
+// in full for them alone.  To keep the number of streams small, a cohort
+// that has grown as large as the one that started before it is merged
+// into it, and the merged cohort starts a new stream.  Every merge at
+// least doubles the size of the cohort that a spectator belongs to, so
+// each spectator receives a full frame only a logarithmic number of times
+// however many others join.
+// ==========================================================================
+struct cohort
+{
+    cohort(
+        terminalpp::extent size,
+        terminal_profile const &profile,
+        palette colours)
+      : size(size),
+        profile(&profile),
+        colours(colours)
+    {
+    }
+
+    bool same_view(
+        terminalpp::extent other_size,
+        terminal_profile const &other_profile,
+        palette other_colours) const
+    {
+        return size == other_size
+            && profile == &other_profile
+            && colours == other_colours;
+    }
+
+    terminalpp::extent size;
+
+    // Profiles are shared by every client of the same terminal type, so
+    // they are told apart by address.
+    terminal_profile const *profile;
+    palette colours;
+
+    // Guarded by the feed's mutex.
+    std::vector<spectator *> members;
+    bool started = false;
+
+    // Used only on the feed's strand.
+    std::unique_ptr<encoder> frames;
+    spectator_frame frame;
+};
+
+}
+
+// ==========================================================================
+// SPECTATOR_FEED::IMPLEMENTATION STRUCTURE
+// ==========================================================================
+struct spectator_feed::impl : std::enable_shared_from_this<impl>
+{
+    // ======================================================================
+    // CONSTRUCTOR
+    // ======================================================================
+    impl(
+        boost::asio::io_context &io_context,
+        std::shared_ptr<world> shared_world,
+        entity_id subject,
+        vector2d position,
+        double heading,
+        double fov)
+      : strand_(io_context),
+        world_(std::move(shared_world)),
+        subject_(subject),
+        position_(position),
+        heading_(heading),
+        fov_(fov)
+    {
+    }
+
+    // ======================================================================
+    // UPDATE
+    // ======================================================================
+    // Changes the view under the lock and, if anyone is watching, schedules
+    // a frame.  Changes made before the frame is rendered are folded into
+    // it.
+    // ======================================================================
+    template <class Change>
+    void update(Change &&change)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            change();
+
+            if (cohorts_.empty())
+            {
+                return;
+            }
+        }
+
+        schedule_render();
+    }
+
+    // ======================================================================
+    // SCHEDULE_RENDER
+    // ======================================================================
+    void schedule_render()
+    {
+        if (!render_requested_.exchange(true))
+        {
+            auto self = shared_from_this();
+            strand_.post([self]{ self->render(); });
+        }
+    }
+
+    // ======================================================================
+    // JOIN
+    // ======================================================================
+    void join(spectator *member)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+
+            // Newcomers join the youngest cohort for their view if its
+            // stream has not yet started, and otherwise start a cohort.
+            auto const youngest = std::find_if(
+                cohorts_.rbegin(),
+                cohorts_.rend(),
+                [member](std::shared_ptr<cohort> const &candidate)
+                {
+                    return candidate->same_view(
+                        member->size_, member->profile_, member->colours_);
+                });
+
+            if (youngest != cohorts_.rend() && !(*youngest)->started)
+            {
+                (*youngest)->members.push_back(member);
+            }
+            else
+            {
+                cohorts_.push_back(std::make_shared<cohort>(
+                    member->size_, member->profile_, member->colours_));
+                cohorts_.back()->members.push_back(member);
+            }
+        }
+
+        schedule_render();
+    }
+
+    // ======================================================================
+    // LEAVE
+    // ======================================================================
+    void leave(spectator *member)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        for (auto current = cohorts_.begin();
+             current != cohorts_.end();
+             ++current)
+        {
+            auto &members = (*current)->members;
+            auto const found = std::find(members.begin(), members.end(), member);
+
+            if (found != members.end())
+            {
+                members.erase(found);
+
+                if (members.empty())
+                {
+                    cohorts_.erase(current);
+                }
+
+                return;
+            }
+        }
+    }
+
+    // ======================================================================
+    // CLOSE
+    // ======================================================================
+    // Stops the feed and tells those watching.  Frames already scheduled
+    // are not rendered.
+    // ======================================================================
+    void close()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        closed_ = true;
+
+        for (auto const &current : cohorts_)
+        {
+            for (auto *member : current->members)
+            {
+                member->on_closed_();
+            }
+        }
+    }
+
+    // ======================================================================
+    // MERGE_COHORTS
+    // ======================================================================
+    // Merges each cohort that has grown as large as the one before it with
+    // the same view into that one.  Called on the strand with the lock
+    // held, since it restarts the merged cohort's stream.
+    // ======================================================================
+    void merge_cohorts()
+    {
+        for (std::size_t younger = cohorts_.size(); younger-- > 1;)
+        {
+            auto &young = *cohorts_[younger];
+
+            auto const older = std::find_if(
+                cohorts_.rbegin() + (cohorts_.size() - younger),
+                cohorts_.rend(),
+                [&young](std::shared_ptr<cohort> const &candidate)
+                {
+                    return candidate->same_view(
+                        young.size, *young.profile, young.colours);
+                });
+
+            if (older == cohorts_.rend()
+             || young.members.size() < (*older)->members.size())
+            {
+                continue;
+            }
+
+            auto &old = **older;
+            old.members.insert(
+                old.members.end(), young.members.begin(), young.members.end());
+            old.started = false;
+            old.frames.reset();
+
+            cohorts_.erase(cohorts_.begin() + younger);
+        }
+    }
+
+    // ======================================================================
+    // RENDER
+    // ======================================================================
+    // Renders and encodes a frame of each cohort's stream and hands it to
+    // everyone in that cohort.  Called on the strand.
+    // \par
+    // The lock is held only to take the view and the list of cohorts and
+    // then to hand out the frames, so that the subject's client, which
+    // moves the view, never waits for a frame to be encoded.
+    // ======================================================================
+    void render()
+    {
+        render_requested_ = false;
+
+        vector2d position;
+        double heading;
+        double fov;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+
+            if (closed_)
+            {
+                return;
+            }
+
+            merge_cohorts();
+            position = position_;
+            heading = heading_;
+            fov = fov_;
+            rendering_.assign(cohorts_.begin(), cohorts_.end());
+        }
+
+        for (auto &current : rendering_)
+        {
+            encode(*current, position, heading, fov);
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+
+            for (auto &current : rendering_)
+            {
+                // The feed may have closed while the frames were encoded.
+                if (closed_ || !current->frame)
+                {
+                    continue;
+                }
+
+                // Anyone who joined since the frame was encoded receives
+                // it too, which is only allowed while it is the first
+                // of the stream.
+                current->started = true;
+
+                count(metric_counter::spectator_frames_encoded);
+                count(
+                    metric_counter::spectator_frames_sent,
+                    current->members.size());
+
+                for (auto *member : current->members)
+                {
+                    member->on_frame_(current->frame);
+                }
+
+                current->frame.reset();
+            }
+        }
+
+        // Cohorts that have since emptied are released here.
+        rendering_.clear();
+    }
+
+    // ======================================================================
+    // ENCODE
+    // ======================================================================
+    // Encodes the next frame of a cohort's stream into its frame, which is
+    // left null if nothing changed.  Called on the strand.
+    // ======================================================================
+    void encode(
+        cohort &current, vector2d position, double heading, double fov)
+    {
+        if (!current.frames)
+        {
+            current.frames = boost::make_unique<encoder>(
+                world_, subject_, position, heading, fov,
+                current.size, *current.profile, current.colours);
+        }
+        else
+        {
+            current.frames->view->move_camera_to(position, heading);
+            current.frames->view->set_camera_fov(fov);
+        }
+
+        // Frames for terminals that support synchronized output are
+        // bracketed here, once for the whole cohort, so that the frame can
+        // be written to each of them unchanged.
+        auto const synchronized = current.profile->synchronized_output;
+        auto bytes = std::make_shared<serverpp::byte_storage>();
+
+        if (synchronized)
+        {
+            bytes->insert(
+                bytes->end(),
+                std::begin(begin_synchronized_update),
+                std::end(begin_synchronized_update));
+        }
+
+        auto const header_size = bytes->size();
+
+        current.frames->window.repaint(
+            current.frames->canvas,
+            current.frames->terminal,
+            [&bytes](terminalpp::bytes data)
+            {
+                bytes->insert(bytes->end(), data.begin(), data.end());
+            });
+
+        if (bytes->size() == header_size)
+        {
+            return;
+        }
+
+        if (synchronized)
+        {
+            bytes->insert(
+                bytes->end(),
+                std::begin(end_synchronized_update),
+                std::end(end_synchronized_update));
+        }
+
+        current.frame = std::move(bytes);
+    }
+
+    boost::asio::io_context::strand strand_;
+    std::shared_ptr<world> world_;
+    entity_id subject_;
+    std::atomic<bool> render_requested_{false};
+
+    std::mutex mutex_;
+    vector2d position_;
+    double heading_;
+    double fov_;
+    std::vector<std::shared_ptr<cohort>> cohorts_;
+    bool closed_ = false;
+
+    // The cohorts being rendered, kept between frames so that taking them
+    // does not allocate.  Used only on the strand.
+    std::vector<std::shared_ptr<cohort>> rendering_;
+};
+
+// ==========================================================================
+// SPECTATOR_FEED::CONSTRUCTOR
+// ==========================================================================
+spectator_feed::spectator_feed(
+    boost::asio::io_context &io_context,
+    std::shared_ptr<world> shared_world,
+    entity_id subject,
+    vector2d position,
+    double heading,
+    double fov)
+  : pimpl_(std::make_shared<impl>(
+        io_context,
+        std::move(shared_world),
+        subject,
+        position,
+        heading,
+        fov))
+{
+}
+
+// ==========================================================================
+// SPECTATOR_FEED::DESTRUCTOR
+// ==========================================================================
+spectator_feed::~spectator_feed()
+{
+    // Spectators share ownership of the implementation, so it outlives
+    // the feed until they have moved on.
+    pimpl_->close();
+}
+
+// ==========================================================================
+// SPECTATOR_FEED::SUBJECT
+// ==========================================================================
+entity_id spectator_feed::subject() const
+{
+    return pimpl_->subject_;
+}
+
+// ==========================================================================
+// SPECTATOR_FEED::MOVE_TO
+// ==========================================================================
+void spectator_feed::move_to(vector2d position, double heading)
+{
+    pimpl_->update(
+        [this, position, heading]
+        {
+            pimpl_->position_ = position;
+            pimpl_->heading_ = heading;
+        });
+}
+
+// ==========================================================================
+// SPECTATOR_FEED::SET_FOV
+// ==========================================================================
+void spectator_feed::set_fov(double fov)
+{
+    pimpl_->update(
+        [this, fov]
+        {
+            pimpl_->fov_ = fov;
+        });
+}
+
+// ==========================================================================
+// SPECTATOR_FEED::REDRAW
+// ==========================================================================
+void spectator_feed::redraw()
+{
+    pimpl_->update([]{});
+}
+
+// ==========================================================================
+// SPECTATOR::CONSTRUCTOR
+// ==========================================================================
+spectator::spectator(
+    spectator_feed const &feed,
+    terminalpp::extent size,
+    terminal_profile const &profile,
+    palette colours,
+    std::function<void (spectator_frame const &)> on_frame,
+    std::function<void ()> on_closed)
+  : feed_(feed.pimpl_),
+    size_(size),
+    profile_(profile),
+    colours_(colours),
+    on_frame_(std::move(on_frame)),
+    on_closed_(std::move(on_closed))
+{
+    feed_->join(this);
+}
+
+// ==========================================================================
+// SPECTATOR::DESTRUCTOR
+// ==========================================================================
+spectator::~spectator()
+{
+    feed_->leave(this);
+}
+
+// ==========================================================================
+// SPECTATOR::RESIZE
+// ==========================================================================
+void spectator::resize(terminalpp::extent size)
+{
+    feed_->leave(this);
+    size_ = size;
+    feed_->join(this);
+}
+
+// ==========================================================================
+// SPECTATOR::SET_PALETTE
+// ==========================================================================
+void spectator::set_palette(palette colours)
+{
+    feed_->leave(this);
+    colours_ = colours;
+    feed_->join(this);
+}
+
+// ==========================================================================
+// SPECTATOR_DIRECTORY::OPEN
+// ==========================================================================
+std::shared_ptr<spectator_feed> spectator_directory::open(
+    boost::asio::io_context &io_context,
+    std::shared_ptr<world> shared_world,
+    entity_id subject,
+    vector2d position,
+    double heading,
+    double fov)
+{
+    auto feed = std::make_shared<spectator_feed>(
+        io_context, std::move(shared_world), subject, position, heading, fov);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    feeds_[subject] = feed;
+    return feed;
+}
+
+// ==========================================================================
+// SPECTATOR_DIRECTORY::NEXT
+// ==========================================================================
+std::shared_ptr<spectator_feed> spectator_directory::next(
+    entity_id viewer, entity_id after)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    auto current = after == no_entity
+      ? feeds_.begin()
+      : feeds_.upper_bound(after);
+
+    while (current != feeds_.end())
+    {
+        auto feed = current->second.lock();
+
+        // Feeds of players that have left are forgotten as they are found.
+        if (!feed)
+        {
+            current = feeds_.erase(current);
+            continue;
+        }
+
+        if (current->first != viewer)
+        {
+            return feed;
+        }
+
+        ++current;
+    }
+
+    return {};
+}
+
+}
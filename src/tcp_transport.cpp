@@ -0,0 +1,46 @@
+#include "tcp_transport.hpp"
+
+namespace textray {
+
+// ==========================================================================
+// CONSTRUCTOR
+// ==========================================================================
+tcp_transport::tcp_transport(serverpp::tcp_socket &&socket)
+  : socket_(std::move(socket))
+{
+}
+
+// ==========================================================================
+// IS_ALIVE
+// ==========================================================================
+bool tcp_transport::is_alive() const
+{
+    return socket_.is_alive();
+}
+
+// ==========================================================================
+// CLOSE
+// ==========================================================================
+void tcp_transport::close()
+{
+    socket_.close();
+}
+
+// ==========================================================================
+// ASYNC_READ
+// ==========================================================================
+void tcp_transport::async_read(
+    std::function<void (serverpp::bytes)> const &continuation)
+{
+    socket_.async_read(continuation);
+}
+
+// ==========================================================================
+// WRITE
+// ==========================================================================
+void tcp_transport::write(serverpp::bytes data)
+{
+    socket_.write(data);
+}
+
+}
@@ -0,0 +1,135 @@
+#include "terminal_profile.hpp"
+#include <algorithm>
+#include <cctype>
+#include <mutex>
+#include <unordered_map>
+
+namespace textray {
+
+namespace {
+
+// Terminal types are chosen by clients, so the number kept is limited.
+// Beyond it, types that have not been seen before are given the profile of
+// an unknown terminal.
+constexpr std::size_t max_profiles = 256;
+
+// ==========================================================================
+// FAMILY
+// ==========================================================================
+// What the terminals whose type contains a given name support.
+// ==========================================================================
+struct family
+{
+    char const *name;
+    colour_depth colours;
+    bool mouse;
+    bool synchronized_output;
+    bool window_title;
+};
+
+// The first family whose name appears in the type applies, so emulators
+// that call themselves "xterm-something" come before xterm itself.
+family const families[] = {
+    // name         colours                    mouse  2026   title
+    { "kitty",      colour_depth::true_colour, true,  true,  true  },
+    { "alacritty",  colour_depth::true_colour, true,  true,  true  },
+    { "foot",       colour_depth::true_colour, true,  true,  true  },
+    { "wezterm",    colour_depth::true_colour, true,  true,  true  },
+    { "contour",    colour_depth::true_colour, true,  true,  true  },
+    { "tmux",       colour_depth::low,         true,  false, true  },
+    { "screen",     colour_depth::low,         true,  false, true  },
+    { "rxvt",       colour_depth::low,         true,  false, true  },
+    { "xterm",      colour_depth::low,         true,  false, true  },
+    { "linux",      colour_depth::low,         false, false, false },
+    { "vt220",      colour_depth::low,         false, false, false },
+};
+
+// ==========================================================================
+// MAKE_PROFILE
+// ==========================================================================
+terminal_profile make_profile(std::string const &type)
+{
+    terminal_profile profile;
+    profile.type = type;
+    profile.colours = colour_depth_of(type);
+
+    auto const known = std::find_if(
+        std::begin(families),
+        std::end(families),
+        [&type](family const &candidate)
+        {
+            return type.find(candidate.name) != std::string::npos;
+        });
+
+    if (known != std::end(families))
+    {
+        profile.colours = std::max(profile.colours, known->colours);
+        profile.mouse = known->mouse;
+        profile.synchronized_output = known->synchronized_output;
+        profile.window_title = known->window_title;
+    }
+
+    return profile;
+}
+
+}
+
+serverpp::byte const begin_synchronized_update[8] = {
+    0x1B, '[', '?', '2', '0', '2', '6', 'h'
+};
+
+serverpp::byte const end_synchronized_update[8] = {
+    0x1B, '[', '?', '2', '0', '2', '6', 'l'
+};
+
+// ==========================================================================
+// TERMINAL_PROFILE_FOR
+// ==========================================================================
+terminal_profile const &terminal_profile_for(std::string const &type)
+{
+    // Profiles are never removed, and the map's nodes do not move, so
+    // references to them stay valid after the lock is released.
+    static std::mutex mutex;
+    static std::unordered_map<std::string, terminal_profile> profiles;
+
+    std::string key;
+    key.reserve(type.size());
+
+    for (auto const ch : type)
+    {
+        key.push_back(char(std::tolower(static_cast<unsigned char>(ch))));
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    auto profile = profiles.find(key);
+
+    if (profile == profiles.end())
+    {
+        if (profiles.size() >= max_profiles)
+        {
+            key.clear();
+            profile = profiles.find(key);
+        }
+
+        if (profile == profiles.end())
+        {
+            profile = profiles.emplace(key, make_profile(key)).first;
+        }
+    }
+
+    return profile->second;
+}
+
+// ==========================================================================
+// TERMINAL_BEHAVIOUR
+// ==========================================================================
+terminalpp::behaviour terminal_behaviour(terminal_profile const &profile)
+{
+    terminalpp::behaviour behaviour;
+    behaviour.supports_basic_mouse_tracking = profile.mouse;
+    behaviour.supports_window_title_bel = profile.window_title;
+
+    return behaviour;
+}
+
+}
@@ -0,0 +1,228 @@
+#include "tracing.hpp"
+#include <boost/format.hpp>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace textray {
+
+namespace {
+
+constexpr std::size_t ring_size = 4096;
+
+char const *const stage_names[] = {
+    "read",
+    "keypress",
+    "camera_update",
+    "repaint",
+    "render",
+    "encode",
+    "compress",
+    "write"
+};
+
+// ==========================================================================
+// TRACE_RING
+// ==========================================================================
+// The most recent spans recorded by a single thread.  Slots are atomic so
+// that they can be exported while the thread overwrites them; a span read
+// during an overwrite may be inconsistent, but never undefined.
+// ==========================================================================
+struct trace_ring
+{
+    struct slot
+    {
+        std::atomic<trace_id> id;
+        std::atomic<std::uint8_t> stage;
+        std::atomic<std::int64_t> start_ns;
+        std::atomic<std::int64_t> end_ns;
+    };
+
+    std::array<slot, ring_size> slots;
+    std::atomic<std::uint64_t> next;
+    unsigned int thread_index;
+};
+
+std::atomic<unsigned int> sampling{0};
+std::atomic<trace_id> next_trace_id{1};
+
+std::chrono::steady_clock::time_point const epoch = 
+    std::chrono::steady_clock::now();
+
+std::mutex rings_mutex;
+std::vector<std::unique_ptr<trace_ring>> rings;
+
+thread_local trace_id current = 0;
+thread_local unsigned int events_since_sample = 0;
+
+// ==========================================================================
+// LOCAL_RING
+// ==========================================================================
+trace_ring &local_ring()
+{
+    thread_local trace_ring *ring = []
+    {
+        auto new_ring = std::unique_ptr<trace_ring>(new trace_ring{});
+        auto *result = new_ring.get();
+
+        std::unique_lock<std::mutex> lock(rings_mutex);
+        result->thread_index = static_cast<unsigned int>(rings.size());
+        rings.push_back(std::move(new_ring));
+
+        return result;
+    }();
+
+    return *ring;
+}
+
+// ==========================================================================
+// SINCE_EPOCH
+// ==========================================================================
+std::int64_t since_epoch(std::chrono::steady_clock::time_point time)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        time - epoch).count();
+}
+
+}
+
+// ==========================================================================
+// SET_TRACE_SAMPLING
+// ==========================================================================
+void set_trace_sampling(unsigned int one_in_n)
+{
+    sampling.store(one_in_n, std::memory_order_relaxed);
+}
+
+// ==========================================================================
+// BEGIN_TRACE
+// ==========================================================================
+trace_id begin_trace()
+{
+    auto const one_in_n = sampling.load(std::memory_order_relaxed);
+
+    if (one_in_n == 0 || ++events_since_sample < one_in_n)
+    {
+        return 0;
+    }
+
+    events_since_sample = 0;
+    return next_trace_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+// ==========================================================================
+// CURRENT_TRACE
+// ==========================================================================
+trace_id current_trace()
+{
+    return current;
+}
+
+// ==========================================================================
+// TRACE_SCOPE CONSTRUCTOR
+// ==========================================================================
+trace_scope::trace_scope(trace_id id)
+  : previous_(current)
+{
+    current = id;
+}
+
+// ==========================================================================
+// TRACE_SCOPE DESTRUCTOR
+// ==========================================================================
+trace_scope::~trace_scope()
+{
+    current = previous_;
+}
+
+// ==========================================================================
+// TRACE_SPAN CONSTRUCTOR
+// ==========================================================================
+trace_span::trace_span(trace_id id, trace_stage stage)
+  : id_(id),
+    stage_(stage)
+{
+    if (id_ != 0)
+    {
+        start_ = std::chrono::steady_clock::now();
+    }
+}
+
+// ==========================================================================
+// TRACE_SPAN CONSTRUCTOR
+// ==========================================================================
+trace_span::trace_span(trace_stage stage)
+  : trace_span(current, stage)
+{
+}
+
+// ==========================================================================
+// TRACE_SPAN DESTRUCTOR
+// ==========================================================================
+trace_span::~trace_span()
+{
+    if (id_ == 0)
+    {
+        return;
+    }
+
+    auto const end = std::chrono::steady_clock::now();
+    auto &ring = local_ring();
+    auto const index = ring.next.load(std::memory_order_relaxed);
+    auto &slot = ring.slots[index % ring_size];
+
+    slot.id.store(id_, std::memory_order_relaxed);
+    slot.stage.store(std::uint8_t(stage_), std::memory_order_relaxed);
+    slot.start_ns.store(since_epoch(start_), std::memory_order_relaxed);
+    slot.end_ns.store(since_epoch(end), std::memory_order_relaxed);
+    ring.next.store(index + 1, std::memory_order_release);
+}
+
+// ==========================================================================
+// TRACE_JSON
+// ==========================================================================
+std::string trace_json()
+{
+    std::unique_lock<std::mutex> lock(rings_mutex);
+    std::string json = "{\"traceEvents\":[";
+    bool first = true;
+
+    for (auto const &ring : rings)
+    {
+        auto const next = ring->next.load(std::memory_order_acquire);
+        auto const count = std::min<std::uint64_t>(next, ring_size);
+
+        for (auto index = next - count; index != next; ++index)
+        {
+            auto const &slot = ring->slots[index % ring_size];
+            auto const stage = slot.stage.load(std::memory_order_relaxed);
+            auto const start_ns = slot.start_ns.load(std::memory_order_relaxed);
+            auto const end_ns = slot.end_ns.load(std::memory_order_relaxed);
+
+            if (stage >= sizeof(stage_names) / sizeof(stage_names[0]))
+            {
+                continue;
+            }
+
+            json += (boost::format(
+                    "%s{\"name\":\"%s\",\"cat\":\"textray\",\"ph\":\"X\","
+                    "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,"
+                    "\"args\":{\"trace\":%u}}")
+                % (first ? "" : ",")
+                % stage_names[stage]
+                % (start_ns / 1000.0)
+                % ((end_ns - start_ns) / 1000.0)
+                % ring->thread_index
+                % slot.id.load(std::memory_order_relaxed)).str();
+
+            first = false;
+        }
+    }
+
+    json += "]}";
+    return json;
+}
+
+}
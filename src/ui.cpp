@@ -9,21 +9,32 @@ namespace textray {
  
 struct ui::impl
 {
-    impl(std::shared_ptr<floorplan> plan, vector2d position, double heading, double fov)
-      : camera_(std::make_shared<camera>(plan, position, heading, fov))
+    impl(
+        std::shared_ptr<world> shared_world,
+        entity_id viewer,
+        vector2d position,
+        double heading,
+        double fov)
+      : camera_(std::make_shared<camera>(
+            shared_world, viewer, position, heading, fov))
     {
     }
     
     std::shared_ptr<camera> camera_;
 };
 
-ui::ui(std::shared_ptr<floorplan> plan, vector2d position, double heading, double fov)
-  : pimpl_(new impl(plan, position, heading, fov))
+ui::ui(
+    std::shared_ptr<world> shared_world,
+    entity_id viewer,
+    vector2d position,
+    double heading,
+    double fov)
+  : pimpl_(new impl(shared_world, viewer, position, heading, fov))
 {
     using namespace terminalpp::literals;
     auto const status_text = std::vector<terminalpp::string> {
         "\\<340\\>002Movement: asdw.  Rotation: qe"_ets,
-        "\\<340\\>002Zoom: zx. Reset zoom: c"_ets
+        "\\<340\\>002Zoom: zx. Reset zoom: c. Watch players: v. Save bandwidth: b"_ets
     };
     
     auto const fill = "\\>002 "_ets[0];
@@ -61,4 +72,32 @@ void ui::set_camera_fov(double fov)
     pimpl_->camera_->set_fov(fov);
 }
 
+void ui::set_camera_palette(palette colours)
+{
+    pimpl_->camera_->set_palette(colours);
+}
+
+void ui::redraw_camera()
+{
+    pimpl_->camera_->redraw();
+}
+
+void ui::redraw()
+{
+    on_redraw({
+        terminalpp::rectangle({}, get_size())
+    });
+}
+
+std::uint64_t ui::prepare_frame()
+{
+    // Everything else on the screen is fixed for a given size.
+    return pimpl_->camera_->prepare_frame();
+}
+
+visibility_set const &ui::camera_visibility() const
+{
+    return pimpl_->camera_->visibility();
+}
+
 }
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include "visibility_set.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+namespace textray {
+
+constexpr int visibility_set::cell_bits;
+
+namespace {
+
+constexpr double cell_size = 1 << visibility_set::cell_bits;
+
+}
+
+// ==========================================================================
+// RESET
+// ==========================================================================
+void visibility_set::reset(int min_x, int min_y, int max_x, int max_y)
+{
+    origin_x_ = cell_of(min_x);
+    origin_y_ = cell_of(min_y);
+    width_ = cell_of(max_x) - origin_x_ + 1;
+    height_ = cell_of(max_y) - origin_y_ + 1;
+
+    bits_.assign((std::size_t(width_) * height_ + 63) / 64, 0);
+}
+
+// ==========================================================================
+// ADD_SEGMENT
+// ==========================================================================
+void visibility_set::add_segment(vector2d from, vector2d to)
+{
+    // Walk the cells crossed by the segment, stepping into whichever
+    // neighbouring cell the line reaches first.  The number of steps is
+    // fixed up front so that rounding cannot make the walk overshoot.
+    auto const from_x = from.x / cell_size;
+    auto const from_y = from.y / cell_size;
+    auto const delta_x = to.x / cell_size - from_x;
+    auto const delta_y = to.y / cell_size - from_y;
+
+    auto cell_x = cell_of(from.x);
+    auto cell_y = cell_of(from.y);
+    auto const step_x = delta_x < 0 ? -1 : 1;
+    auto const step_y = delta_y < 0 ? -1 : 1;
+
+    constexpr auto infinity = std::numeric_limits<double>::infinity();
+    auto const next_x = delta_x == 0
+      ? infinity
+      : (step_x > 0 ? cell_x + 1 - from_x : from_x - cell_x) / std::abs(delta_x);
+    auto const next_y = delta_y == 0
+      ? infinity
+      : (step_y > 0 ? cell_y + 1 - from_y : from_y - cell_y) / std::abs(delta_y);
+    auto const stride_x = delta_x == 0 ? infinity : 1 / std::abs(delta_x);
+    auto const stride_y = delta_y == 0 ? infinity : 1 / std::abs(delta_y);
+
+    auto crossing_x = next_x;
+    auto crossing_y = next_y;
+
+    add_cell(cell_x, cell_y);
+
+    for (auto steps = std::abs(cell_of(to.x) - cell_x) + std::abs(cell_of(to.y) - cell_y);
+         steps > 0;
+         --steps)
+    {
+        if (crossing_x < crossing_y)
+        {
+            cell_x += step_x;
+            crossing_x += stride_x;
+        }
+        else
+        {
+            cell_y += step_y;
+            crossing_y += stride_y;
+        }
+
+        add_cell(cell_x, cell_y);
+    }
+}
+
+// ==========================================================================
+// CONTAINS
+// ==========================================================================
+bool visibility_set::contains(int x, int y) const
+{
+    return contains_cell(x >> cell_bits, y >> cell_bits);
+}
+
+// ==========================================================================
+// INTERSECTS
+// ==========================================================================
+bool visibility_set::intersects(vector2d minimum, vector2d maximum) const
+{
+    auto const last_x = cell_of(maximum.x);
+    auto const last_y = cell_of(maximum.y);
+
+    for (auto cell_y = cell_of(minimum.y); cell_y <= last_y; ++cell_y)
+    {
+        for (auto cell_x = cell_of(minimum.x); cell_x <= last_x; ++cell_x)
+        {
+            if (contains_cell(cell_x, cell_y))
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+// ==========================================================================
+// CELL_OF
+// ==========================================================================
+int visibility_set::cell_of(double coordinate)
+{
+    return int(std::floor(coordinate / cell_size));
+}
+
+// ==========================================================================
+// ADD_CELL
+// ==========================================================================
+void visibility_set::add_cell(int cell_x, int cell_y)
+{
+    auto const column = cell_x - origin_x_;
+    auto const row = cell_y - origin_y_;
+
+    if (column >= 0 && row >= 0 && column < width_ && row < height_)
+    {
+        auto const bit = std::size_t(row) * width_ + column;
+        bits_[bit / 64] |= std::uint64_t(1) << (bit % 64);
+    }
+}
+
+// ==========================================================================
+// CONTAINS_CELL
+// ==========================================================================
+bool visibility_set::contains_cell(int cell_x, int cell_y) const
+{
+    auto const column = cell_x - origin_x_;
+    auto const row = cell_y - origin_y_;
+
+    if (column < 0 || row < 0 || column >= width_ || row >= height_)
+    {
+        return false;
+    }
+
+    auto const bit = std::size_t(row) * width_ + column;
+    return (bits_[bit / 64] >> (bit % 64)) & 1;
+}
+
+}
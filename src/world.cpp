@@ -0,0 +1,509 @@
+#include "world.hpp"
+#include "map_generator.hpp"
+#include <algorithm>
+#include <cassert>
+
+namespace textray {
+
+namespace {
+
+// ==========================================================================
+// OPEN_SPAWN_POINT
+// ==========================================================================
+// The middle of the open tile nearest the centre of the snapshot.
+// ==========================================================================
+vector2d open_spawn_point(world_snapshot const &snapshot)
+{
+    int x = 0;
+    int y = 0;
+    find_open_tile(snapshot, x, y);
+    return {x + 0.5, y + 0.5};
+}
+
+// ==========================================================================
+// CELL_KEY
+// ==========================================================================
+std::uint64_t cell_key(int cell_x, int cell_y)
+{
+    return (std::uint64_t(std::uint32_t(cell_y)) << 32) | std::uint32_t(cell_x);
+}
+
+}
+
+constexpr int world_snapshot::chunk_bits;
+constexpr int world_snapshot::chunk_size;
+constexpr int world_snapshot::region_bits;
+constexpr int world_snapshot::region_size;
+
+// ==========================================================================
+// WORLD_SNAPSHOT::BUILD
+// ==========================================================================
+// Fills the regions with the chunks returned by make_chunk(chunk_x,
+// chunk_y) for every chunk of the world.
+// ==========================================================================
+template <class MakeChunk>
+void world_snapshot::build(MakeChunk &&make_chunk)
+{
+    auto const chunks_wide = (width_ + chunk_size - 1) >> chunk_bits;
+    auto const chunks_high = (height_ + chunk_size - 1) >> chunk_bits;
+    regions_wide_ = (chunks_wide + region_size - 1) >> region_bits;
+    auto const regions_high = (chunks_high + region_size - 1) >> region_bits;
+
+    regions_.reserve(std::size_t(regions_wide_) * regions_high);
+
+    for (int region_y = 0; region_y < regions_high; ++region_y)
+    {
+        for (int region_x = 0; region_x < regions_wide_; ++region_x)
+        {
+            auto new_region = std::make_shared<region>();
+
+            auto const origin_x = region_x * region_size;
+            auto const origin_y = region_y * region_size;
+            auto const last_x = std::min(origin_x + region_size, chunks_wide);
+            auto const last_y = std::min(origin_y + region_size, chunks_high);
+
+            for (int chunk_y = origin_y; chunk_y < last_y; ++chunk_y)
+            {
+                for (int chunk_x = origin_x; chunk_x < last_x; ++chunk_x)
+                {
+                    new_region->chunks[
+                        (chunk_y - origin_y) * region_size + (chunk_x - origin_x)] =
+                        make_chunk(chunk_x, chunk_y);
+                }
+            }
+
+            regions_.push_back(std::move(new_region));
+        }
+    }
+}
+
+// ==========================================================================
+// WORLD_SNAPSHOT::CONSTRUCTOR
+// ==========================================================================
+world_snapshot::world_snapshot(floorplan const &plan)
+  : width_(plan.width()),
+    height_(plan.height()),
+    version_(0)
+{
+    build(
+        [this, &plan](int chunk_x, int chunk_y)
+        {
+            auto new_chunk = std::make_shared<chunk>();
+            new_chunk->tiles.fill(0);
+
+            auto const origin_x = chunk_x * chunk_size;
+            auto const origin_y = chunk_y * chunk_size;
+            auto const last_x = std::min(origin_x + chunk_size, width_);
+            auto const last_y = std::min(origin_y + chunk_size, height_);
+
+            for (int y = origin_y; y < last_y; ++y)
+            {
+                std::copy(
+                    plan[y] + origin_x,
+                    plan[y] + last_x,
+                    new_chunk->tiles.begin() + (y - origin_y) * chunk_size);
+            }
+
+            return std::shared_ptr<chunk const>(std::move(new_chunk));
+        });
+}
+
+// ==========================================================================
+// WORLD_SNAPSHOT::CONSTRUCTOR (MAP FILE)
+// ==========================================================================
+world_snapshot::world_snapshot(std::shared_ptr<map_file const> const &file)
+  : width_(file->width()),
+    height_(file->height()),
+    version_(0)
+{
+    build(
+        [&file](int chunk_x, int chunk_y)
+        {
+            // Map files have chunks of the same size as snapshots, so each
+            // is used in place and shares ownership of the mapping.
+            return std::shared_ptr<chunk const>(
+                file, 
+                reinterpret_cast<chunk const *>(file->chunk(chunk_x, chunk_y)));
+        });
+}
+
+// ==========================================================================
+// WORLD_SNAPSHOT::WITH_TILE
+// ==========================================================================
+std::shared_ptr<world_snapshot const> world_snapshot::with_tile(
+    int x, int y, tile value) const
+{
+    return with_tiles({{x, y, value}});
+}
+
+// ==========================================================================
+// WORLD_SNAPSHOT::WITH_TILES
+// ==========================================================================
+std::shared_ptr<world_snapshot const> world_snapshot::with_tiles(
+    std::vector<tile_change> const &changes) const
+{
+    // Constructed through new because the default constructor is private.
+    std::shared_ptr<world_snapshot> next{new world_snapshot};
+    next->width_ = width_;
+    next->height_ = height_;
+    next->regions_wide_ = regions_wide_;
+    next->version_ = version_ + 1;
+    next->regions_ = regions_;
+
+    // Regions and chunks that are still this snapshot's are copied before
+    // they are changed.  Those that are not were copied earlier in this
+    // batch, and so are still private to the new snapshot.
+    for (auto const &change : changes)
+    {
+        assert(contains(change.x, change.y));
+
+        auto const chunk_x = change.x >> chunk_bits;
+        auto const chunk_y = change.y >> chunk_bits;
+        auto const region_index = 
+            (chunk_y >> region_bits) * regions_wide_ + (chunk_x >> region_bits);
+        auto const chunk_index = 
+            (chunk_y & (region_size - 1)) * region_size + (chunk_x & (region_size - 1));
+
+        auto &target_region = next->regions_[region_index];
+        region *modified_region = nullptr;
+
+        if (target_region == regions_[region_index])
+        {
+            auto copy = std::make_shared<region>(*target_region);
+            modified_region = copy.get();
+            target_region = std::move(copy);
+        }
+        else
+        {
+            modified_region = const_cast<region *>(target_region.get());
+        }
+
+        auto &target_chunk = modified_region->chunks[chunk_index];
+        chunk *modified_chunk = nullptr;
+
+        if (target_chunk == regions_[region_index]->chunks[chunk_index])
+        {
+            auto copy = std::make_shared<chunk>(*target_chunk);
+            modified_chunk = copy.get();
+            target_chunk = std::move(copy);
+        }
+        else
+        {
+            modified_chunk = const_cast<chunk *>(target_chunk.get());
+        }
+
+        modified_chunk->tiles[
+            (change.y & (chunk_size - 1)) * chunk_size + (change.x & (chunk_size - 1))] =
+            change.value;
+    }
+
+    return next;
+}
+
+// ==========================================================================
+// WORLD::CONSTRUCTOR
+// ==========================================================================
+world::world(floorplan const &plan)
+  : current_(std::make_shared<world_snapshot>(plan)),
+    spawn_point_(open_spawn_point(*current_))
+{
+}
+
+// ==========================================================================
+// WORLD::CONSTRUCTOR (SPAWN POINT)
+// ==========================================================================
+world::world(floorplan const &plan, vector2d spawn_point)
+  : current_(std::make_shared<world_snapshot>(plan)),
+    spawn_point_(spawn_point)
+{
+}
+
+// ==========================================================================
+// WORLD::CONSTRUCTOR (MAP FILE)
+// ==========================================================================
+world::world(std::shared_ptr<map_file const> const &file)
+  : current_(std::make_shared<world_snapshot>(file)),
+    spawn_point_(open_spawn_point(*current_))
+{
+}
+
+// ==========================================================================
+// WORLD::SET_TILE
+// ==========================================================================
+void world::set_tile(int x, int y, tile value)
+{
+    {
+        std::unique_lock<std::mutex> lock(write_mutex_);
+        std::atomic_store(&current_, current_->with_tile(x, y, value));
+    }
+
+    notify_tile(x, y);
+}
+
+// ==========================================================================
+// WORLD::SET_TILES
+// ==========================================================================
+void world::set_tiles(std::vector<tile_change> const &changes)
+{
+    {
+        std::unique_lock<std::mutex> lock(write_mutex_);
+        std::atomic_store(&current_, current_->with_tiles(changes));
+    }
+
+    for (auto const &change : changes)
+    {
+        notify_tile(change.x, change.y);
+    }
+}
+
+// ==========================================================================
+// WORLD::ADD_ENTITY
+// ==========================================================================
+entity_id world::add_entity(
+    vector2d position, double heading, std::uint8_t appearance)
+{
+    entity_id id;
+
+    {
+        std::unique_lock<std::shared_timed_mutex> lock(entities_mutex_);
+        id = entities_.add(position, heading, appearance);
+    }
+
+    notify_entity(id, position, position);
+    return id;
+}
+
+// ==========================================================================
+// WORLD::REMOVE_ENTITY
+// ==========================================================================
+void world::remove_entity(entity_id id)
+{
+    vector2d position;
+
+    {
+        std::unique_lock<std::shared_timed_mutex> lock(entities_mutex_);
+        position = entities_.position(id);
+        entities_.remove(id);
+    }
+
+    notify_entity(id, position, position);
+}
+
+// ==========================================================================
+// WORLD::MOVE_ENTITY
+// ==========================================================================
+void world::move_entity(entity_id id, vector2d position, double heading)
+{
+    vector2d old_position;
+
+    {
+        std::unique_lock<std::shared_timed_mutex> lock(entities_mutex_);
+        old_position = entities_.position(id);
+        entities_.move(id, position, heading);
+    }
+
+    // Views that could see either where the entity was or where it is now
+    // must be redrawn.
+    notify_entity(id, old_position, position);
+}
+
+// ==========================================================================
+// WORLD::VISIBLE_ENTITIES
+// ==========================================================================
+void world::visible_entities(
+    entity_id viewer,
+    vector2d position,
+    double heading,
+    double fov,
+    double range,
+    std::vector<entity_sighting> &out) const
+{
+    // The ids are gathered into a per-thread buffer so that queries do not
+    // allocate once it has grown.
+    static thread_local std::vector<entity_id> ids;
+    ids.clear();
+
+    std::shared_lock<std::shared_timed_mutex> lock(entities_mutex_);
+    entities_.query_view(position, heading, fov, range, ids);
+
+    for (auto const id : ids)
+    {
+        if (id != viewer)
+        {
+            out.push_back({
+                id, 
+                entities_.position(id), 
+                entities_.heading(id), 
+                entities_.appearance(id)});
+        }
+    }
+}
+
+// ==========================================================================
+// WORLD::NOTIFY_TILE
+// ==========================================================================
+void world::notify_tile(int x, int y)
+{
+    std::shared_lock<std::shared_timed_mutex> lock(subscriptions_mutex_);
+
+    auto const watchers = watchers_.find(cell_key(
+        x >> visibility_set::cell_bits, y >> visibility_set::cell_bits));
+
+    if (watchers != watchers_.end())
+    {
+        for (auto *subscription : watchers->second)
+        {
+            subscription->on_change_();
+        }
+    }
+}
+
+// ==========================================================================
+// WORLD::NOTIFY_ENTITY
+// ==========================================================================
+void world::notify_entity(entity_id id, vector2d from, vector2d to)
+{
+    // An entity is drawn across the tiles around its position, not only the
+    // one it stands in.
+    static constexpr double extent = 0.5;
+
+    // A view may watch several of the cells concerned, but is told once.
+    // The buffer is per-thread so that it does not allocate once grown.
+    static thread_local std::vector<view_subscription *> told;
+    told.clear();
+
+    std::shared_lock<std::shared_timed_mutex> lock(subscriptions_mutex_);
+
+    for (auto const position : {from, to})
+    {
+        auto const first_x = visibility_set::cell_of(position.x - extent);
+        auto const last_x = visibility_set::cell_of(position.x + extent);
+        auto const first_y = visibility_set::cell_of(position.y - extent);
+        auto const last_y = visibility_set::cell_of(position.y + extent);
+
+        for (auto cell_y = first_y; cell_y <= last_y; ++cell_y)
+        {
+            for (auto cell_x = first_x; cell_x <= last_x; ++cell_x)
+            {
+                auto const watchers = watchers_.find(cell_key(cell_x, cell_y));
+
+                if (watchers == watchers_.end())
+                {
+                    continue;
+                }
+
+                for (auto *subscription : watchers->second)
+                {
+                    if (subscription->viewer_ != id)
+                    {
+                        told.push_back(subscription);
+                    }
+                }
+            }
+        }
+    }
+
+    std::sort(told.begin(), told.end());
+    told.erase(std::unique(told.begin(), told.end()), told.end());
+
+    for (auto *subscription : told)
+    {
+        subscription->on_change_();
+    }
+}
+
+// ==========================================================================
+// WORLD::WATCH_CELL
+// ==========================================================================
+// Called with the subscriptions lock held exclusively.
+// ==========================================================================
+void world::watch_cell(std::uint64_t cell, view_subscription *subscription)
+{
+    watchers_[cell].push_back(subscription);
+}
+
+// ==========================================================================
+// WORLD::UNWATCH_CELL
+// ==========================================================================
+// Called with the subscriptions lock held exclusively.  The order of a
+// cell's watchers does not matter, so the last takes the place of the one
+// removed.
+// ==========================================================================
+void world::unwatch_cell(std::uint64_t cell, view_subscription *subscription)
+{
+    auto &watchers = watchers_[cell];
+    auto const found = std::find(watchers.begin(), watchers.end(), subscription);
+    assert(found != watchers.end());
+
+    *found = watchers.back();
+    watchers.pop_back();
+}
+
+// ==========================================================================
+// VIEW_SUBSCRIPTION::CONSTRUCTOR
+// ==========================================================================
+view_subscription::view_subscription(
+    world &watched,
+    entity_id viewer,
+    std::function<void ()> on_change)
+  : world_(watched),
+    viewer_(viewer),
+    on_change_(std::move(on_change))
+{
+}
+
+// ==========================================================================
+// VIEW_SUBSCRIPTION::DESTRUCTOR
+// ==========================================================================
+view_subscription::~view_subscription()
+{
+    std::unique_lock<std::shared_timed_mutex> lock(world_.subscriptions_mutex_);
+
+    for (auto const cell : cells_)
+    {
+        world_.unwatch_cell(cell, this);
+    }
+}
+
+// ==========================================================================
+// VIEW_SUBSCRIPTION::PUBLISH
+// ==========================================================================
+void view_subscription::publish(visibility_set const &visible)
+{
+    next_cells_.clear();
+    visible.for_each_cell(
+        [this](int cell_x, int cell_y)
+        {
+            next_cells_.push_back(cell_key(cell_x, cell_y));
+        });
+    std::sort(next_cells_.begin(), next_cells_.end());
+
+    // Both lists are in order, so they are walked together to find the
+    // cells that the view has left and those that it has entered.
+    auto old_cell = cells_.begin();
+    auto new_cell = next_cells_.begin();
+
+    std::unique_lock<std::shared_timed_mutex> lock(world_.subscriptions_mutex_);
+
+    while (old_cell != cells_.end() || new_cell != next_cells_.end())
+    {
+        if (new_cell == next_cells_.end()
+         || (old_cell != cells_.end() && *old_cell < *new_cell))
+        {
+            world_.unwatch_cell(*old_cell++, this);
+        }
+        else if (old_cell == cells_.end() || *new_cell < *old_cell)
+        {
+            world_.watch_cell(*new_cell++, this);
+        }
+        else
+        {
+            ++old_cell;
+            ++new_cell;
+        }
+    }
+
+    cells_.swap(next_cells_);
+}
+
+}
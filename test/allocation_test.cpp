@@ -0,0 +1,194 @@
+#include "telnet_bot.hpp"
+#include "allocation_counter.hpp"
+#include "client.hpp"
+#include "connection.hpp"
+#include "loopback_transport.hpp"
+#include <boost/asio/io_context.hpp>
+#include <boost/make_unique.hpp>
+#include <cstdio>
+#include <string>
+
+namespace {
+
+using textray::allocation_site;
+
+// The number of keystrokes measured at each terminal size, after as many
+// again to let buffers reach their steady-state sizes.
+constexpr int keystrokes = 64;
+
+// ==========================================================================
+// DRAIN
+// ==========================================================================
+// Runs handlers on the calling thread until there is no more work, so that
+// a keystroke has been fully handled, repainted and written on return.
+// ==========================================================================
+void drain(boost::asio::io_context &io_context)
+{
+    io_context.restart();
+
+    while (io_context.poll() != 0)
+    {
+    }
+}
+
+// ==========================================================================
+// SITE_ALLOCATIONS
+// ==========================================================================
+struct site_allocations
+{
+    std::uint64_t counts[std::size_t(allocation_site::count_)];
+};
+
+site_allocations current_site_allocations()
+{
+    site_allocations result;
+
+    for (std::size_t site = 0; site < std::size_t(allocation_site::count_); ++site)
+    {
+        result.counts[site] =
+            textray::thread_allocation_count(allocation_site(site)).allocations;
+    }
+
+    return result;
+}
+
+// ==========================================================================
+// CHECK_STEADY_STATE_KEYSTROKES
+// ==========================================================================
+// Drives a real client over a loopback transport with a telnet bot, turning
+// left and right alternately so that every keystroke causes a repaint, and
+// checks that none of the keystroke path's sites allocate once warmed up.
+// Returns the number of sites that did.
+// ==========================================================================
+int check_steady_state_keystrokes(std::uint16_t width, std::uint16_t height)
+{
+    boost::asio::io_context io_context;
+
+    textray::telnet_bot::settings settings;
+    settings.width = width;
+    settings.height = height;
+
+    auto trans = boost::make_unique<textray::loopback_transport>(io_context);
+    auto peer = trans->peer();
+
+    textray::telnet_bot bot{
+        settings,
+        [&peer](serverpp::bytes data)
+        {
+            peer->send(data);
+        }};
+
+    peer->on_receive(
+        [&bot](serverpp::bytes data)
+        {
+            bot.receive(data);
+        });
+
+    auto client = boost::make_unique<textray::client>(
+        textray::connection(std::move(trans)),
+        io_context,
+        [](textray::client const &)
+        {
+        },
+        []
+        {
+        });
+
+    drain(io_context);
+
+    if (!bot.ready())
+    {
+        std::printf(
+            "FAIL %ux%u: the client did not complete negotiation\n",
+            width, height);
+        return 1;
+    }
+
+    static std::string const keys[] = { "q", "e" };
+
+    for (int keystroke = 0; keystroke < keystrokes; ++keystroke)
+    {
+        bot.send_keys(keys[keystroke % 2]);
+        drain(io_context);
+    }
+
+    // The bot's own handling of what it receives runs inside the write
+    // site, so while measuring, the frames are only counted.
+    std::uint64_t bytes_received = 0;
+    peer->on_receive(
+        [&bytes_received](serverpp::bytes data)
+        {
+            bytes_received += data.size();
+        });
+
+    auto const before = current_site_allocations();
+
+    for (int keystroke = 0; keystroke < keystrokes; ++keystroke)
+    {
+        bot.send_keys(keys[keystroke % 2]);
+        drain(io_context);
+    }
+
+    auto const after = current_site_allocations();
+
+    client.reset();
+    peer->on_receive(nullptr);
+
+    static struct {
+        allocation_site site;
+        char const *name;
+    } const sites[] =
+    {
+        { allocation_site::handle_data,      "main_state::handle_data" },
+        { allocation_site::camera_draw,      "camera::do_draw"         },
+        { allocation_site::connection_write, "connection::write"       },
+    };
+
+    int failures = 0;
+
+    if (bytes_received == 0)
+    {
+        std::printf(
+            "FAIL %ux%u: no frames were written\n", width, height);
+        ++failures;
+    }
+
+    for (auto const &checked : sites)
+    {
+        auto const allocations =
+            after.counts[std::size_t(checked.site)]
+          - before.counts[std::size_t(checked.site)];
+
+        std::printf(
+            "%s %ux%u: %s made %llu allocations in %d keystrokes\n",
+            allocations == 0 ? "PASS" : "FAIL",
+            width,
+            height,
+            checked.name,
+            static_cast<unsigned long long>(allocations),
+            keystrokes);
+
+        if (allocations != 0)
+        {
+            ++failures;
+        }
+    }
+
+    return failures;
+}
+
+}
+
+// ==========================================================================
+// MAIN
+// ==========================================================================
+// Fails if any part of the steady-state keystroke path allocates.
+// ==========================================================================
+int main()
+{
+    auto const failures =
+        check_steady_state_keystrokes(80, 24)
+      + check_steady_state_keystrokes(200, 60);
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace textray {
+
+using latency_clock = std::chrono::steady_clock;
+
+//* =========================================================================
+/// \brief Returns the given percentile of a sorted set of latencies, in
+/// microseconds.
+//* =========================================================================
+inline double percentile_us(
+    std::vector<latency_clock::duration> const &sorted_latencies,
+    double pct)
+{
+    if (sorted_latencies.empty())
+    {
+        return 0;
+    }
+
+    auto const index = std::min(
+        sorted_latencies.size() - 1,
+        static_cast<std::size_t>(sorted_latencies.size() * pct / 100));
+
+    return std::chrono::duration<double, std::micro>(
+        sorted_latencies[index]).count();
+}
+
+}
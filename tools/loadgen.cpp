@@ -0,0 +1,511 @@
+#include "latency.hpp"
+#include "telnet_bot.hpp"
+#include <boost/asio/connect.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/format.hpp>
+#include <boost/make_unique.hpp>
+#include <boost/program_options.hpp>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace po = boost::program_options;
+using boost::asio::ip::tcp;
+
+namespace {
+
+using clock_type = textray::latency_clock;
+
+// ==========================================================================
+// LOADGEN_SETTINGS
+// ==========================================================================
+struct loadgen_settings
+{
+    std::string host = "127.0.0.1";
+    std::string port = "4000";
+    unsigned int connections = 1000;
+    double connects_per_second = 500;
+    unsigned int duration = 10;
+    unsigned int threads = 1;
+    double keys_per_second = 5;
+    std::string script = "wwwwqqqqssssaaaaeeeedddd";
+    bool random = false;
+    int server_pid = 0;
+    textray::telnet_bot::settings bot;
+};
+
+// ==========================================================================
+// PROCESS_CPU_SECONDS
+// ==========================================================================
+// Returns the user and system CPU time used so far by the given process,
+// as read from /proc/<pid>/stat, or a negative number if it cannot be
+// read.
+// ==========================================================================
+double process_cpu_seconds(int pid)
+{
+    std::ifstream file("/proc/" + std::to_string(pid) + "/stat");
+    std::string stat{
+        std::istreambuf_iterator<char>(file),
+        std::istreambuf_iterator<char>()};
+
+    // The command name (field 2) is in parentheses and may contain spaces,
+    // so fields are counted from the last closing parenthesis, after which
+    // comes the state (field 3).  utime and stime are fields 14 and 15.
+    auto const name_end = stat.rfind(')');
+
+    if (name_end == std::string::npos)
+    {
+        return -1;
+    }
+
+    std::istringstream fields(stat.substr(name_end + 1));
+    std::string skipped;
+
+    for (int field = 3; field < 14; ++field)
+    {
+        fields >> skipped;
+    }
+
+    unsigned long long utime = 0;
+    unsigned long long stime = 0;
+
+    if (!(fields >> utime >> stime))
+    {
+        return -1;
+    }
+
+    return double(utime + stime) / ::sysconf(_SC_CLK_TCK);
+}
+
+// ==========================================================================
+// LOADGEN_STATISTICS
+// ==========================================================================
+struct loadgen_statistics
+{
+    std::atomic<unsigned int> connected{0};
+    std::atomic<unsigned int> failed{0};
+    std::atomic<unsigned int> disconnected{0};
+};
+
+// ==========================================================================
+// LOADGEN_CONNECTION
+// ==========================================================================
+// A single Telnet connection to the server that presses keys at a fixed
+// rate and measures the time from sending each keypress to receiving the
+// first byte of the server's response.
+// ==========================================================================
+class loadgen_connection
+{
+public :
+    loadgen_connection(
+        boost::asio::io_context &io_context,
+        loadgen_settings const &settings,
+        loadgen_statistics &statistics,
+        unsigned int seed)
+      : settings_(settings),
+        statistics_(statistics),
+        strand_(boost::asio::make_strand(io_context)),
+        socket_(strand_),
+        timer_(strand_),
+        interval_(std::chrono::duration_cast<clock_type::duration>(
+            std::chrono::duration<double>(1.0 / settings.keys_per_second))),
+        rng_(seed),
+        bot_(
+            settings.bot,
+            [this](serverpp::bytes data)
+            {
+                send(data);
+            })
+    {
+    }
+
+    void start(
+        tcp::resolver::results_type const &endpoints,
+        clock_type::duration delay)
+    {
+        timer_.expires_after(delay);
+        timer_.async_wait(
+            [this, endpoints](boost::system::error_code const &ec)
+            {
+                if (!ec)
+                {
+                    connect(endpoints);
+                }
+            });
+    }
+
+    void stop()
+    {
+        boost::system::error_code ec;
+        timer_.cancel();
+        socket_.close(ec);
+    }
+
+    std::vector<clock_type::duration> const &latencies() const
+    {
+        return latencies_;
+    }
+
+    std::uint64_t wire_bytes_received() const
+    {
+        return bot_.wire_bytes_received();
+    }
+
+    std::uint64_t data_bytes_received() const
+    {
+        return bot_.data_bytes_received();
+    }
+
+    std::uint64_t frames_received() const
+    {
+        return bot_.frames_received();
+    }
+
+private :
+    void connect(tcp::resolver::results_type const &endpoints)
+    {
+        boost::asio::async_connect(
+            socket_,
+            endpoints,
+            [this](boost::system::error_code const &ec, tcp::endpoint const &)
+            {
+                if (ec)
+                {
+                    ++statistics_.failed;
+                    return;
+                }
+
+                ++statistics_.connected;
+                socket_.set_option(tcp::no_delay(true));
+                read();
+                schedule_keypress();
+            });
+    }
+
+    void read()
+    {
+        socket_.async_read_some(
+            boost::asio::buffer(read_buffer_),
+            [this](boost::system::error_code const &ec, std::size_t size)
+            {
+                if (ec)
+                {
+                    if (ec != boost::asio::error::operation_aborted)
+                    {
+                        ++statistics_.disconnected;
+                    }
+
+                    return;
+                }
+
+                if (awaiting_response_)
+                {
+                    latencies_.push_back(clock_type::now() - keypress_time_);
+                    awaiting_response_ = false;
+                }
+
+                bot_.receive(serverpp::bytes(read_buffer_, size));
+                read();
+            });
+    }
+
+    void send(serverpp::bytes data)
+    {
+        pending_writes_.insert(pending_writes_.end(), data.begin(), data.end());
+
+        if (!writing_)
+        {
+            write_pending();
+        }
+    }
+
+    void write_pending()
+    {
+        writing_ = true;
+        current_write_.clear();
+        current_write_.swap(pending_writes_);
+
+        boost::asio::async_write(
+            socket_,
+            boost::asio::buffer(current_write_.data(), current_write_.size()),
+            [this](boost::system::error_code const &ec, std::size_t)
+            {
+                writing_ = false;
+
+                if (!ec && !pending_writes_.empty())
+                {
+                    write_pending();
+                }
+            });
+    }
+
+    void schedule_keypress()
+    {
+        timer_.expires_after(interval_);
+        timer_.async_wait(
+            [this](boost::system::error_code const &ec)
+            {
+                if (!ec && socket_.is_open())
+                {
+                    press_key();
+                    schedule_keypress();
+                }
+            });
+    }
+
+    void press_key()
+    {
+        if (!bot_.ready())
+        {
+            return;
+        }
+
+        char key;
+
+        if (settings_.random)
+        {
+            static char const movement_keys[] = "wasdqe";
+            key = movement_keys[
+                std::uniform_int_distribution<int>(0, 5)(rng_)];
+        }
+        else
+        {
+            key = settings_.script[script_index_++ % settings_.script.size()];
+        }
+
+        // Only one keypress is timed at a time, so that a response can
+        // be attributed unambiguously.
+        if (!awaiting_response_)
+        {
+            awaiting_response_ = true;
+            keypress_time_ = clock_type::now();
+        }
+
+        bot_.send_keys(std::string(1, key));
+    }
+
+    loadgen_settings const &settings_;
+    loadgen_statistics &statistics_;
+    boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+    tcp::socket socket_;
+    boost::asio::steady_timer timer_;
+    clock_type::duration interval_;
+    std::mt19937 rng_;
+    textray::telnet_bot bot_;
+
+    serverpp::byte read_buffer_[8192];
+    serverpp::byte_storage pending_writes_;
+    serverpp::byte_storage current_write_;
+    bool writing_ = false;
+
+    std::size_t script_index_ = 0;
+    bool awaiting_response_ = false;
+    clock_type::time_point keypress_time_;
+    std::vector<clock_type::duration> latencies_;
+};
+
+// ==========================================================================
+// RUN_LOADGEN
+// ==========================================================================
+void run_loadgen(loadgen_settings const &settings)
+{
+    boost::asio::io_context io_context;
+    tcp::resolver resolver{io_context};
+    auto const endpoints = resolver.resolve(settings.host, settings.port);
+
+    loadgen_statistics statistics;
+    std::vector<std::unique_ptr<loadgen_connection>> connections;
+    connections.reserve(settings.connections);
+
+    auto const connect_interval = std::chrono::duration<double>(
+        1.0 / settings.connects_per_second);
+
+    for (unsigned int index = 0; index < settings.connections; ++index)
+    {
+        connections.push_back(boost::make_unique<loadgen_connection>(
+            io_context, settings, statistics, index));
+        connections.back()->start(
+            endpoints,
+            std::chrono::duration_cast<clock_type::duration>(
+                connect_interval * index));
+    }
+
+    auto const server_cpu_start = settings.server_pid != 0
+      ? process_cpu_seconds(settings.server_pid)
+      : -1;
+    auto const start = clock_type::now();
+
+    std::vector<std::thread> threadpool;
+
+    for (unsigned int thr = 0; thr < settings.threads; ++thr)
+    {
+        threadpool.emplace_back([&]{io_context.run();});
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(settings.duration));
+
+    io_context.stop();
+
+    for (auto &pthread : threadpool)
+    {
+        pthread.join();
+    }
+
+    auto const elapsed = std::chrono::duration<double>(
+        clock_type::now() - start).count();
+    auto const server_cpu_end = server_cpu_start >= 0
+      ? process_cpu_seconds(settings.server_pid)
+      : -1;
+
+    std::vector<clock_type::duration> latencies;
+    std::uint64_t wire_bytes = 0;
+    std::uint64_t data_bytes = 0;
+    std::uint64_t frames = 0;
+
+    for (auto &connection : connections)
+    {
+        connection->stop();
+        latencies.insert(
+            latencies.end(),
+            connection->latencies().begin(),
+            connection->latencies().end());
+        wire_bytes += connection->wire_bytes_received();
+        data_bytes += connection->data_bytes_received();
+        frames += connection->frames_received();
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+
+    std::cout << boost::format(
+            "%u connections (%u failed, %u dropped) for %.1fs on %u thread(s)\n"
+            "  frames/sec:         %.1f\n"
+            "  wire bytes/sec:     %.1f\n"
+            "  data bytes/sec:     %.1f\n"
+            "  latency p50:        %.1fus\n"
+            "  latency p90:        %.1fus\n"
+            "  latency p99:        %.1fus\n"
+            "  latency p99.9:      %.1fus\n")
+        % statistics.connected.load()
+        % statistics.failed.load()
+        % statistics.disconnected.load()
+        % elapsed
+        % settings.threads
+        % (frames / elapsed)
+        % (wire_bytes / elapsed)
+        % (data_bytes / elapsed)
+        % textray::percentile_us(latencies, 50)
+        % textray::percentile_us(latencies, 90)
+        % textray::percentile_us(latencies, 99)
+        % textray::percentile_us(latencies, 99.9);
+
+    if (server_cpu_start >= 0 && server_cpu_end >= 0)
+    {
+        std::cout << boost::format(
+                "  server cpu/conn:    %.3f%%\n")
+            % (100 * (server_cpu_end - server_cpu_start) / elapsed
+                   / std::max(statistics.connected.load(), 1u));
+    }
+    else if (settings.server_pid != 0)
+    {
+        std::cout << boost::format(
+                "  server cpu/conn:    unavailable (cannot read /proc/%d/stat)\n")
+            % settings.server_pid;
+    }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    loadgen_settings settings;
+    std::string script_file;
+    bool no_compression = false;
+
+    // Frames are counted by the sequences that end a synchronized update,
+    // and so by default the connections report a terminal type that the
+    // server sends them to.
+    settings.bot.terminal_type = "xterm-kitty";
+
+    po::options_description description("Available options");
+    description.add_options()
+        ( "help,h",                                                              "show this help message"                      )
+        ( "host",           po::value<std::string>(&settings.host),              "server host"                                 )
+        ( "port,p",         po::value<std::string>(&settings.port),              "server port"                                 )
+        ( "connections,c",  po::value<unsigned int>(&settings.connections),      "number of connections"                       )
+        ( "connect-rate",   po::value<double>(&settings.connects_per_second),    "new connections per second"                  )
+        ( "duration,d",     po::value<unsigned int>(&settings.duration),         "duration of the run, in seconds"             )
+        ( "threads,t",      po::value<unsigned int>(&settings.threads),          "number of threads of execution"              )
+        ( "rate,r",         po::value<double>(&settings.keys_per_second),        "keypresses per second per connection"        )
+        ( "script,s",       po::value<std::string>(&settings.script),            "keys that each connection presses, in a loop" )
+        ( "script-file",    po::value<std::string>(&script_file),                "read the keys to press from a file"          )
+        ( "random",         po::bool_switch(&settings.random),                   "press random movement keys"                  )
+        ( "width",          po::value<std::uint16_t>(&settings.bot.width),       "terminal width reported"                     )
+        ( "height",         po::value<std::uint16_t>(&settings.bot.height),      "terminal height reported"                    )
+        ( "terminal-type",  po::value<std::string>(&settings.bot.terminal_type), "terminal type reported"                      )
+        ( "no-compression", po::bool_switch(&no_compression),                    "refuse MCCP compression"                     )
+        ( "server-pid",     po::value<int>(&settings.server_pid),                "report the CPU used by this server process"  )
+        ;
+
+    try
+    {
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, description), vm);
+        po::notify(vm);
+
+        if (vm.count("help") != 0)
+        {
+            std::cout << boost::format("USAGE: %s <options>\n") % argv[0]
+                      << description
+                      << std::endl;
+            return EXIT_SUCCESS;
+        }
+
+        if (!script_file.empty())
+        {
+            std::ifstream file(script_file);
+
+            if (!file)
+            {
+                throw po::error("cannot open script file " + script_file);
+            }
+
+            settings.script.assign(
+                std::istreambuf_iterator<char>(file),
+                std::istreambuf_iterator<char>());
+        }
+
+        if (settings.script.empty()
+         || settings.keys_per_second <= 0
+         || settings.connects_per_second <= 0
+         || settings.threads == 0)
+        {
+            throw po::error("script, rates and threads must be non-zero");
+        }
+    }
+    catch(po::error &err)
+    {
+        std::cerr << boost::format("ERROR: %s\n\nUSAGE: %s <options>\n")
+                    % err.what()
+                    % argv[0]
+                  << description
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    settings.bot.compression = !no_compression;
+    run_loadgen(settings);
+
+    return EXIT_SUCCESS;
+}
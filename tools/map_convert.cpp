@@ -0,0 +1,169 @@
+#include "floorplan.hpp"
+#include "level_map.hpp"
+#include "map_file.hpp"
+#include "map_generator.hpp"
+#include <boost/format.hpp>
+#include <boost/program_options.hpp>
+#include <nlohmann/json.hpp>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace po = boost::program_options;
+
+namespace {
+
+// ==========================================================================
+// READ_JSON_MAP
+// ==========================================================================
+// Reads a map of the form { "tiles": [ [ 1, 1, 1 ], [ 1, 0, 1 ], ... ] },
+// where each row is an array of tile ids of the same length.
+// ==========================================================================
+textray::floorplan read_json_map(std::istream &in)
+{
+    auto const document = nlohmann::json::parse(in);
+    auto const &rows = document.at("tiles");
+
+    if (!rows.is_array() || rows.empty() || !rows[0].is_array())
+    {
+        throw std::runtime_error("\"tiles\" must be an array of rows");
+    }
+
+    auto const width = int(rows[0].size());
+    auto const height = int(rows.size());
+    textray::floorplan plan{width, height};
+
+    for (int y = 0; y < height; ++y)
+    {
+        auto const &row = rows[y];
+
+        if (!row.is_array() || int(row.size()) != width)
+        {
+            throw std::runtime_error(
+                (boost::format("row %d is not %d tiles long") % y % width).str());
+        }
+
+        for (int x = 0; x < width; ++x)
+        {
+            auto const id = row[x].get<int>();
+
+            if (id < 0 || id > 255)
+            {
+                throw std::runtime_error(
+                    (boost::format("tile (%d, %d) is not between 0 and 255") 
+                        % x % y).str());
+            }
+
+            plan[y][x] = textray::tile(id);
+        }
+    }
+
+    return plan;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    std::string input;
+    std::string output;
+    bool level_map = false;
+    std::string generate;
+    int generate_size = 256;
+    std::uint64_t seed = 1;
+
+    po::options_description description("Available options");
+    description.add_options()
+        ( "help,h",                                                  "show this help message"                               )
+        ( "input,i",      po::value<std::string>(&input),            "JSON map to convert"                                  )
+        ( "output,o",     po::value<std::string>(&output),           "binary map file to write"                             )
+        ( "level-map",    po::bool_switch(&level_map),               "convert the built-in level map instead of --input"    )
+        ( "generate",     po::value<std::string>(&generate),         "generate a maze, arena, city or corridors map instead" )
+        ( "size",         po::value<int>(&generate_size),            "width and height of a generated map"                  )
+        ( "seed",         po::value<std::uint64_t>(&seed),           "seed of a generated map"                              )
+        ;
+
+    try
+    {
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, description), vm);
+        po::notify(vm);
+
+        if (vm.count("help") != 0)
+        {
+            std::cout << boost::format("USAGE: %s --input <json> --output <map> <options>\n") % argv[0]
+                      << description
+                      << std::endl;
+            return EXIT_SUCCESS;
+        }
+
+        if (output.empty() 
+         || (input.empty() && !level_map && generate.empty()))
+        {
+            throw po::error(
+                "--output and one of --input, --level-map or --generate are required");
+        }
+    }
+    catch(po::error &err)
+    {
+        std::cerr << boost::format("ERROR: %s\n\nUSAGE: %s --input <json> --output <map> <options>\n")
+                    % err.what()
+                    % argv[0]
+                  << description
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        auto const plan = [&]
+        {
+            if (level_map)
+            {
+                return textray::level_map;
+            }
+
+            if (!generate.empty())
+            {
+                return textray::generate_map(
+                    textray::parse_map_style(generate),
+                    generate_size,
+                    generate_size,
+                    seed);
+            }
+
+            std::ifstream in(input);
+
+            if (!in)
+            {
+                throw std::runtime_error("cannot open " + input);
+            }
+
+            return read_json_map(in);
+        }();
+
+        std::ofstream out(output, std::ios::binary);
+
+        if (!out)
+        {
+            throw std::runtime_error("cannot create " + output);
+        }
+
+        textray::write_map_file(out, plan);
+        out.close();
+
+        // Read the result back, so that a bad file is caught here rather
+        // than by the server.
+        auto const file = textray::map_file::open(output);
+        std::cout << boost::format("%s: %dx%d tiles\n")
+            % output % file->width() % file->height();
+    }
+    catch(std::exception &ex)
+    {
+        std::cerr << "ERROR: " << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,292 @@
+#include "latency.hpp"
+#include "telnet_bot.hpp"
+#include "client.hpp"
+#include "connection.hpp"
+#include "loopback_transport.hpp"
+#include "session_recording.hpp"
+#include <boost/format.hpp>
+#include <boost/make_unique.hpp>
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace po = boost::program_options;
+
+namespace {
+
+using clock_type = textray::latency_clock;
+
+// ==========================================================================
+// REPLAY_SETTINGS
+// ==========================================================================
+struct replay_settings
+{
+    std::vector<std::string> recordings;
+    std::string output_directory;
+    bool per_event = false;
+    bool compression = false;
+};
+
+// ==========================================================================
+// DRAIN
+// ==========================================================================
+// Runs every handler that is ready, including any that those handlers
+// queue, so that the server has entirely finished with one event before
+// the next is fed to it.
+// ==========================================================================
+void drain(boost::asio::io_context &io_context)
+{
+    io_context.restart();
+
+    while (io_context.poll() != 0)
+    {
+    }
+}
+
+// ==========================================================================
+// INITIAL_BOT_SETTINGS
+// ==========================================================================
+// The terminal type and window size that the bot announces during
+// negotiation are taken from the first such events in the recording.
+// ==========================================================================
+textray::telnet_bot::settings initial_bot_settings(
+    std::vector<textray::session_event> const &events,
+    bool compression)
+{
+    textray::telnet_bot::settings settings;
+    settings.compression = compression;
+
+    auto const terminal_type = std::find_if(
+        events.begin(),
+        events.end(),
+        [](auto const &event)
+        {
+            return event.type == textray::session_event::kind::terminal_type;
+        });
+
+    if (terminal_type != events.end())
+    {
+        settings.terminal_type.assign(
+            terminal_type->content.begin(), terminal_type->content.end());
+    }
+
+    auto const window_size = std::find_if(
+        events.begin(),
+        events.end(),
+        [](auto const &event)
+        {
+            return event.type == textray::session_event::kind::window_size;
+        });
+
+    if (window_size != events.end())
+    {
+        settings.width = window_size->width;
+        settings.height = window_size->height;
+    }
+
+    return settings;
+}
+
+// ==========================================================================
+// REPLAY
+// ==========================================================================
+void replay(std::string const &path, replay_settings const &settings)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file)
+    {
+        throw std::runtime_error("cannot open " + path);
+    }
+
+    auto const events = textray::read_session_recording(file);
+
+    boost::asio::io_context io_context;
+    auto trans = boost::make_unique<textray::loopback_transport>(io_context);
+    auto peer = trans->peer();
+
+    serverpp::byte_storage output;
+    textray::telnet_bot bot(
+        initial_bot_settings(events, settings.compression),
+        [&peer](serverpp::bytes data)
+        {
+            peer->send(data);
+        });
+
+    bot.on_data(
+        [&output](serverpp::bytes data)
+        {
+            output.insert(output.end(), data.begin(), data.end());
+        });
+
+    peer->on_receive(
+        [&bot](serverpp::bytes data)
+        {
+            bot.receive(data);
+        });
+
+    auto cli = boost::make_unique<textray::client>(
+        textray::connection(std::move(trans)),
+        io_context,
+        [](textray::client const &)
+        {
+        },
+        []
+        {
+        });
+
+    drain(io_context);
+
+    std::vector<clock_type::duration> event_times;
+    event_times.reserve(events.size());
+
+    if (settings.per_event)
+    {
+        std::cout << "event,time_us,kind,output_bytes,wire_bytes,processing_ns\n";
+    }
+
+    for (std::size_t index = 0; index < events.size(); ++index)
+    {
+        auto const &event = events[index];
+        auto const data_before = bot.data_bytes_received();
+        auto const wire_before = bot.wire_bytes_received();
+        auto const start = clock_type::now();
+
+        switch (event.type)
+        {
+            case textray::session_event::kind::data :
+                bot.send_keys(
+                    std::string(event.content.begin(), event.content.end()));
+                break;
+
+            case textray::session_event::kind::window_size :
+                bot.set_window_size(event.width, event.height);
+                break;
+
+            case textray::session_event::kind::terminal_type :
+                // This was already announced during negotiation.
+                break;
+        }
+
+        drain(io_context);
+
+        auto const elapsed = clock_type::now() - start;
+        event_times.push_back(elapsed);
+
+        if (settings.per_event)
+        {
+            std::cout << boost::format("%u,%d,%d,%u,%u,%d\n")
+                % index
+                % event.time.count()
+                % int(event.type)
+                % (bot.data_bytes_received() - data_before)
+                % (bot.wire_bytes_received() - wire_before)
+                % std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        }
+    }
+
+    cli.reset();
+    peer->on_receive(nullptr);
+
+    if (!settings.output_directory.empty())
+    {
+        auto const slash = path.find_last_of('/');
+        auto const name = 
+            slash == std::string::npos ? path : path.substr(slash + 1);
+
+        std::ofstream out(
+            settings.output_directory + "/" + name + ".out",
+            std::ios::binary);
+        out.write(reinterpret_cast<char const *>(output.data()), output.size());
+    }
+
+    auto total = clock_type::duration::zero();
+
+    for (auto const &time : event_times)
+    {
+        total += time;
+    }
+
+    std::sort(event_times.begin(), event_times.end());
+
+    std::cout << boost::format(
+            "%s\n"
+            "  events:             %u\n"
+            "  output bytes:       %u\n"
+            "  wire bytes:         %u\n"
+            "  processing time:    %.1fus\n"
+            "  event time p50:     %.1fus\n"
+            "  event time p99:     %.1fus\n")
+        % path
+        % events.size()
+        % bot.data_bytes_received()
+        % bot.wire_bytes_received()
+        % std::chrono::duration<double, std::micro>(total).count()
+        % textray::percentile_us(event_times, 50)
+        % textray::percentile_us(event_times, 99);
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    replay_settings settings;
+
+    po::options_description description("Available options");
+    description.add_options()
+        ( "help,h",                                                            "show this help message"                            )
+        ( "output-dir,o", po::value<std::string>(&settings.output_directory),  "write each session's output bytes to this directory" )
+        ( "per-event",    po::bool_switch(&settings.per_event),                "print a CSV line for every replayed event"         )
+        ( "compression",  po::bool_switch(&settings.compression),              "accept MCCP compression, as most clients do"       )
+        ( "recording",    po::value<std::vector<std::string>>(&settings.recordings), "session recordings to replay"                )
+        ;
+
+    po::positional_options_description pos_description;
+    pos_description.add("recording", -1);
+
+    try
+    {
+        po::variables_map vm;
+        po::store(
+            po::command_line_parser(argc, argv)
+                .options(description)
+                .positional(pos_description)
+                .run()
+          , vm);
+        po::notify(vm);
+
+        if (vm.count("help") != 0 || settings.recordings.empty())
+        {
+            std::cout << boost::format("USAGE: %s <recording>... <options>\n") % argv[0]
+                      << description
+                      << std::endl;
+            return EXIT_SUCCESS;
+        }
+    }
+    catch(po::error &err)
+    {
+        std::cerr << boost::format("ERROR: %s\n\nUSAGE: %s <recording>... <options>\n")
+                    % err.what()
+                    % argv[0]
+                  << description
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        for (auto const &recording : settings.recordings)
+        {
+            replay(recording, settings);
+        }
+    }
+    catch(std::exception &ex)
+    {
+        std::cerr << "ERROR: " << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
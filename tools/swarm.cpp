@@ -0,0 +1,335 @@
+#include "latency.hpp"
+#include "telnet_bot.hpp"
+#include "client.hpp"
+#include "connection.hpp"
+#include "loopback_transport.hpp"
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/format.hpp>
+#include <boost/make_unique.hpp>
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace po = boost::program_options;
+
+namespace {
+
+using clock_type = textray::latency_clock;
+
+// ==========================================================================
+// SWARM_SETTINGS
+// ==========================================================================
+struct swarm_settings
+{
+    unsigned int clients = 1000;
+    unsigned int duration = 10;
+    unsigned int threads = 1;
+    double keys_per_second = 5;
+    std::string script = "wwwwqqqqssssaaaaeeeedddd";
+    textray::telnet_bot::settings bot;
+};
+
+// ==========================================================================
+// SIMULATED_USER
+// ==========================================================================
+// A bot connected to a real client over a loopback transport, which
+// presses keys from a script at a fixed rate and measures the time taken
+// for the server to respond to each one.
+// ==========================================================================
+class simulated_user
+{
+public :
+    simulated_user(
+        boost::asio::io_context &io_context,
+        swarm_settings const &settings,
+        clock_type::duration initial_delay)
+      : settings_(settings),
+        timer_(io_context),
+        interval_(std::chrono::duration_cast<clock_type::duration>(
+            std::chrono::duration<double>(1.0 / settings.keys_per_second)))
+    {
+        auto trans = boost::make_unique<textray::loopback_transport>(io_context);
+        peer_ = trans->peer();
+
+        bot_ = boost::make_unique<textray::telnet_bot>(
+            settings.bot,
+            [this](serverpp::bytes data)
+            {
+                peer_->send(data);
+            });
+
+        bot_->on_data(
+            [this](serverpp::bytes data)
+            {
+                on_data(data);
+            });
+
+        peer_->on_receive(
+            [this](serverpp::bytes data)
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                auto const data_bytes = bot_->data_bytes_received();
+                bot_->receive(data);
+
+                // The loopback delivers each of the server's writes whole,
+                // and each write that carries any screen data is exactly
+                // one frame.
+                if (bot_->data_bytes_received() != data_bytes)
+                {
+                    ++frames_received_;
+                }
+            });
+
+        client_ = boost::make_unique<textray::client>(
+            textray::connection(std::move(trans)),
+            io_context,
+            [](textray::client const &)
+            {
+            },
+            []
+            {
+            });
+
+        schedule_keypress(initial_delay);
+    }
+
+    ~simulated_user()
+    {
+        client_.reset();
+        peer_->on_receive(nullptr);
+    }
+
+    void stop()
+    {
+        timer_.cancel();
+        peer_->close();
+    }
+
+    std::vector<clock_type::duration> const &latencies() const
+    {
+        return latencies_;
+    }
+
+    std::uint64_t wire_bytes_received() const
+    {
+        return bot_->wire_bytes_received();
+    }
+
+    std::uint64_t frames_received() const
+    {
+        return frames_received_;
+    }
+
+private :
+    void schedule_keypress(clock_type::duration delay)
+    {
+        timer_.expires_after(delay);
+        timer_.async_wait(
+            [this](boost::system::error_code const &ec)
+            {
+                if (!ec && peer_->is_alive())
+                {
+                    press_key();
+                    schedule_keypress(interval_);
+                }
+            });
+    }
+
+    void press_key()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        if (!bot_->ready())
+        {
+            return;
+        }
+
+        // Only one keypress is timed at a time, so that a response can
+        // be attributed unambiguously.
+        if (!awaiting_response_)
+        {
+            awaiting_response_ = true;
+            keypress_time_ = clock_type::now();
+        }
+
+        auto const key = settings_.script[script_index_++ % settings_.script.size()];
+        bot_->send_keys(std::string(1, key));
+    }
+
+    void on_data(serverpp::bytes)
+    {
+        if (awaiting_response_)
+        {
+            latencies_.push_back(clock_type::now() - keypress_time_);
+            awaiting_response_ = false;
+        }
+    }
+
+    swarm_settings const &settings_;
+    boost::asio::steady_timer timer_;
+    clock_type::duration interval_;
+
+    std::mutex mutex_;
+    std::shared_ptr<textray::loopback_peer> peer_;
+    std::unique_ptr<textray::telnet_bot> bot_;
+    std::unique_ptr<textray::client> client_;
+
+    std::size_t script_index_ = 0;
+    bool awaiting_response_ = false;
+    clock_type::time_point keypress_time_;
+    std::vector<clock_type::duration> latencies_;
+    std::uint64_t frames_received_ = 0;
+};
+
+// ==========================================================================
+// RUN_SWARM
+// ==========================================================================
+void run_swarm(swarm_settings const &settings)
+{
+    boost::asio::io_context io_context;
+    auto work = boost::asio::make_work_guard(io_context);
+
+    std::mt19937 rng{0};
+    std::uniform_real_distribution<double> stagger{0, 1.0 / settings.keys_per_second};
+
+    std::vector<std::unique_ptr<simulated_user>> users;
+    users.reserve(settings.clients);
+
+    for (unsigned int user = 0; user < settings.clients; ++user)
+    {
+        users.push_back(boost::make_unique<simulated_user>(
+            io_context,
+            settings,
+            std::chrono::duration_cast<clock_type::duration>(
+                std::chrono::duration<double>(stagger(rng)))));
+    }
+
+    auto const cpu_start = std::clock();
+    auto const start = clock_type::now();
+
+    std::vector<std::thread> threadpool;
+
+    for (unsigned int thr = 0; thr < settings.threads; ++thr)
+    {
+        threadpool.emplace_back([&]{io_context.run();});
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(settings.duration));
+
+    io_context.stop();
+
+    for (auto &pthread : threadpool)
+    {
+        pthread.join();
+    }
+
+    auto const elapsed = std::chrono::duration<double>(
+        clock_type::now() - start).count();
+    auto const cpu_seconds = double(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+
+    for (auto &user : users)
+    {
+        user->stop();
+    }
+
+    std::vector<clock_type::duration> latencies;
+    std::uint64_t wire_bytes = 0;
+    std::uint64_t frames = 0;
+
+    for (auto const &user : users)
+    {
+        latencies.insert(
+            latencies.end(), 
+            user->latencies().begin(), 
+            user->latencies().end());
+        wire_bytes += user->wire_bytes_received();
+        frames += user->frames_received();
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+
+    std::cout << boost::format(
+            "%u clients for %.1fs on %u thread(s)\n"
+            "  frames/sec:         %.1f\n"
+            "  bytes/sec:          %.1f\n"
+            "  process cpu/client: %.3f%% (server and bots)\n"
+            "  latency p50:        %.1fus\n"
+            "  latency p90:        %.1fus\n"
+            "  latency p99:        %.1fus\n"
+            "  latency p99.9:      %.1fus\n")
+        % settings.clients
+        % elapsed
+        % settings.threads
+        % (frames / elapsed)
+        % (wire_bytes / elapsed)
+        % (100 * cpu_seconds / elapsed / std::max(settings.clients, 1u))
+        % textray::percentile_us(latencies, 50)
+        % textray::percentile_us(latencies, 90)
+        % textray::percentile_us(latencies, 99)
+        % textray::percentile_us(latencies, 99.9);
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    swarm_settings settings;
+    bool no_compression = false;
+
+    po::options_description description("Available options");
+    description.add_options()
+        ( "help,h",                                                             "show this help message"                    )
+        ( "clients,c",      po::value<unsigned int>(&settings.clients),         "number of simulated clients"               )
+        ( "duration,d",     po::value<unsigned int>(&settings.duration),        "duration of the run, in seconds"           )
+        ( "threads,t",      po::value<unsigned int>(&settings.threads),         "number of threads of execution"            )
+        ( "rate,r",         po::value<double>(&settings.keys_per_second),       "keypresses per second per client"          )
+        ( "script,s",       po::value<std::string>(&settings.script),           "keys that each client presses, in a loop" )
+        ( "width",          po::value<std::uint16_t>(&settings.bot.width),      "terminal width reported by each client"    )
+        ( "height",         po::value<std::uint16_t>(&settings.bot.height),     "terminal height reported by each client"   )
+        ( "terminal-type",  po::value<std::string>(&settings.bot.terminal_type), "terminal type reported by each client"    )
+        ( "no-compression", po::bool_switch(&no_compression),                   "refuse MCCP compression"                   )
+        ;
+
+    try
+    {
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, description), vm);
+        po::notify(vm);
+
+        if (vm.count("help") != 0)
+        {
+            std::cout << boost::format("USAGE: %s <options>\n") % argv[0]
+                      << description
+                      << std::endl;
+            return EXIT_SUCCESS;
+        }
+
+        if (settings.script.empty() 
+         || settings.keys_per_second <= 0 
+         || settings.threads == 0)
+        {
+            throw po::error("script, rate and threads must be non-zero");
+        }
+    }
+    catch(po::error &err)
+    {
+        std::cerr << boost::format("ERROR: %s\n\nUSAGE: %s <options>\n")
+                    % err.what()
+                    % argv[0]
+                  << description
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    settings.bot.compression = !no_compression;
+    run_swarm(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,472 @@
+#include "telnet_bot.hpp"
+#include "terminal_profile.hpp"
+#include <boost/make_unique.hpp>
+#include <zlib.h>
+
+namespace textray {
+
+namespace {
+
+constexpr serverpp::byte iac  = 255;
+constexpr serverpp::byte dont = 254;
+constexpr serverpp::byte do_  = 253;
+constexpr serverpp::byte wont = 252;
+constexpr serverpp::byte will = 251;
+constexpr serverpp::byte sb   = 250;
+constexpr serverpp::byte se   = 240;
+
+constexpr serverpp::byte echo_option        = 1;
+constexpr serverpp::byte suppress_ga_option = 3;
+constexpr serverpp::byte ttype_option       = 24;
+constexpr serverpp::byte naws_option        = 31;
+constexpr serverpp::byte mccp2_option       = 86;
+
+constexpr serverpp::byte ttype_is   = 0;
+constexpr serverpp::byte ttype_send = 1;
+
+enum class parse_state
+{
+    data,
+    iac,
+    negotiation,
+    subnegotiation,
+    subnegotiation_iac
+};
+
+}
+
+// ==========================================================================
+// TELNET_BOT::IMPLEMENTATION STRUCTURE
+// ==========================================================================
+struct telnet_bot::impl
+{
+    // ======================================================================
+    // CONSTRUCTOR
+    // ======================================================================
+    impl(
+        telnet_bot::settings const &bot_settings,
+        std::function<void (serverpp::bytes)> const &send)
+      : settings_(bot_settings),
+        send_(send)
+    {
+    }
+
+    // ======================================================================
+    // DESTRUCTOR
+    // ======================================================================
+    ~impl()
+    {
+        if (compressed_)
+        {
+            inflateEnd(&stream_);
+        }
+    }
+
+    // ======================================================================
+    // RECEIVE
+    // ======================================================================
+    void receive(serverpp::bytes data)
+    {
+        wire_bytes_received_ += data.size();
+
+        auto const *begin = data.data();
+        auto const *end = begin + data.size();
+
+        while (begin != end)
+        {
+            if (compressed_)
+            {
+                begin = inflate_data(begin, end);
+            }
+            else
+            {
+                begin = parse(begin, end, false);
+            }
+        }
+    }
+
+    // ======================================================================
+    // SEND_KEYS
+    // ======================================================================
+    void send_keys(std::string const &keys)
+    {
+        serverpp::byte_storage data;
+
+        for (auto ch : keys)
+        {
+            auto const by = static_cast<serverpp::byte>(ch);
+            data.push_back(by);
+
+            if (by == iac)
+            {
+                data.push_back(iac);
+            }
+        }
+
+        send_(data);
+    }
+
+    // ======================================================================
+    // SEND_WINDOW_SIZE
+    // ======================================================================
+    void send_window_size()
+    {
+        serverpp::byte_storage data = { iac, sb, naws_option };
+
+        for (auto value : { settings_.width, settings_.height })
+        {
+            for (auto by : { serverpp::byte(value >> 8), serverpp::byte(value & 0xFF) })
+            {
+                data.push_back(by);
+
+                if (by == iac)
+                {
+                    data.push_back(iac);
+                }
+            }
+        }
+
+        data.push_back(iac);
+        data.push_back(se);
+        send_(data);
+    }
+
+    // ======================================================================
+    // PARSE
+    // ======================================================================
+    // Parses uncompressed Telnet data, returning where parsing stopped.
+    // For data straight off the wire, this is either the end of the data
+    // or the first byte after compression begins.
+    // ======================================================================
+    serverpp::byte const *parse(
+        serverpp::byte const *begin, 
+        serverpp::byte const *end,
+        bool inflated)
+    {
+        serverpp::byte_storage app_data;
+
+        while (begin != end && (inflated || !compressed_))
+        {
+            auto const by = *begin++;
+
+            switch (state_)
+            {
+                case parse_state::data:
+                    if (by == iac)
+                    {
+                        state_ = parse_state::iac;
+                    }
+                    else
+                    {
+                        app_data.push_back(by);
+                    }
+                    break;
+
+                case parse_state::iac:
+                    if (by == iac)
+                    {
+                        app_data.push_back(by);
+                        state_ = parse_state::data;
+                    }
+                    else if (by == will || by == wont || by == do_ || by == dont)
+                    {
+                        command_ = by;
+                        state_ = parse_state::negotiation;
+                    }
+                    else if (by == sb)
+                    {
+                        subnegotiation_.clear();
+                        state_ = parse_state::subnegotiation;
+                    }
+                    else
+                    {
+                        state_ = parse_state::data;
+                    }
+                    break;
+
+                case parse_state::negotiation:
+                    negotiate(command_, by);
+                    state_ = parse_state::data;
+                    break;
+
+                case parse_state::subnegotiation:
+                    if (by == iac)
+                    {
+                        state_ = parse_state::subnegotiation_iac;
+                    }
+                    else
+                    {
+                        subnegotiation_.push_back(by);
+                    }
+                    break;
+
+                case parse_state::subnegotiation_iac:
+                    if (by == se)
+                    {
+                        state_ = parse_state::data;
+                        subnegotiate();
+                    }
+                    else
+                    {
+                        subnegotiation_.push_back(by);
+                        state_ = parse_state::subnegotiation;
+                    }
+                    break;
+            }
+        }
+
+        if (!app_data.empty())
+        {
+            data_bytes_received_ += app_data.size();
+            count_frames(app_data);
+
+            if (on_data_)
+            {
+                on_data_(app_data);
+            }
+        }
+
+        return begin;
+    }
+
+    // ======================================================================
+    // INFLATE_DATA
+    // ======================================================================
+    // Decompresses data and parses the result, returning where
+    // decompression stopped.  This is either the end of the data or the
+    // first byte after the compressed stream ends.
+    // ======================================================================
+    serverpp::byte const *inflate_data(
+        serverpp::byte const *begin, serverpp::byte const *end)
+    {
+        serverpp::byte buffer[4096];
+
+        stream_.next_in = const_cast<Bytef *>(begin);
+        stream_.avail_in = static_cast<uInt>(end - begin);
+
+        int result = Z_OK;
+
+        do
+        {
+            stream_.next_out = buffer;
+            stream_.avail_out = sizeof(buffer);
+
+            result = inflate(&stream_, Z_SYNC_FLUSH);
+
+            auto const produced = sizeof(buffer) - stream_.avail_out;
+            parse(buffer, buffer + produced, true);
+        } while (result == Z_OK && stream_.avail_out == 0);
+
+        auto const *consumed = end - stream_.avail_in;
+
+        if (result != Z_OK && result != Z_BUF_ERROR)
+        {
+            // Either the server ended compression or the stream is
+            // corrupt.  Either way, carry on with uncompressed data.
+            inflateEnd(&stream_);
+            compressed_ = false;
+        }
+
+        return consumed;
+    }
+
+    // ======================================================================
+    // NEGOTIATE
+    // ======================================================================
+    void negotiate(serverpp::byte command, serverpp::byte option)
+    {
+        if (command == will)
+        {
+            bool const accept =
+                option == echo_option
+             || option == suppress_ga_option
+             || (option == mccp2_option && settings_.compression);
+
+            send_(serverpp::byte_storage{ iac, accept ? do_ : dont, option });
+        }
+        else if (command == do_)
+        {
+            bool const accept =
+                option == naws_option
+             || option == ttype_option;
+
+            send_(serverpp::byte_storage{ iac, accept ? will : wont, option });
+
+            if (option == naws_option)
+            {
+                send_window_size();
+            }
+        }
+    }
+
+    // ======================================================================
+    // SUBNEGOTIATE
+    // ======================================================================
+    void subnegotiate()
+    {
+        if (subnegotiation_.empty())
+        {
+            return;
+        }
+
+        auto const option = subnegotiation_[0];
+
+        if (option == ttype_option
+         && subnegotiation_.size() >= 2
+         && subnegotiation_[1] == ttype_send)
+        {
+            serverpp::byte_storage data = { iac, sb, ttype_option, ttype_is };
+            data.insert(
+                data.end(),
+                settings_.terminal_type.begin(),
+                settings_.terminal_type.end());
+            data.push_back(iac);
+            data.push_back(se);
+            send_(data);
+
+            ready_ = true;
+        }
+        else if (option == mccp2_option)
+        {
+            stream_ = {};
+
+            if (inflateInit(&stream_) == Z_OK)
+            {
+                compressed_ = true;
+            }
+        }
+    }
+
+    // ======================================================================
+    // COUNT_FRAMES
+    // ======================================================================
+    // Counts the ends of synchronized updates in the application data,
+    // including those split between one receive and the next.
+    // ======================================================================
+    void count_frames(serverpp::byte_storage const &app_data)
+    {
+        for (auto const by : app_data)
+        {
+            if (by == end_synchronized_update[frame_match_])
+            {
+                if (++frame_match_ == sizeof(end_synchronized_update))
+                {
+                    ++frames_received_;
+                    frame_match_ = 0;
+                }
+            }
+            else
+            {
+                frame_match_ = by == end_synchronized_update[0] ? 1 : 0;
+            }
+        }
+    }
+
+    telnet_bot::settings settings_;
+    std::function<void (serverpp::bytes)> send_;
+    std::function<void (serverpp::bytes)> on_data_;
+
+    parse_state state_{parse_state::data};
+    serverpp::byte command_{0};
+    serverpp::byte_storage subnegotiation_;
+
+    bool ready_{false};
+    bool compressed_{false};
+    z_stream stream_{};
+
+    std::uint64_t wire_bytes_received_{0};
+    std::uint64_t data_bytes_received_{0};
+    std::uint64_t frames_received_{0};
+    std::size_t frame_match_{0};
+};
+
+// ==========================================================================
+// CONSTRUCTOR
+// ==========================================================================
+telnet_bot::telnet_bot(
+    settings const &bot_settings,
+    std::function<void (serverpp::bytes)> const &send)
+  : pimpl_(boost::make_unique<impl>(bot_settings, send))
+{
+}
+
+// ==========================================================================
+// DESTRUCTOR
+// ==========================================================================
+telnet_bot::~telnet_bot() = default;
+
+// ==========================================================================
+// RECEIVE
+// ==========================================================================
+void telnet_bot::receive(serverpp::bytes data)
+{
+    pimpl_->receive(data);
+}
+
+// ==========================================================================
+// SEND_KEYS
+// ==========================================================================
+void telnet_bot::send_keys(std::string const &keys)
+{
+    pimpl_->send_keys(keys);
+}
+
+// ==========================================================================
+// SET_WINDOW_SIZE
+// ==========================================================================
+void telnet_bot::set_window_size(std::uint16_t width, std::uint16_t height)
+{
+    pimpl_->settings_.width = width;
+    pimpl_->settings_.height = height;
+    pimpl_->send_window_size();
+}
+
+// ==========================================================================
+// READY
+// ==========================================================================
+bool telnet_bot::ready() const
+{
+    return pimpl_->ready_;
+}
+
+// ==========================================================================
+// COMPRESSED
+// ==========================================================================
+bool telnet_bot::compressed() const
+{
+    return pimpl_->compressed_;
+}
+
+// ==========================================================================
+// WIRE_BYTES_RECEIVED
+// ==========================================================================
+std::uint64_t telnet_bot::wire_bytes_received() const
+{
+    return pimpl_->wire_bytes_received_;
+}
+
+// ==========================================================================
+// DATA_BYTES_RECEIVED
+// ==========================================================================
+std::uint64_t telnet_bot::data_bytes_received() const
+{
+    return pimpl_->data_bytes_received_;
+}
+
+// ==========================================================================
+// FRAMES_RECEIVED
+// ==========================================================================
+std::uint64_t telnet_bot::frames_received() const
+{
+    return pimpl_->frames_received_;
+}
+
+// ==========================================================================
+// ON_DATA
+// ==========================================================================
+void telnet_bot::on_data(std::function<void (serverpp::bytes)> const &callback)
+{
+    pimpl_->on_data_ = callback;
+}
+
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <serverpp/core.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace textray {
+
+//* =========================================================================
+/// \brief The client side of a Telnet session, as a simulated user would
+/// drive it.
+/// \par
+/// The bot answers the server's option negotiation by reporting a window
+/// size (NAWS) and terminal type (TTYPE), optionally accepts compression
+/// (MCCP2) and decompresses everything that follows, and hands the
+/// resulting application data to on_data.  It has no transport of its
+/// own; bytes arriving from the server are passed to receive() and bytes
+/// for the server are passed to the send function.
+//* =========================================================================
+class telnet_bot
+{
+public :
+    struct settings
+    {
+        std::uint16_t width = 80;
+        std::uint16_t height = 24;
+        std::string terminal_type = "xterm";
+        bool compression = true;
+    };
+
+    //* =====================================================================
+    /// \brief Constructor
+    //* =====================================================================
+    telnet_bot(
+        settings const &bot_settings,
+        std::function<void (serverpp::bytes)> const &send);
+
+    //* =====================================================================
+    /// \brief Destructor
+    //* =====================================================================
+    ~telnet_bot();
+
+    //* =====================================================================
+    /// \brief Processes data received from the server.
+    //* =====================================================================
+    void receive(serverpp::bytes data);
+
+    //* =====================================================================
+    /// \brief Sends keypresses to the server.
+    //* =====================================================================
+    void send_keys(std::string const &keys);
+
+    //* =====================================================================
+    /// \brief Sends a new window size to the server.
+    //* =====================================================================
+    void set_window_size(std::uint16_t width, std::uint16_t height);
+
+    //* =====================================================================
+    /// \brief Returns whether the terminal type has been sent, after which
+    ///        the server treats the session as fully set up.
+    //* =====================================================================
+    bool ready() const;
+
+    //* =====================================================================
+    /// \brief Returns whether the server's output is being decompressed.
+    //* =====================================================================
+    bool compressed() const;
+
+    //* =====================================================================
+    /// \brief Returns the number of bytes received from the server, as
+    ///        they were sent over the wire.
+    //* =====================================================================
+    std::uint64_t wire_bytes_received() const;
+
+    //* =====================================================================
+    /// \brief Returns the number of bytes of application data received
+    ///        from the server after decompression and Telnet decoding.
+    //* =====================================================================
+    std::uint64_t data_bytes_received() const;
+
+    //* =====================================================================
+    /// \brief Returns the number of frames received from the server, as
+    ///        counted by the sequences that end a synchronized update.
+    ///        Only servers that consider the terminal type to support
+    ///        synchronized output send these.
+    //* =====================================================================
+    std::uint64_t frames_received() const;
+
+    //* =====================================================================
+    /// \brief Set a function to be called with application data received
+    ///        from the server.
+    //* =====================================================================
+    void on_data(std::function<void (serverpp::bytes)> const &callback);
+
+private :
+    struct impl;
+    std::unique_ptr<impl> pimpl_;
+};
+
+}